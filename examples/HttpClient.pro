@@ -93,3 +93,4 @@ SOURCES += \
 #  $${VIAHTTPLIB}/examples/client/simple_http_client.cpp
 #  $${VIAHTTPLIB}/examples/client/simple_https_client.cpp
 #  $${VIAHTTPLIB}/examples/client/timer_http_client.cpp
+#  $${VIAHTTPLIB}/examples/client/replay_http_client.cpp
@@ -0,0 +1,272 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file replay_http_client.cpp
+/// @brief A tool to replay the traffic captured by an http_server.
+/// @see http_server::set_capture
+///
+/// Each captured connection is replayed on its own TCP connection, sending
+/// the data in the same buffers as it was received to preserve the message
+/// fragmentation. The traffic is either replayed as fast as possible or
+/// paced to the captured timestamps.
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/capture.hpp"
+#include <array>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace
+{
+  typedef ASIO::ip::tcp::socket socket_type;
+
+  /// A replayed connection.
+  struct replay_connection : std::enable_shared_from_this<replay_connection>
+  {
+    socket_type socket_;
+    std::deque<std::string> tx_queue_;
+    std::array<char, 8192> rx_buffer_;
+    bool connected_;
+    bool disconnect_pending_;
+    size_t& rx_bytes_;
+
+    replay_connection(ASIO::io_context& io_context, size_t& rx_bytes) :
+      socket_(io_context),
+      tx_queue_(),
+      rx_buffer_(),
+      connected_(false),
+      disconnect_pending_(false),
+      rx_bytes_(rx_bytes)
+    {}
+
+    /// Connect to the server, then send any data queued while connecting.
+    void connect(ASIO::ip::tcp::resolver::results_type const& endpoints)
+    {
+      auto self(shared_from_this());
+      ASIO::async_connect(socket_, endpoints,
+        [self](ASIO_ERROR_CODE const& error, ASIO::ip::tcp::endpoint const&)
+      {
+        if (error)
+        {
+          std::cerr << "Error, could not connect: " << error.message()
+                    << std::endl;
+          self->tx_queue_.clear();
+          return;
+        }
+
+        self->connected_ = true;
+        self->socket_.set_option(ASIO::ip::tcp::no_delay(true));
+        self->read();
+        if (!self->tx_queue_.empty())
+          self->write();
+        else if (self->disconnect_pending_)
+          self->shutdown();
+      });
+    }
+
+    /// Read and discard the responses.
+    void read()
+    {
+      auto self(shared_from_this());
+      socket_.async_read_some(ASIO::buffer(rx_buffer_),
+        [self](ASIO_ERROR_CODE const& error, size_t size)
+      {
+        self->rx_bytes_ += size;
+        if (!error)
+          self->read();
+      });
+    }
+
+    /// Write the front of the transmit queue.
+    void write()
+    {
+      auto self(shared_from_this());
+      ASIO::async_write(socket_, ASIO::buffer(tx_queue_.front()),
+        [self](ASIO_ERROR_CODE const& error, size_t)
+      {
+        self->tx_queue_.pop_front();
+        if (!error && !self->tx_queue_.empty())
+          self->write();
+        else if (self->disconnect_pending_)
+          self->shutdown();
+      });
+    }
+
+    /// Queue captured data to send.
+    void send(std::string data)
+    {
+      tx_queue_.emplace_back(std::move(data));
+      if (connected_ && (tx_queue_.size() == 1u))
+        write();
+    }
+
+    /// Shutdown the connection, after sending the queued data.
+    void shutdown()
+    {
+      disconnect_pending_ = true;
+      if (connected_ && tx_queue_.empty())
+      {
+        ASIO_ERROR_CODE ignoredEc;
+        socket_.shutdown(socket_type::shutdown_send, ignoredEc);
+      }
+    }
+  };
+
+  /// Replays the records from a capture file.
+  class replayer
+  {
+    ASIO::io_context& io_context_;
+    ASIO::ip::tcp::resolver::results_type endpoints_;
+    via::comms::capture_reader& reader_;
+    bool paced_;
+    ASIO::steady_timer timer_;
+    std::chrono::steady_clock::time_point start_;
+    std::map<std::uint64_t, std::shared_ptr<replay_connection>> connections_;
+    via::comms::capture_record record_;
+
+  public:
+
+    size_t records_;
+    size_t tx_bytes_;
+    size_t rx_bytes_;
+
+    replayer(ASIO::io_context& io_context,
+             ASIO::ip::tcp::resolver::results_type endpoints,
+             via::comms::capture_reader& reader, bool paced) :
+      io_context_(io_context),
+      endpoints_(endpoints),
+      reader_(reader),
+      paced_(paced),
+      timer_(io_context),
+      start_(std::chrono::steady_clock::now()),
+      connections_(),
+      record_(),
+      records_(0u),
+      tx_bytes_(0u),
+      rx_bytes_(0u)
+    {}
+
+    /// Replay the current record.
+    void replay()
+    {
+      ++records_;
+      auto iter(connections_.find(record_.connection));
+      switch (record_.event)
+      {
+      case via::comms::CONNECTED:
+        {
+          auto connection(std::make_shared<replay_connection>
+                            (io_context_, rx_bytes_));
+          connection->connect(endpoints_);
+          connections_[record_.connection] = connection;
+        }
+        break;
+
+      case via::comms::RECEIVED:
+        if (iter != connections_.end())
+        {
+          tx_bytes_ += record_.data.size();
+          iter->second->send(std::move(record_.data));
+        }
+        break;
+
+      case via::comms::DISCONNECTED:
+        if (iter != connections_.end())
+        {
+          iter->second->shutdown();
+          connections_.erase(iter);
+        }
+        break;
+
+      default:
+        break;
+      }
+    }
+
+    /// Read the next record and schedule it.
+    void next()
+    {
+      if (!reader_.read(record_))
+      {
+        // Shutdown the connections that weren't disconnected in the capture
+        for (auto& elem : connections_)
+          elem.second->shutdown();
+        connections_.clear();
+        return;
+      }
+
+      if (paced_)
+      {
+        timer_.expires_at(start_ + record_.timestamp);
+        timer_.async_wait([this](ASIO_ERROR_CODE const& error)
+        {
+          if (!error)
+          {
+            replay();
+            next();
+          }
+        });
+      }
+      else
+      {
+        replay();
+        ASIO::post(io_context_, [this]{ next(); });
+      }
+    }
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  std::string app_name(argv[0]);
+
+  // Get a capture file, hostname and port from the user
+  bool paced((argc == 5) && (std::string(argv[4]) == "paced"));
+  if ((argc < 4) || (argc > 5) || ((argc == 5) && !paced))
+  {
+    std::cout << "Usage: " << app_name << " [capture file] [host] [port] [paced]\n"
+              << "E.g. "   << app_name << " capture.bin localhost 8080 paced"
+              << std::endl;
+    return 1;
+  }
+
+  via::comms::capture_reader reader(argv[1]);
+  if (!reader.is_open())
+  {
+    std::cerr << "Error, could not read capture file: " << argv[1] << std::endl;
+    return 1;
+  }
+
+  try
+  {
+    ASIO::io_context io_context(1);
+    ASIO::ip::tcp::resolver resolver(io_context);
+    replayer the_replayer(io_context, resolver.resolve(argv[2], argv[3]),
+                          reader, paced);
+
+    auto start(std::chrono::steady_clock::now());
+    the_replayer.next();
+    io_context.run();
+    std::chrono::duration<double> elapsed
+        (std::chrono::steady_clock::now() - start);
+
+    std::cout << "Replayed " << the_replayer.records_ << " records, sent "
+              << the_replayer.tx_bytes_ << " bytes, received "
+              << the_replayer.rx_bytes_ << " bytes in "
+              << elapsed.count() << " seconds" << std::endl;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception:"  << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,212 @@
+#ifndef CAPTURE_HPP_VIA_HTTPLIB_
+#define CAPTURE_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file capture.hpp
+/// @brief Classes to capture and read back the traffic on connections.
+///
+/// A capture file starts with the 8 character CAPTURE_MAGIC string followed
+/// by a sequence of records. Each record is a capture_header (in native byte
+/// order) followed by the data received, if any.
+//////////////////////////////////////////////////////////////////////////////
+#include "socket_adaptor.hpp"
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+    /// The identifier at the start of a capture file.
+    constexpr char CAPTURE_MAGIC[] {"VIACAP01"};
+
+    /// The size of the capture file identifier.
+    constexpr size_t CAPTURE_MAGIC_SIZE {sizeof(CAPTURE_MAGIC) - 1};
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @struct capture_header
+    /// The fixed size header of a capture record.
+    //////////////////////////////////////////////////////////////////////////
+    struct capture_header
+    {
+      std::uint64_t timestamp;  ///< microseconds since the capture started.
+      std::uint64_t connection; ///< the connection id.
+      std::uint32_t event;      ///< the event_type.
+      std::uint32_t size;       ///< the size of the data.
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @struct capture_record
+    /// A capture record read from a capture file.
+    //////////////////////////////////////////////////////////////////////////
+    struct capture_record
+    {
+      std::chrono::microseconds timestamp; ///< time since the capture started.
+      std::uint64_t connection;            ///< the connection id.
+      event_type    event;                 ///< CONNECTED, RECEIVED or DISCONNECTED.
+      std::string   data;                  ///< the data received.
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class capture_writer
+    /// Writes the events and data received on connections to a capture file.
+    //////////////////////////////////////////////////////////////////////////
+    class capture_writer
+    {
+      std::FILE* file_; ///< the capture file.
+      std::chrono::steady_clock::time_point start_; ///< the start time.
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_; ///< serialises the records.
+#endif
+
+    public:
+
+      /// Constructor, creates the capture file.
+      /// @param filename the name of the capture file.
+      explicit capture_writer(std::string const& filename) :
+        file_(std::fopen(filename.c_str(), "wb")),
+        start_(std::chrono::steady_clock::now())
+      {
+        if (file_)
+          std::fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_SIZE, file_);
+      }
+
+      /// Destructor, closes the capture file.
+      ~capture_writer()
+      {
+        if (file_)
+          std::fclose(file_);
+      }
+
+      /// Disable copy construction.
+      capture_writer(capture_writer const& other) = delete;
+
+      /// Disable assignment.
+      capture_writer& operator=(capture_writer const& other) = delete;
+
+      /// Whether the capture file is open.
+      bool is_open() const noexcept
+      { return file_ != nullptr; }
+
+      /// Write a capture record.
+      /// @param connection the connection id.
+      /// @param event the event type.
+      /// @param data pointer to the data received, if any.
+      /// @param size the size of the data received.
+      void write(std::uint64_t connection, event_type event,
+                 const char* data = nullptr, size_t size = 0u)
+      {
+        if (!file_)
+          return;
+
+        capture_header header;
+        header.connection = connection;
+        header.event = static_cast<std::uint32_t>(event);
+        header.size = static_cast<std::uint32_t>(size);
+
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        header.timestamp = static_cast<std::uint64_t>
+          (std::chrono::duration_cast<std::chrono::microseconds>
+            (std::chrono::steady_clock::now() - start_).count());
+        std::fwrite(&header, sizeof(header), 1, file_);
+        if (size > 0u)
+          std::fwrite(data, 1, size, file_);
+      }
+
+      /// Write a received data capture record.
+      /// @param connection the connection id.
+      /// @param data the data received.
+      template <typename Container>
+      void write(std::uint64_t connection, Container const& data)
+      { write(connection, RECEIVED, data.data(), data.size()); }
+
+      /// Flush the capture file.
+      void flush()
+      {
+        if (file_)
+          std::fflush(file_);
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class capture_reader
+    /// Reads the records from a capture file.
+    //////////////////////////////////////////////////////////////////////////
+    class capture_reader
+    {
+      std::FILE* file_; ///< the capture file.
+
+    public:
+
+      /// Constructor, opens the capture file and reads its identifier.
+      /// @param filename the name of the capture file.
+      explicit capture_reader(std::string const& filename) :
+        file_(std::fopen(filename.c_str(), "rb"))
+      {
+        char magic[CAPTURE_MAGIC_SIZE];
+        if (file_ &&
+            ((std::fread(magic, 1, CAPTURE_MAGIC_SIZE, file_)
+                != CAPTURE_MAGIC_SIZE) ||
+             (std::memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0)))
+        {
+          std::fclose(file_);
+          file_ = nullptr;
+        }
+      }
+
+      /// Destructor, closes the capture file.
+      ~capture_reader()
+      {
+        if (file_)
+          std::fclose(file_);
+      }
+
+      /// Disable copy construction.
+      capture_reader(capture_reader const& other) = delete;
+
+      /// Disable assignment.
+      capture_reader& operator=(capture_reader const& other) = delete;
+
+      /// Whether the capture file is open and valid.
+      bool is_open() const noexcept
+      { return file_ != nullptr; }
+
+      /// Read the next capture record.
+      /// @retval record the capture record.
+      /// @return true if a record was read, false at the end of the file.
+      bool read(capture_record& record)
+      {
+        capture_header header;
+        if (!file_ || (std::fread(&header, sizeof(header), 1, file_) != 1))
+          return false;
+
+        record.timestamp  = std::chrono::microseconds(header.timestamp);
+        record.connection = header.connection;
+        record.event = static_cast<event_type>(header.event);
+        record.data.resize(header.size);
+        return (header.size == 0u) ||
+               (std::fread(&record.data[0], 1, header.size, file_)
+                  == header.size);
+      }
+    };
+  }
+}
+
+#endif
@@ -15,6 +15,7 @@
 /// @brief The connection template class.
 //////////////////////////////////////////////////////////////////////////////
 #include "socket_adaptor.hpp"
+#include "probes.hpp"
 #ifndef ASIO_STANDALONE
 #include <boost/system/error_code.hpp>
 #endif
@@ -230,6 +231,7 @@ namespace via
       /// @param bytes_transferred the size of the received data packet.
       void read_handler(size_t bytes_transferred)
       {
+        VIA_PROBE2(read, this, bytes_transferred);
         receiving_ = false;
         rx_buffer_->resize(bytes_transferred);
         event_callback_(RECEIVED, weak_from_this());
@@ -265,10 +267,11 @@ namespace via
           }
           else
           {
-            if (pointer->disconnect_pending_)
+            // Send the rest of the transmit queue before shutting down
+            pointer->write_handler(bytes_transferred);
+            if (pointer->disconnect_pending_ && !pointer->shutdown_sent_ &&
+                pointer->tx_idle())
               pointer->shutdown();
-            else
-              pointer->write_handler(bytes_transferred);
           }
         }
       }
@@ -279,8 +282,9 @@ namespace via
       /// the next packet in the queue (if any) and signals that that a packet
       /// has been sent.
       /// @param bytes_transferred the size of the sent data packet.
-      void write_handler(size_t) // bytes_transferred
+      void write_handler([[maybe_unused]] size_t bytes_transferred)
       {
+        VIA_PROBE2(write, this, bytes_transferred);
         if (!transmitting_ && !tx_queue_->empty())
           tx_queue_->pop_front();
 
@@ -723,6 +727,28 @@ namespace via
           write_data(ConstBuffers(1, ASIO::buffer(tx_queue_->front())));
       }
 
+      /// Send a packet of data, combining it with the last packet in the
+      /// transmit queue if that packet is waiting to be sent and their
+      /// combined size is no more than coalesce_size.
+      /// @param packet the data packet to write.
+      /// @param coalesce_size the maximum size of a combined packet,
+      /// zero to never combine packets.
+      void send_data(Container packet, size_t coalesce_size)
+      {
+        // The packet at the front of the queue may be being written
+        if ((tx_queue_->size() > 1u) &&
+            ((tx_queue_->back().size() + packet.size()) <= coalesce_size))
+          tx_queue_->back().insert(tx_queue_->back().end(),
+                                   packet.cbegin(), packet.cend());
+        else
+          send_data(std::move(packet));
+      }
+
+      /// Whether the connection is not sending any data.
+      /// @return true if nothing is being written or queued, false otherwise.
+      bool tx_idle() const noexcept
+      { return !transmitting_ && tx_queue_->empty(); }
+
       /// Send the data in the buffers.
       /// @param buffers the data to write.
       /// @return true if the buffers are being sent, false otherwise.
@@ -0,0 +1,381 @@
+#ifndef HOT_RESTART_HPP_VIA_HTTPLIB_
+#define HOT_RESTART_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file hot_restart.hpp
+/// @brief Contains the hot_restart class, which passes listening sockets
+/// from a server process to the process that replaces it.
+//////////////////////////////////////////////////////////////////////////////
+#include "socket_adaptor.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#define VIA_HOT_RESTART
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+#ifdef VIA_HOT_RESTART
+    //////////////////////////////////////////////////////////////////////////
+    /// @class hot_restart
+    /// Passes the listening sockets of a server process to the process that
+    /// replaces it over a Unix domain socket, so that no connections are
+    /// refused while it restarts.
+    ///
+    /// The running process offers its listening sockets on the Unix socket
+    /// path. The new process takes them over: it receives duplicates of
+    /// the sockets (SCM_RIGHTS) together with an optional state string
+    /// exported by the running process, e.g. its TLS session ticket keys.
+    /// When the new process is accepting connections on the sockets, it
+    /// confirms the handoff and the running process calls its handoff
+    /// handler, which drains its server, see http_server::drain.
+    /// Connections waiting in the listen queues are accepted by the new
+    /// process.
+    ///
+    /// If the new process fails before it confirms the handoff, the running
+    /// process continues to serve and offer its sockets.
+    /// Note: only supported on POSIX systems.
+    //////////////////////////////////////////////////////////////////////////
+    class hot_restart
+    {
+    public:
+
+      /// The function that exports the state to pass to the new process.
+      typedef std::function<std::string ()> StateFunction;
+
+      /// The function called when the new process has taken over.
+      typedef std::function<void ()> HandoffHandler;
+
+      /// The maximum number of listening sockets that can be passed.
+      static constexpr size_t MAX_LISTENERS = 16u;
+
+    private:
+
+      /// The message header, sent with the listening sockets.
+      struct message_header
+      {
+        std::uint32_t listeners;  ///< the number of listening sockets.
+        std::uint32_t state_size; ///< the size of the state that follows.
+      };
+
+      /// The byte sent by the new process to confirm the handoff.
+      static constexpr char CONFIRM = 'C';
+
+      ASIO::io_context& io_context_;  ///< the asio io_context
+      std::string path_;              ///< the Unix socket path.
+      /// The acceptor for the new process, in the running process.
+      ASIO::local::stream_protocol::acceptor acceptor_;
+      std::vector<int> listeners_;    ///< the listening sockets to pass.
+      StateFunction state_function_;  ///< exports the state to pass.
+      HandoffHandler handoff_handler_; ///< called after the handoff.
+      /// The connection to the running process, in the new process.
+      int predecessor_;
+      std::vector<int> received_;     ///< the listening sockets taken over.
+      std::string state_;             ///< the state taken over.
+
+      /// The Unix socket address of the path.
+      /// @retval address the address.
+      /// @return true if the path fits in the address, false otherwise.
+      bool unix_address(sockaddr_un& address) const noexcept
+      {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path_.size() >= sizeof(address.sun_path))
+          return false;
+        std::memcpy(address.sun_path, path_.data(), path_.size());
+        return true;
+      }
+
+      /// Receive exactly size bytes from the running process.
+      /// @return true if received, false otherwise.
+      bool receive_all(char* data, size_t size) noexcept
+      {
+        while (size > 0u)
+        {
+          ssize_t result(::recv(predecessor_, data, size, 0));
+          if (result < 0 && errno == EINTR)
+            continue;
+          if (result <= 0)
+            return false;
+          data += result;
+          size -= static_cast<size_t>(result);
+        }
+        return true;
+      }
+
+      /// Wait for a new process to connect.
+      void start_accept()
+      {
+        auto socket(std::make_shared<ASIO::local::stream_protocol::socket>
+                      (io_context_));
+        acceptor_.async_accept(*socket,
+          [this, socket](ASIO_ERROR_CODE const& error)
+        {
+          if (error == ASIO::error::operation_aborted)
+            return;
+          if (error || !send_listeners(*socket))
+          {
+            start_accept();
+            return;
+          }
+
+          // Wait for the new process to confirm that it's accepting
+          auto confirm(std::make_shared<char>(0));
+          ASIO::async_read(*socket, ASIO::buffer(confirm.get(), 1),
+            [this, socket, confirm](ASIO_ERROR_CODE const& error, size_t)
+          {
+            if (error == ASIO::error::operation_aborted)
+              return;
+            if (error || (*confirm != CONFIRM))
+            {
+              // the new process failed, wait for another
+              start_accept();
+              return;
+            }
+
+            // The path now belongs to the new process, so don't unlink it
+            ASIO_ERROR_CODE ignored;
+            acceptor_.close(ignored);
+            if (handoff_handler_)
+              handoff_handler_();
+          });
+        });
+      }
+
+      /// Send the listening sockets and state to the new process.
+      /// @param socket the connection to the new process.
+      /// @return true if sent, false otherwise.
+      bool send_listeners(ASIO::local::stream_protocol::socket& socket)
+      {
+        std::string state(state_function_ ? state_function_() : std::string());
+        message_header header{static_cast<std::uint32_t>(listeners_.size()),
+                              static_cast<std::uint32_t>(state.size())};
+
+        iovec io{&header, sizeof(header)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_LISTENERS)];
+        msghdr message{};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        if (!listeners_.empty())
+        {
+          size_t fds_size(sizeof(int) * listeners_.size());
+          message.msg_control = control;
+          message.msg_controllen = CMSG_SPACE(fds_size);
+          cmsghdr* cmsg(CMSG_FIRSTHDR(&message));
+          cmsg->cmsg_level = SOL_SOCKET;
+          cmsg->cmsg_type = SCM_RIGHTS;
+          cmsg->cmsg_len = CMSG_LEN(fds_size);
+          std::memcpy(CMSG_DATA(cmsg), listeners_.data(), fds_size);
+        }
+
+        ssize_t result(-1);
+        do
+          result = ::sendmsg(socket.native_handle(), &message, MSG_NOSIGNAL);
+        while (result < 0 && errno == EINTR);
+        if (result != static_cast<ssize_t>(sizeof(header)))
+          return false;
+
+        ASIO_ERROR_CODE error;
+        ASIO::write(socket, ASIO::buffer(state), error);
+        return !error;
+      }
+
+    public:
+
+      /// Constructor.
+      /// @param io_context the asio io_context.
+      /// @param path the path of the Unix socket, the same in both processes.
+      hot_restart(ASIO::io_context& io_context, std::string path) :
+        io_context_(io_context),
+        path_(std::move(path)),
+        acceptor_(io_context),
+        listeners_(),
+        state_function_(),
+        handoff_handler_(),
+        predecessor_(-1),
+        received_(),
+        state_()
+      {}
+
+      /// Destructor, closes the connection to the running process, if any.
+      ~hot_restart()
+      {
+        if (predecessor_ >= 0)
+          ::close(predecessor_);
+      }
+
+      /// Disable copy construction.
+      hot_restart(hot_restart const&) = delete;
+
+      /// Disable assignment.
+      hot_restart& operator=(hot_restart const&) = delete;
+
+      /// Take over the listening sockets of the running process, if any.
+      /// Called by the new process before it creates any listening sockets.
+      /// @param timeout the time to wait for the running process to send
+      /// its sockets.
+      /// @return true if the sockets were received, false if there is no
+      /// running process, in which case the new process should create its
+      /// own listening sockets.
+      bool take_over(std::chrono::milliseconds timeout =
+                       std::chrono::milliseconds(10000))
+      {
+        sockaddr_un address;
+        if (!unix_address(address))
+          return false;
+
+        predecessor_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (predecessor_ < 0)
+          return false;
+
+        timeval tv{static_cast<time_t>(timeout.count() / 1000),
+                   static_cast<suseconds_t>((timeout.count() % 1000) * 1000)};
+        ::setsockopt(predecessor_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        message_header header{0u, 0u};
+        iovec io{&header, sizeof(header)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_LISTENERS)];
+        msghdr message{};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t result(-1);
+        if (::connect(predecessor_, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)) == 0)
+        {
+          do
+            result = ::recvmsg(predecessor_, &message, MSG_CMSG_CLOEXEC);
+          while (result < 0 && errno == EINTR);
+        }
+
+        // Keep the received sockets, even if the message is incomplete
+        for (cmsghdr* cmsg(CMSG_FIRSTHDR(&message)); result > 0 && cmsg;
+             cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+          if ((cmsg->cmsg_level == SOL_SOCKET) &&
+              (cmsg->cmsg_type == SCM_RIGHTS))
+          {
+            size_t count((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            int const* fds(reinterpret_cast<int const*>(CMSG_DATA(cmsg)));
+            received_.insert(received_.end(), fds, fds + count);
+          }
+        }
+
+        state_.resize(header.state_size);
+        bool ok((result == static_cast<ssize_t>(sizeof(header))) &&
+                (received_.size() == header.listeners) &&
+                receive_all(&state_[0], state_.size()));
+        if (!ok)
+        {
+          for (int fd : received_)
+            ::close(fd);
+          received_.clear();
+          state_.clear();
+          ::close(predecessor_);
+          predecessor_ = -1;
+        }
+        return ok;
+      }
+
+      /// The listening sockets taken over from the running process.
+      /// The new process takes ownership of them, e.g. with
+      /// http_server::accept_listener.
+      std::vector<int> const& listeners() const noexcept
+      { return received_; }
+
+      /// The state exported by the running process.
+      std::string const& state() const noexcept
+      { return state_; }
+
+      /// Confirm that the new process is accepting connections on the
+      /// listening sockets, so the running process can stop.
+      /// @return true if confirmed, false otherwise.
+      bool confirm()
+      {
+        if (predecessor_ < 0)
+          return false;
+
+        bool ok(::send(predecessor_, &CONFIRM, 1, MSG_NOSIGNAL) == 1);
+        ::close(predecessor_);
+        predecessor_ = -1;
+        return ok;
+      }
+
+      /// Offer the listening sockets to a new process.
+      /// The new process connects to the Unix socket path, which is
+      /// replaced if it exists.
+      /// @param listeners the listening sockets, e.g. http_server::listeners.
+      /// They remain owned by the caller.
+      /// @param state_function exports the state to pass to the new
+      /// process, optional.
+      /// @param handoff_handler called when the new process has taken over,
+      /// e.g. to drain the server.
+      /// @return the boost error code, false if no error occured
+      ASIO_ERROR_CODE offer(std::vector<int> listeners,
+                            StateFunction state_function,
+                            HandoffHandler handoff_handler)
+      {
+        if (listeners.size() > MAX_LISTENERS)
+          return ASIO_ERROR_CODE(ASIO::error::invalid_argument);
+
+        listeners_ = std::move(listeners);
+        state_function_ = state_function;
+        handoff_handler_ = handoff_handler;
+
+        ::unlink(path_.c_str());
+        ASIO_ERROR_CODE error;
+        acceptor_.open(ASIO::local::stream_protocol(), error);
+        if (!error)
+          acceptor_.bind(ASIO::local::stream_protocol::endpoint(path_), error);
+        if (!error)
+          acceptor_.listen(ASIO::socket_base::max_listen_connections, error);
+        if (error)
+        {
+          ASIO_ERROR_CODE ignored;
+          acceptor_.close(ignored);
+          return error;
+        }
+
+        start_accept();
+        return error;
+      }
+
+      /// Stop offering the listening sockets.
+      void close()
+      {
+        ASIO_ERROR_CODE ignored;
+        if (acceptor_.is_open())
+        {
+          acceptor_.close(ignored);
+          ::unlink(path_.c_str());
+        }
+      }
+    };
+#endif
+  }
+}
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef LOOP_MONITOR_HPP_VIA_HTTPLIB_
+#define LOOP_MONITOR_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file loop_monitor.hpp
+/// @brief Contains the loop_monitor class, which measures the lag of an
+/// io_context.
+//////////////////////////////////////////////////////////////////////////////
+#include "socket_adaptor.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class lag_histogram
+    /// A histogram of event loop lags in power of two microsecond buckets.
+    /// Bucket 0 counts lags under 1uS and bucket n counts lags from 2^(n-1)
+    /// up to 2^n uS; the last bucket counts all longer lags.
+    //////////////////////////////////////////////////////////////////////////
+    class lag_histogram
+    {
+    public:
+
+      /// The number of buckets.
+      static const size_t BUCKETS = 32;
+
+    private:
+
+      std::array<std::uint64_t, BUCKETS> counts_; ///< the bucket counts.
+      std::uint64_t samples_;               ///< the number of samples.
+      std::chrono::microseconds total_;     ///< the sum of the lags.
+      std::chrono::microseconds max_;       ///< the maximum lag.
+
+    public:
+
+      /// Default constructor.
+      lag_histogram() :
+        counts_(),
+        samples_(0u),
+        total_(std::chrono::microseconds::zero()),
+        max_(std::chrono::microseconds::zero())
+      {}
+
+      /// The bucket for a lag.
+      /// @param lag the lag.
+      /// @return the index of the bucket that counts the lag.
+      static size_t bucket(std::chrono::microseconds lag) noexcept
+      {
+        size_t index(0u);
+        for (auto micros(lag.count()); (micros > 0) && (index < BUCKETS - 1u);
+             micros >>= 1)
+          ++index;
+        return index;
+      }
+
+      /// Add a lag to the histogram.
+      /// @param lag the lag.
+      void add(std::chrono::microseconds lag) noexcept
+      {
+        ++counts_[bucket(lag)];
+        ++samples_;
+        total_ += lag;
+        if (lag > max_)
+          max_ = lag;
+      }
+
+      /// Add the lags in another histogram to this histogram.
+      /// @param other the other histogram.
+      void merge(lag_histogram const& other) noexcept
+      {
+        for (size_t i(0u); i < BUCKETS; ++i)
+          counts_[i] += other.counts_[i];
+        samples_ += other.samples_;
+        total_ += other.total_;
+        if (other.max_ > max_)
+          max_ = other.max_;
+      }
+
+      /// Accessor for the bucket counts.
+      std::array<std::uint64_t, BUCKETS> const& counts() const noexcept
+      { return counts_; }
+
+      /// The number of lags in the histogram.
+      std::uint64_t samples() const noexcept
+      { return samples_; }
+
+      /// The mean lag.
+      std::chrono::microseconds mean() const noexcept
+      {
+        return samples_ ? total_ / static_cast<std::int64_t>(samples_)
+                        : std::chrono::microseconds::zero();
+      }
+
+      /// The maximum lag.
+      std::chrono::microseconds max() const noexcept
+      { return max_; }
+
+      /// An upper bound of a percentile of the lags.
+      /// @param percent the percentile, e.g. 99.0.
+      /// @return the upper bound of the bucket containing the percentile,
+      /// or the maximum lag if it's smaller.
+      std::chrono::microseconds percentile(double percent) const noexcept
+      {
+        auto rank(static_cast<std::uint64_t>
+                    (std::ceil(samples_ * percent / 100.0)));
+        std::uint64_t count(0u);
+        for (size_t i(0u); i < BUCKETS; ++i)
+        {
+          count += counts_[i];
+          if (count >= rank)
+            return std::min(max_,
+                            std::chrono::microseconds(std::int64_t(1) << i));
+        }
+        return max_;
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class loop_monitor
+    /// Measures the lag of an io_context: how late the work posted to it
+    /// runs.
+    ///
+    /// Every period, a timer posts a probe to the io_context and the time
+    /// from the timer being due to the probe running is recorded in a
+    /// lag_histogram. The lag is the time that the io_context's threads were
+    /// busy with other handlers, so it shows when they are saturated or
+    /// blocked.
+    /// If the lag is longer than a threshold, the lag handler is called.
+    //////////////////////////////////////////////////////////////////////////
+    class loop_monitor : public std::enable_shared_from_this<loop_monitor>
+    {
+    public:
+
+      /// The clock used to measure the lag.
+      typedef std::chrono::steady_clock clock_type;
+
+      /// A shared pointer to a loop_monitor.
+      typedef std::shared_ptr<loop_monitor> shared_pointer;
+
+      /// A weak pointer to a loop_monitor.
+      typedef std::weak_ptr<loop_monitor> weak_pointer;
+
+      /// The function called when the lag is longer than the threshold.
+      typedef std::function<void (std::chrono::microseconds)> LagHandler;
+
+    private:
+
+      ASIO::io_context& io_context_;        ///< the io_context monitored.
+      ASIO_TIMER timer_;                    ///< the period timer.
+      std::chrono::milliseconds period_;    ///< the time between probes.
+      std::chrono::microseconds threshold_; ///< the lag handler threshold.
+      LagHandler lag_handler_;              ///< the lag handler.
+      std::atomic<bool> running_;           ///< whether the monitor is running.
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_;                    ///< protects the histogram.
+#endif
+      lag_histogram histogram_;             ///< the lags measured.
+
+      /// Wait for the next period.
+      void wait()
+      {
+        clock_type::time_point due(clock_type::now() + period_);
+#ifdef ASIO_STANDALONE
+        timer_.expires_from_now(period_);
+#else
+        timer_.expires_from_now(boost::posix_time::milliseconds(period_.count()));
+#endif
+        weak_pointer weak_ptr(weak_from_this());
+        timer_.async_wait([weak_ptr, due](ASIO_ERROR_CODE const& error)
+        {
+          shared_pointer pointer(weak_ptr.lock());
+          if (pointer && !error)
+            pointer->post_probe(due);
+        });
+      }
+
+      /// Post a probe to the io_context.
+      /// @param due the time that the timer was due.
+      void post_probe(clock_type::time_point due)
+      {
+        if (!running_)
+          return;
+
+        weak_pointer weak_ptr(weak_from_this());
+        ASIO::post(io_context_, [weak_ptr, due]
+        {
+          shared_pointer pointer(weak_ptr.lock());
+          if (pointer)
+            pointer->probe(due);
+        });
+      }
+
+      /// Record the lag of a probe and wait for the next period.
+      /// @param due the time that the timer was due.
+      void probe(clock_type::time_point due)
+      {
+        auto lag(std::chrono::duration_cast<std::chrono::microseconds>
+                   (std::max(clock_type::now() - due,
+                             clock_type::duration::zero())));
+        {
+#ifdef HTTP_THREAD_SAFE
+          std::lock_guard<std::mutex> lock(mutex_);
+#endif
+          histogram_.add(lag);
+        }
+
+        if (lag_handler_ && (lag > threshold_))
+          lag_handler_(lag);
+
+        if (running_)
+          wait();
+      }
+
+    public:
+
+      /// Constructor.
+      /// Note: only a shared pointer to this type should be created, see
+      /// create.
+      /// @param io_context the io_context to monitor.
+      explicit loop_monitor(ASIO::io_context& io_context) :
+        io_context_(io_context),
+        timer_(io_context),
+        period_(std::chrono::milliseconds::zero()),
+        threshold_(std::chrono::microseconds::zero()),
+        lag_handler_(),
+        running_(false),
+#ifdef HTTP_THREAD_SAFE
+        mutex_(),
+#endif
+        histogram_()
+      {}
+
+      /// Create a loop_monitor.
+      /// @param io_context the io_context to monitor.
+      /// @return a shared pointer to the loop_monitor.
+      static shared_pointer create(ASIO::io_context& io_context)
+      { return std::make_shared<loop_monitor>(io_context); }
+
+      /// Start measuring the lag of the io_context.
+      /// @param period the time between probes.
+      /// @param threshold the lag above which the lag handler is called.
+      /// @param lag_handler the lag handler, optional.
+      void start(std::chrono::milliseconds period,
+                 std::chrono::microseconds threshold,
+                 LagHandler lag_handler = LagHandler())
+      {
+        period_ = period;
+        threshold_ = threshold;
+        lag_handler_ = lag_handler;
+        running_ = true;
+        wait();
+      }
+
+      /// Stop measuring the lag of the io_context.
+      void stop()
+      {
+        running_ = false;
+        timer_.cancel();
+      }
+
+      /// Whether the monitor is running.
+      bool running() const noexcept
+      { return running_; }
+
+      /// A copy of the histogram of the lags measured.
+      lag_histogram histogram()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return histogram_;
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,443 @@
+#ifndef MEMORY_ADAPTOR_HPP_VIA_HTTPLIB_
+#define MEMORY_ADAPTOR_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file memory_adaptor.hpp
+/// @brief Contains the memory_adaptor socket adaptor class.
+/// Only include this file to connect servers and clients in the same process
+/// without using the kernel, e.g. for testing and benchmarking.
+//////////////////////////////////////////////////////////////////////////////
+#include "socket_adaptor.hpp"
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class memory_channel
+    /// One direction of an in-memory connection: a byte queue written by one
+    /// memory_adaptor and read by its peer.
+    //////////////////////////////////////////////////////////////////////////
+    class memory_channel
+    {
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_;              ///< protects the channel.
+#endif
+      std::vector<char> buffer_;      ///< the data written to the channel.
+      size_t head_;                   ///< the start of the unread data.
+      bool closed_;                   ///< the writer has shutdown.
+
+      ASIO::io_context* io_context_;  ///< the reader's io_context.
+      char*  read_ptr_;               ///< the pending read buffer.
+      size_t read_size_;              ///< the size of the pending read buffer.
+      CommsHandler read_handler_;     ///< the pending read handler.
+
+      /// Copy unread data into a read buffer.
+      /// @return the number of bytes copied.
+      size_t copy_to(char* ptr, size_t size) noexcept
+      {
+        size_t length(std::min(size, buffer_.size() - head_));
+        std::memcpy(ptr, buffer_.data() + head_, length);
+        head_ += length;
+        if (head_ == buffer_.size())
+        {
+          buffer_.clear();
+          head_ = 0u;
+        }
+        return length;
+      }
+
+      /// Complete the pending read.
+      /// @param error the error code for the read handler.
+      /// @param size the number of bytes read.
+      void complete_read(ASIO_ERROR_CODE const& error, size_t size)
+      {
+        CommsHandler handler;
+        handler.swap(read_handler_);
+        ASIO::post(*io_context_, [handler, error, size]
+          { handler(error, size); });
+      }
+
+    public:
+
+      /// Constructor.
+      memory_channel() :
+        buffer_(),
+        head_(0u),
+        closed_(false),
+        io_context_(nullptr),
+        read_ptr_(nullptr),
+        read_size_(0u),
+        read_handler_()
+      {}
+
+      /// Disable copy construction.
+      memory_channel(memory_channel const& other) = delete;
+
+      /// Disable assignment.
+      memory_channel& operator=(memory_channel const& other) = delete;
+
+      /// Write data to the channel.
+      /// @param buffers the buffer(s) containing the data.
+      /// @return the number of bytes written.
+      size_t write(ConstBuffers const& buffers)
+      {
+        size_t size(ASIO::buffer_size(buffers));
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (closed_)
+          return size;
+
+        for (auto const& buffer : buffers)
+        {
+          const char* data(static_cast<const char*>(buffer.data()));
+          buffer_.insert(buffer_.end(), data, data + buffer.size());
+        }
+
+        if (read_handler_ && (size > 0u))
+          complete_read(ASIO_ERROR_CODE(), copy_to(read_ptr_, read_size_));
+        return size;
+      }
+
+      /// Read data from the channel.
+      /// The read handler is called when data is available, the channel is
+      /// closed or the read is cancelled.
+      /// @param io_context the io_context to call the read handler on.
+      /// @param ptr pointer to the receive buffer.
+      /// @param size the size of the receive buffer.
+      /// @param read_handler the handler for received data.
+      void read(ASIO::io_context& io_context, void* ptr, size_t size,
+                CommsHandler read_handler)
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        io_context_ = &io_context;
+        read_handler_ = read_handler;
+        read_ptr_ = static_cast<char*>(ptr);
+        read_size_ = size;
+
+        if (head_ < buffer_.size())
+          complete_read(ASIO_ERROR_CODE(), copy_to(read_ptr_, read_size_));
+        else if (closed_)
+          complete_read(ASIO_ERROR_CODE(ASIO::error::eof), 0u);
+      }
+
+      /// Close the channel, the reader receives an eof after reading any
+      /// unread data.
+      void close()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        closed_ = true;
+        if (read_handler_ && (head_ == buffer_.size()))
+          complete_read(ASIO_ERROR_CODE(ASIO::error::eof), 0u);
+      }
+
+      /// Cancel a pending read and discard any unread data.
+      void cancel()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        closed_ = true;
+        buffer_.clear();
+        head_ = 0u;
+        if (read_handler_)
+          complete_read(ASIO_ERROR_CODE(ASIO::error::operation_aborted), 0u);
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class memory_socket
+    /// The socket of a memory_adaptor.
+    /// It accepts and ignores the socket options that connection sets.
+    //////////////////////////////////////////////////////////////////////////
+    class memory_socket
+    {
+    public:
+
+      /// Set a socket option, ignored.
+      template <typename Option>
+      void set_option(Option const&) noexcept
+      {}
+
+      /// Get a socket option, not set.
+      template <typename Option>
+      void get_option(Option&) const noexcept
+      {}
+
+      /// A memory socket does not have a native handle.
+      int native_handle() const noexcept
+      { return -1; }
+
+      /// The remote endpoint: the IPv4 loopback address.
+      ASIO::ip::tcp::endpoint remote_endpoint() const
+      { return ASIO::ip::tcp::endpoint(ASIO::ip::address_v4::loopback(), 0); }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class memory_adaptor
+    /// This class enables the connection class to use in-memory channels
+    /// instead of sockets.
+    ///
+    /// A server listens on a port number in the process and clients connect
+    /// to it by the port number, the host name is ignored.
+    /// Each connection is a pair of memory_channels. All of the handlers are
+    /// posted to the io_context, as they would be for a socket.
+    /// @see connection
+    /// @see tcp_adaptor
+    //////////////////////////////////////////////////////////////////////////
+    class memory_adaptor
+    {
+    public:
+
+      /// The function that a listening server calls to accept a connection.
+      /// @param rx the channel that the accepted connection reads.
+      /// @param tx the channel that the accepted connection writes.
+      typedef std::function<void (std::shared_ptr<memory_channel> rx,
+                                  std::shared_ptr<memory_channel> tx)>
+        AcceptHandler;
+
+    private:
+
+      ASIO::io_context& io_context_; ///< The asio io_context.
+      std::shared_ptr<memory_channel> rx_channel_; ///< The receive channel.
+      std::shared_ptr<memory_channel> tx_channel_; ///< The transmit channel.
+      memory_socket socket_;         ///< The pseudo socket.
+
+      /// The listening servers, keyed by port number.
+      static std::map<unsigned short, AcceptHandler>& listeners()
+      {
+        static std::map<unsigned short, AcceptHandler> listeners_;
+        return listeners_;
+      }
+
+#ifdef HTTP_THREAD_SAFE
+      /// Protects the listening servers.
+      static std::mutex& listeners_mutex()
+      {
+        static std::mutex mutex_;
+        return mutex_;
+      }
+#endif
+
+    protected:
+
+      /// @fn handshake
+      /// There is no handshake, so it just posts the handshake_handler with
+      /// a success error code.
+      /// @param handshake_handler the handshake callback function.
+      // @param is_server whether performing client or server handshaking,
+      // not used by memory channels.
+      void handshake(ErrorHandler handshake_handler, bool /*is_server*/ = false)
+      {
+        ASIO::post(io_context_, [handshake_handler]
+          { handshake_handler(ASIO_ERROR_CODE()); });
+      }
+
+      /// @fn connect_socket
+      /// Memory channels are connected in connect, so it just posts the
+      /// connect_handler with a success error code.
+      /// @param connect_handler the connect callback function.
+      /// @param host_iterator the resolver iterator.
+      void connect_socket(ConnectHandler connect_handler,
+                          ASIO::ip::tcp::resolver::iterator host_iterator)
+      {
+        ASIO::post(io_context_, [connect_handler, host_iterator]
+          { connect_handler(ASIO_ERROR_CODE(), host_iterator); });
+      }
+
+      /// The memory_adaptor constructor.
+      /// @param io_context the asio io_context associted with this connection
+      explicit memory_adaptor(ASIO::io_context& io_context) :
+        io_context_(io_context),
+        rx_channel_(),
+        tx_channel_(),
+        socket_()
+      {}
+
+    public:
+
+      /// A virtual destructor because connection inherits from this class.
+      virtual ~memory_adaptor()
+      {}
+
+      /// The default HTTP port.
+      static const unsigned short DEFAULT_HTTP_PORT = 80;
+
+      /// The default size of the receive buffer.
+      static const size_t DEFAULT_RX_BUFFER_SIZE = 8192;
+
+      /// @fn listen
+      /// Listen for connections on the given port number.
+      /// @param port the port number.
+      /// @param accept_handler the function to call to accept a connection.
+      /// @return true if listening, false if the port is already in use.
+      static bool listen(unsigned short port, AcceptHandler accept_handler)
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(listeners_mutex());
+#endif
+        return listeners().emplace(port, accept_handler).second;
+      }
+
+      /// @fn unlisten
+      /// Stop listening for connections on the given port number.
+      /// @param port the port number.
+      static void unlisten(unsigned short port)
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(listeners_mutex());
+#endif
+        listeners().erase(port);
+      }
+
+      /// @fn attach
+      /// Attach the memory channels of a connection.
+      /// @param rx the channel to read.
+      /// @param tx the channel to write.
+      void attach(std::shared_ptr<memory_channel> rx,
+                  std::shared_ptr<memory_channel> tx) noexcept
+      {
+        rx_channel_ = rx;
+        tx_channel_ = tx;
+      }
+
+      /// @fn connect
+      /// Connect to the server listening on the given port number.
+      /// @pre To be called by "client" connections only.
+      /// @param host_name the host to connect to, ignored.
+      /// @param port_name the port number to connect to.
+      /// @param connect_handler the handler to call when connected.
+      /// @return true if a server is listening on the port, false otherwise.
+      bool connect(std::string_view /*host_name*/, std::string_view port_name,
+                   ConnectHandler connect_handler)
+      {
+        unsigned short port(static_cast<unsigned short>
+                         (std::strtoul(std::string(port_name).c_str(), 0, 10)));
+        AcceptHandler accept_handler;
+        {
+#ifdef HTTP_THREAD_SAFE
+          std::lock_guard<std::mutex> lock(listeners_mutex());
+#endif
+          auto iter(listeners().find(port));
+          if (iter == listeners().end())
+            return false;
+          accept_handler = iter->second;
+        }
+
+        auto client_to_server(std::make_shared<memory_channel>());
+        auto server_to_client(std::make_shared<memory_channel>());
+        attach(server_to_client, client_to_server);
+        accept_handler(client_to_server, server_to_client);
+
+        connect_socket(connect_handler, ASIO::ip::tcp::resolver::iterator());
+        return true;
+      }
+
+      /// @fn read
+      /// The memory channel read function.
+      /// @param ptr pointer to the receive buffer.
+      /// @param size the size of the receive buffer.
+      /// @param read_handler the handler for received messages.
+      void read(void* ptr, size_t size, CommsHandler read_handler)
+      {
+        if (rx_channel_)
+          rx_channel_->read(io_context_, ptr, size, read_handler);
+        else
+          ASIO::post(io_context_, [read_handler]
+            { read_handler(ASIO_ERROR_CODE(ASIO::error::not_connected), 0u); });
+      }
+
+      /// @fn write
+      /// The memory channel write function.
+      /// @param buffers the buffer(s) containing the message.
+      /// @param write_handler the handler called after a message is sent.
+      void write(ConstBuffers& buffers, CommsHandler write_handler)
+      {
+        ASIO_ERROR_CODE error;
+        size_t size(0u);
+        if (tx_channel_)
+          size = tx_channel_->write(buffers);
+        else
+          error = ASIO::error::not_connected;
+
+        ASIO::post(io_context_, [write_handler, error, size]
+          { write_handler(error, size); });
+      }
+
+      /// @fn shutdown
+      /// The memory channel shutdown function.
+      /// Closes both channels and notifies the write handler.
+      /// @param write_handler the handler to notify that the channels are
+      /// disconnected.
+      void shutdown(CommsHandler write_handler)
+      {
+        close();
+        write_handler(ASIO_ERROR_CODE(ASIO::error::eof), 0);
+      }
+
+      /// @fn close
+      /// The memory channel close function.
+      /// Cancels any receive operation and closes both channels.
+      void close()
+      {
+        if (tx_channel_)
+          tx_channel_->close();
+        if (rx_channel_)
+          rx_channel_->cancel();
+      }
+
+      /// @fn start
+      /// The memory channel start function.
+      /// Signals that the channel is connected.
+      /// @param handshake_handler the handshake callback function.
+      void start(ErrorHandler handshake_handler)
+      { handshake(handshake_handler, true); }
+
+      /// @fn is_disconnect
+      /// This function determines whether the error is a socket disconnect.
+      // @param error the error_code
+      /// @return true if a disconnect error, false otherwise.
+      bool is_disconnect(ASIO_ERROR_CODE const&) noexcept
+      { return false; }
+
+      /// @fn is_shutdown
+      /// This function determines whether the caller should perform an SSL
+      /// shutdown.
+      // @param error the error_code
+      bool is_shutdown(ASIO_ERROR_CODE const&) noexcept
+      { return false; }
+
+      /// @fn socket
+      /// Accessor for the pseudo socket.
+      /// @return a reference to the memory_socket.
+      memory_socket& socket() noexcept
+      { return socket_; }
+    };
+
+  }
+}
+
+#endif
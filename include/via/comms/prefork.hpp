@@ -0,0 +1,434 @@
+#ifndef PREFORK_HPP_VIA_HTTPLIB_
+#define PREFORK_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file prefork.hpp
+/// @brief Contains the shared_counters and prefork_master classes, which run
+/// single threaded servers in several processes.
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#if !defined(_WIN32)
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#define VIA_PREFORK
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+#ifdef VIA_PREFORK
+    //////////////////////////////////////////////////////////////////////////
+    /// @class shared_counters
+    /// Counters in a shared memory segment: a row of counters for each
+    /// worker process.
+    ///
+    /// The segment is mapped before the workers are forked, so they share
+    /// it with the master process. Each worker only updates its own row,
+    /// so the counters are lock free; the master sums them when it reads
+    /// them.
+    //////////////////////////////////////////////////////////////////////////
+    class shared_counters
+    {
+    public:
+
+      /// The type of a counter.
+      typedef std::atomic<std::uint64_t> counter_type;
+
+      static_assert(counter_type::is_always_lock_free,
+                    "shared_counters requires lock free 64 bit atomics");
+
+    private:
+
+      size_t rows_;     ///< the number of rows, one per worker.
+      size_t columns_;  ///< the number of counters in a row.
+      counter_type* counters_; ///< the shared memory segment.
+
+    public:
+
+      /// Constructor, maps the shared memory segment.
+      /// @param rows the number of rows, one per worker.
+      /// @param columns the number of counters in a row.
+      /// @throw std::runtime_error if the memory can't be mapped.
+      shared_counters(size_t rows, size_t columns) :
+        rows_(rows),
+        columns_(columns),
+        counters_(nullptr)
+      {
+        size_t size(std::max<size_t>(rows_ * columns_, 1u)
+                    * sizeof(counter_type));
+        void* memory(::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        if (memory == MAP_FAILED)
+          throw std::runtime_error("shared_counters: mmap failed");
+
+        // mmap zero fills the memory
+        counters_ = static_cast<counter_type*>(memory);
+      }
+
+      /// Destructor, unmaps the shared memory segment.
+      ~shared_counters()
+      {
+        ::munmap(counters_, std::max<size_t>(rows_ * columns_, 1u)
+                            * sizeof(counter_type));
+      }
+
+      /// Disable copy construction.
+      shared_counters(shared_counters const&) = delete;
+
+      /// Disable assignment.
+      shared_counters& operator=(shared_counters const&) = delete;
+
+      /// The number of rows.
+      size_t rows() const noexcept
+      { return rows_; }
+
+      /// The number of counters in a row.
+      size_t columns() const noexcept
+      { return columns_; }
+
+      /// Accessor for a counter.
+      /// @pre row < rows() and column < columns().
+      /// @param row the row, i.e. the worker.
+      /// @param column the counter.
+      /// @return a reference to the counter.
+      counter_type& at(size_t row, size_t column) noexcept
+      { return counters_[row * columns_ + column]; }
+
+      /// The sum of a counter over all of the rows.
+      /// @param column the counter.
+      /// @return the total.
+      std::uint64_t total(size_t column) const noexcept
+      {
+        std::uint64_t sum(0u);
+        for (size_t row(0u); row < rows_; ++row)
+          sum += counters_[row * columns_ + column]
+                   .load(std::memory_order_relaxed);
+        return sum;
+      }
+
+      /// Zero the counters of a row.
+      /// @param row the row.
+      void reset(size_t row) noexcept
+      {
+        for (size_t column(0u); column < columns_; ++column)
+          at(row, column).store(0u, std::memory_order_relaxed);
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class prefork_master
+    /// Runs a single threaded server in several worker processes.
+    ///
+    /// The master process creates the listening sockets, then forks the
+    /// worker processes, which inherit them. Each worker runs its own
+    /// io_context and http_server, accepting connections on its listening
+    /// socket, see http_server::accept_listener. So request handlers that
+    /// use libraries that are not thread safe can use all of the cores,
+    /// without locking.
+    ///
+    /// By default the workers share one listening socket. With reuse_port,
+    /// each worker has its own SO_REUSEPORT socket and the kernel balances
+    /// the connections between them.
+    ///
+    /// The master supervises the workers: it respawns a worker that exits
+    /// with an error or is killed by a signal. A worker that exits with
+    /// status 0 has finished and is not respawned.
+    ///
+    /// The workers publish their statistics in shared_counters, which the
+    /// master can read at any time.
+    /// Note: only supported on POSIX systems.
+    //////////////////////////////////////////////////////////////////////////
+    class prefork_master
+    {
+    public:
+
+      /// The function run by a worker process.
+      /// @param worker the index of the worker.
+      /// @param listener the listening socket of the worker, -1 if none.
+      /// @return the exit status of the worker process.
+      typedef std::function<int (size_t worker, int listener)> WorkerFunction;
+
+    private:
+
+      /// The state of a worker process.
+      struct worker_state
+      {
+        pid_t pid;          ///< the process id, 0 if not running.
+        size_t restarts;    ///< the number of times it was respawned.
+        std::chrono::steady_clock::time_point started; ///< its start time.
+      };
+
+      std::vector<worker_state> workers_; ///< the worker processes.
+      shared_counters counters_;          ///< the worker counters.
+      std::vector<int> listeners_;        ///< the listening sockets.
+      bool reuse_port_;                   ///< a listening socket per worker.
+      /// The minimum time between spawning a worker and respawning it.
+      std::chrono::milliseconds respawn_delay_;
+      std::atomic<bool> stopping_;        ///< whether stop has been called.
+
+      /// Create a listening socket.
+      /// @param port the port number.
+      /// @param ipv4_only whether an IPV4 only socket is required.
+      /// @param reuse_port whether to set SO_REUSEPORT.
+      /// @return the socket, -1 on error.
+      static int listen_socket(unsigned short port, bool ipv4_only,
+                               bool reuse_port) noexcept
+      {
+        int family(ipv4_only ? AF_INET : AF_INET6);
+        int fd(::socket(family, SOCK_STREAM, 0));
+        if ((fd < 0) && !ipv4_only)
+          fd = ::socket(family = AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+          return -1;
+
+        int on(1);
+        int off(0);
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+        if (reuse_port)
+          ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+
+        int result(-1);
+        if (family == AF_INET6)
+        {
+          ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+          sockaddr_in6 address{};
+          address.sin6_family = AF_INET6;
+          address.sin6_addr = in6addr_any;
+          address.sin6_port = htons(port);
+          result = ::bind(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address));
+        }
+        else
+        {
+          sockaddr_in address{};
+          address.sin_family = AF_INET;
+          address.sin_addr.s_addr = htonl(INADDR_ANY);
+          address.sin_port = htons(port);
+          result = ::bind(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address));
+        }
+
+        if ((result != 0) || (::listen(fd, SOMAXCONN) != 0))
+        {
+          ::close(fd);
+          return -1;
+        }
+        return fd;
+      }
+
+      /// Fork a worker process.
+      /// @param worker the index of the worker.
+      /// @param worker_function the function to run in the worker.
+      /// @return true if forked, false otherwise.
+      bool spawn(size_t worker, WorkerFunction const& worker_function)
+      {
+        pid_t pid(::fork());
+        if (pid < 0)
+          return false;
+
+        if (pid == 0)
+        {
+          // The worker only keeps its own listening socket
+          int listener(this->listener(worker));
+          for (int fd : listeners_)
+            if (fd != listener)
+              ::close(fd);
+
+          int status(EXIT_FAILURE);
+          try
+          {
+            status = worker_function(worker, listener);
+          }
+          catch (...)
+          {}
+          std::_Exit(status);
+        }
+
+        workers_[worker].pid = pid;
+        workers_[worker].started = std::chrono::steady_clock::now();
+        return true;
+      }
+
+      /// Find the worker with a process id.
+      /// @return the index of the worker, workers_.size() if not found.
+      size_t find_worker(pid_t pid) const noexcept
+      {
+        size_t worker(0u);
+        while ((worker < workers_.size()) && (workers_[worker].pid != pid))
+          ++worker;
+        return worker;
+      }
+
+    public:
+
+      /// Constructor.
+      /// @param workers the number of worker processes, default: one per
+      /// hardware thread.
+      /// @param counters the number of shared counters for each worker.
+      explicit prefork_master(size_t workers =
+                                std::max(std::thread::hardware_concurrency(),
+                                         1u),
+                              size_t counters = 16u) :
+        workers_(std::max<size_t>(workers, 1u),
+                 worker_state{0, 0u, std::chrono::steady_clock::time_point()}),
+        counters_(workers_.size(), counters),
+        listeners_(),
+        reuse_port_(false),
+        respawn_delay_(1000),
+        stopping_(false)
+      {}
+
+      /// Destructor, closes the listening sockets.
+      ~prefork_master()
+      {
+        for (int fd : listeners_)
+          ::close(fd);
+      }
+
+      /// Disable copy construction.
+      prefork_master(prefork_master const&) = delete;
+
+      /// Disable assignment.
+      prefork_master& operator=(prefork_master const&) = delete;
+
+      /// Create the listening socket(s) for the workers.
+      /// @pre to be called before run.
+      /// @param port the port number to serve.
+      /// @param ipv4_only whether an IPV4 only server is required, default
+      /// false.
+      /// @param reuse_port whether to create an SO_REUSEPORT socket for each
+      /// worker instead of one shared socket, default false.
+      /// @return true if the sockets were created, false otherwise.
+      bool listen(unsigned short port, bool ipv4_only = false,
+                  bool reuse_port = false)
+      {
+        reuse_port_ = reuse_port;
+        size_t count(reuse_port_ ? workers_.size() : 1u);
+        for (size_t i(0u); i < count; ++i)
+        {
+          int fd(listen_socket(port, ipv4_only, reuse_port_));
+          if (fd < 0)
+            return false;
+          listeners_.push_back(fd);
+        }
+        return true;
+      }
+
+      /// Set the minimum time between spawning a worker and respawning it,
+      /// so that a worker that fails on start up doesn't cause a fork loop.
+      /// @param delay the minimum time, default 1 second.
+      void set_respawn_delay(std::chrono::milliseconds delay) noexcept
+      { respawn_delay_ = delay; }
+
+      /// Fork the worker processes and supervise them until they have all
+      /// finished or stop has been called and they have exited.
+      /// @param worker_function the function to run in each worker process.
+      /// It's called in the forked process, with the worker's index and its
+      /// listening socket, and its return value is the exit status of the
+      /// process.
+      void run(WorkerFunction worker_function)
+      {
+        for (size_t worker(0u); worker < workers_.size(); ++worker)
+          spawn(worker, worker_function);
+
+        for (;;)
+        {
+          int status(0);
+          pid_t pid(::waitpid(-1, &status, 0));
+          if (pid < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            break; // no more children
+          }
+
+          size_t worker(find_worker(pid));
+          if (worker == workers_.size())
+            continue;
+
+          workers_[worker].pid = 0;
+          bool failed(!WIFEXITED(status) || (WEXITSTATUS(status) != 0));
+          if (failed && !stopping_)
+          {
+            auto lifetime(std::chrono::steady_clock::now()
+                          - workers_[worker].started);
+            if (lifetime < respawn_delay_)
+              std::this_thread::sleep_for(respawn_delay_ - lifetime);
+
+            ++workers_[worker].restarts;
+            if (!stopping_)
+              spawn(worker, worker_function);
+          }
+        }
+      }
+
+      /// Stop the workers: send them SIGTERM and don't respawn them.
+      /// It may be called from a signal handler in the master process.
+      void stop() noexcept
+      {
+        stopping_ = true;
+        for (auto const& worker : workers_)
+          if (worker.pid > 0)
+            ::kill(worker.pid, SIGTERM);
+      }
+
+      /// The listening socket of a worker.
+      /// @param worker the index of the worker.
+      /// @return the socket, -1 if listen hasn't been called.
+      int listener(size_t worker) const noexcept
+      {
+        if (listeners_.empty())
+          return -1;
+        return reuse_port_ ? listeners_[worker] : listeners_.front();
+      }
+
+      /// The number of worker processes.
+      size_t workers() const noexcept
+      { return workers_.size(); }
+
+      /// The process id of a worker.
+      /// @param worker the index of the worker.
+      /// @return the process id, 0 if it's not running.
+      pid_t worker_pid(size_t worker) const noexcept
+      { return workers_[worker].pid; }
+
+      /// The number of times that a worker has been respawned.
+      /// @param worker the index of the worker.
+      size_t restarts(size_t worker) const noexcept
+      { return workers_[worker].restarts; }
+
+      /// Accessor for the shared counters: a row for each worker.
+      shared_counters& counters() noexcept
+      { return counters_; }
+    };
+#endif
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PROBES_HPP_VIA_HTTPLIB_
+#define PROBES_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file probes.hpp
+/// @brief Static tracepoint (USDT) macros for the via_httplib provider.
+///
+/// If VIA_HTTPLIB_USDT is defined and <sys/sdt.h> is available (e.g. from
+/// systemtap-sdt-dev), the VIA_PROBE macros expand to SystemTap/DTrace SDT
+/// probes. An SDT probe is a nop instruction with a note describing its
+/// location and arguments, so tools such as perf, bpftrace and bcc can
+/// attach to it without rebuilding the application. A probe's arguments are
+/// only evaluated while a tracer is attached to it. Otherwise the macros
+/// expand to nothing and their arguments are not evaluated.
+///
+/// The probes are (connection is the address of the comms::connection):
+///  + accept(connection)
+///  + read(connection, bytes)
+///  + request_parsed(connection, method, uri)
+///  + handler_begin(connection, uri)
+///  + handler_end(connection, uri)
+///  + response_queued(connection, status, body_size)
+///  + write(connection, bytes)
+///  + disconnect(connection)
+//////////////////////////////////////////////////////////////////////////////
+#if defined(VIA_HTTPLIB_USDT) && __has_include(<sys/sdt.h>)
+// Each probe has a semaphore, which a tracer increments while it's attached,
+// so that the probe's arguments are only evaluated when they're traced.
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define VIA_HTTPLIB_PROBES
+
+/// Define the semaphore of a probe, see VIA_PROBE_ENABLED.
+#define VIA_PROBE_SEMAPHORE(name) \
+  extern "C" { inline volatile unsigned short via_httplib_##name##_semaphore \
+                 __attribute__((unused, section(".probes"))) = 0; }
+
+VIA_PROBE_SEMAPHORE(accept)
+VIA_PROBE_SEMAPHORE(read)
+VIA_PROBE_SEMAPHORE(request_parsed)
+VIA_PROBE_SEMAPHORE(handler_begin)
+VIA_PROBE_SEMAPHORE(handler_end)
+VIA_PROBE_SEMAPHORE(response_queued)
+VIA_PROBE_SEMAPHORE(write)
+VIA_PROBE_SEMAPHORE(disconnect)
+
+/// Whether a tracer is attached to the probe.
+#define VIA_PROBE_ENABLED(name) \
+  __builtin_expect(via_httplib_##name##_semaphore != 0, 0)
+
+#define VIA_PROBE1(name, a) \
+  do { if (VIA_PROBE_ENABLED(name)) \
+         DTRACE_PROBE1(via_httplib, name, a); } while (0)
+#define VIA_PROBE2(name, a, b) \
+  do { if (VIA_PROBE_ENABLED(name)) \
+         DTRACE_PROBE2(via_httplib, name, a, b); } while (0)
+#define VIA_PROBE3(name, a, b, c) \
+  do { if (VIA_PROBE_ENABLED(name)) \
+         DTRACE_PROBE3(via_httplib, name, a, b, c); } while (0)
+#else
+#define VIA_PROBE_ENABLED(name) false
+#define VIA_PROBE1(name, a) ((void)0)
+#define VIA_PROBE2(name, a, b) ((void)0)
+#define VIA_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+#endif
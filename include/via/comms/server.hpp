@@ -23,6 +23,8 @@
 #endif
 #include <string>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 #ifdef HTTP_THREAD_SAFE
 #include "via/thread/threadsafe_hash_map.hpp"
 #else
@@ -33,6 +35,20 @@ namespace via
 {
   namespace comms
   {
+    /// Whether a SocketAdaptor listens for connections itself, instead of
+    /// using an acceptor, e.g. memory_adaptor.
+    template <typename SocketAdaptor, typename = void>
+    struct is_listening_adaptor : std::false_type
+    {};
+
+    /// Whether a SocketAdaptor listens for connections itself: it has a
+    /// static listen function.
+    template <typename SocketAdaptor>
+    struct is_listening_adaptor<SocketAdaptor,
+                                std::void_t<decltype(&SocketAdaptor::listen)>>
+      : std::true_type
+    {};
+
     //////////////////////////////////////////////////////////////////////////
     /// @class server
     /// A template class for implementing a tcp or ssl server using buffered
@@ -94,6 +110,7 @@ namespace via
       error_callback_type error_callback_;   ///< The error callback function.
 
       size_t rx_buffer_size_; ///< The size of the receive buffer.
+      unsigned short port_;   ///< The port number, for listening adaptors.
 
       // Socket parameters
 
@@ -123,6 +140,7 @@ namespace via
             error_callback_(error, next_connection_);
           else
           {
+            VIA_PROBE1(accept, next_connection_.get());
 #ifdef HTTP_THREAD_SAFE
             connections_.emplace(next_connection_.get(), next_connection_);
 #else
@@ -149,6 +167,7 @@ namespace via
         event_callback_(event, ptr);
         if (event == DISCONNECTED)
         {
+          VIA_PROBE1(disconnect, ptr.lock().get());
           if (std::shared_ptr<connection_type> connection = ptr.lock())
           {
 #ifdef HTTP_THREAD_SAFE
@@ -172,6 +191,31 @@ namespace via
                          std::weak_ptr<connection_type> connection)
       { error_callback_(error, connection); }
 
+      /// @fn accept_memory_connection
+      /// Accept a connection from a listening adaptor.
+      /// @param rx the channel that the connection reads.
+      /// @param tx the channel that the connection writes.
+      template <typename Channel>
+      void accept_memory_connection(Channel rx, Channel tx)
+      {
+        std::shared_ptr<connection_type> connection
+          (connection_type::create(io_context_,
+            [this](int event, std::weak_ptr<connection_type> ptr)
+              { event_handler(event, ptr); },
+            [this](ASIO_ERROR_CODE const& error,
+                   std::weak_ptr<connection_type> ptr)
+              { error_handler(error, ptr); },
+            rx_buffer_size_));
+        connection->attach(rx, tx);
+#ifdef HTTP_THREAD_SAFE
+        connections_.emplace(connection.get(), connection);
+#else
+        connections_.emplace(connection);
+#endif
+        connection->start(no_delay_, keep_alive_, timeout_,
+                          receive_buffer_size_, send_buffer_size_);
+      }
+
       /// @fn start_accept
       /// Wait for connections.
       void start_accept()
@@ -218,6 +262,7 @@ namespace via
         event_callback_(),
         error_callback_(),
         rx_buffer_size_(SocketAdaptor::DEFAULT_RX_BUFFER_SIZE),
+        port_(0),
         receive_buffer_size_(0),
         send_buffer_size_(0),
         timeout_(0),
@@ -244,6 +289,10 @@ namespace via
         password_(),
         event_callback_(event_callback),
         error_callback_(error_callback),
+        rx_buffer_size_(SocketAdaptor::DEFAULT_RX_BUFFER_SIZE),
+        port_(0),
+        receive_buffer_size_(0),
+        send_buffer_size_(0),
         timeout_(0),
         no_delay_(false),
         keep_alive_(false)
@@ -275,48 +324,95 @@ namespace via
 
       /// @fn accept_connections
       /// Create the acceptor and wait for connections.
+      /// A listening adaptor, e.g. memory_adaptor, listens on the port
+      /// number instead of creating acceptors.
       /// @param port the port number to serve.
       /// @param ipv4_only whether an IPV4 only server is required.
       /// @return the boost error code, false if no error occured
       ASIO_ERROR_CODE accept_connections(unsigned short port, bool ipv4_only)
       {
-        // Determine whether the IPv6 acceptor accepts both IPv6 & IPv4
-        ASIO::ip::v6_only ipv6_only(false);
-        ASIO_ERROR_CODE ec;
+        if constexpr (is_listening_adaptor<SocketAdaptor>::value)
+        {
+          if (!SocketAdaptor::listen(port, [this](auto rx, auto tx)
+                                     { accept_memory_connection(rx, tx); }))
+            return ASIO_ERROR_CODE(ASIO::error::address_in_use);
 
-        // Open the IPv6 acceptor unless IPv4 only mode
-        if (!ipv4_only)
+          port_ = port;
+          return ASIO_ERROR_CODE();
+        }
+        else
         {
-          acceptor_v6_.open(ASIO::ip::tcp::v6(), ec);
-          if (!ec)
+          // Determine whether the IPv6 acceptor accepts both IPv6 & IPv4
+          ASIO::ip::v6_only ipv6_only(false);
+          ASIO_ERROR_CODE ec;
+
+          // Open the IPv6 acceptor unless IPv4 only mode
+          if (!ipv4_only)
           {
-            acceptor_v6_.set_option(ipv6_only, ec);
-            acceptor_v6_.get_option(ipv6_only);
-            acceptor_v6_.set_option
-              (ASIO::ip::tcp::acceptor::reuse_address(true));
-            acceptor_v6_.bind
-              (ASIO::ip::tcp::endpoint(ASIO::ip::tcp::v6(), port));
-            acceptor_v6_.listen();
+            acceptor_v6_.open(ASIO::ip::tcp::v6(), ec);
+            if (!ec)
+            {
+              acceptor_v6_.set_option(ipv6_only, ec);
+              acceptor_v6_.get_option(ipv6_only);
+              acceptor_v6_.set_option
+                (ASIO::ip::tcp::acceptor::reuse_address(true));
+              acceptor_v6_.bind
+                (ASIO::ip::tcp::endpoint(ASIO::ip::tcp::v6(), port));
+              acceptor_v6_.listen();
+            }
           }
+
+          // Open the IPv4 acceptor if the IPv6 acceptor is not open or it
+          // only supports IPv6
+          if (!acceptor_v6_.is_open() || ipv6_only)
+          {
+            acceptor_v4_.open(ASIO::ip::tcp::v4(), ec);
+            if (!ec)
+            {
+              acceptor_v4_.set_option
+                  (ASIO::ip::tcp::acceptor::reuse_address(true));
+              acceptor_v4_.bind
+                (ASIO::ip::tcp::endpoint(ASIO::ip::tcp::v4(), port));
+              acceptor_v4_.listen();
+            }
+          }
+
+          start_accept();
+          return ec;
         }
+      }
 
-        // Open the IPv4 acceptor if the IPv6 acceptor is not open or it
-        // only supports IPv6
-        if (!acceptor_v6_.is_open() || ipv6_only)
+      /// @fn accept_listener
+      /// Accept connections on a socket that is already listening, e.g. one
+      /// inherited from a prefork_master or another process.
+      /// Note: not supported by listening adaptors, e.g. memory_adaptor.
+      /// @param listener the native handle of the listening socket, the
+      /// server takes ownership of it.
+      /// @return the boost error code, false if no error occured
+      ASIO_ERROR_CODE accept_listener
+                      (ASIO::ip::tcp::acceptor::native_handle_type listener)
+      {
+        if constexpr (is_listening_adaptor<SocketAdaptor>::value)
+          return ASIO_ERROR_CODE(ASIO::error::operation_not_supported);
+        else
         {
-          acceptor_v4_.open(ASIO::ip::tcp::v4(), ec);
-          if (!ec)
+          ASIO_ERROR_CODE ec;
+          acceptor_v6_.assign(ASIO::ip::tcp::v6(), listener, ec);
+          if (ec)
+            return ec;
+
+          // Assign an IPv4 socket to the IPv4 acceptor
+          if (acceptor_v6_.local_endpoint(ec).protocol() ==
+              ASIO::ip::tcp::v4())
           {
-            acceptor_v4_.set_option
-                (ASIO::ip::tcp::acceptor::reuse_address(true));
-            acceptor_v4_.bind
-              (ASIO::ip::tcp::endpoint(ASIO::ip::tcp::v4(), port));
-            acceptor_v4_.listen();
+            acceptor_v6_.release(ec);
+            acceptor_v4_.assign(ASIO::ip::tcp::v4(), listener, ec);
           }
-        }
 
-        start_accept();
-        return ec;
+          if (!ec)
+            start_accept();
+          return ec;
+        }
       }
 
 #ifdef HTTP_SSL
@@ -379,16 +475,46 @@ namespace via
       void set_no_delay(bool enable) noexcept
       { no_delay_ = enable; }
 
-      /// @fn close
-      /// Close the server and all of the connections associated with it.
-      void close()
+      /// @fn listeners
+      /// The native handles of the server's listening sockets, e.g. to pass
+      /// them to another process, see hot_restart.
+      /// @return the listening sockets, empty if it's not accepting
+      /// connections or it's a listening adaptor.
+      std::vector<ASIO::ip::tcp::acceptor::native_handle_type> listeners()
+      {
+        std::vector<ASIO::ip::tcp::acceptor::native_handle_type> handles;
+        if (acceptor_v6_.is_open())
+          handles.push_back(acceptor_v6_.native_handle());
+        if (acceptor_v4_.is_open())
+          handles.push_back(acceptor_v4_.native_handle());
+        return handles;
+      }
+
+      /// @fn stop_accepting
+      /// Stop accepting connections, the existing connections are unaffected.
+      /// Note: connections waiting in the listen queue of a socket that has
+      /// been passed to another process are accepted by that process.
+      void stop_accepting()
       {
+        if constexpr (is_listening_adaptor<SocketAdaptor>::value)
+        {
+          if (port_ != 0)
+            SocketAdaptor::unlisten(port_);
+          port_ = 0;
+        }
+
         if (acceptor_v6_.is_open())
           acceptor_v6_.close();
 
         if (acceptor_v4_.is_open())
           acceptor_v4_.close();
+      }
 
+      /// @fn close
+      /// Close the server and all of the connections associated with it.
+      void close()
+      {
+        stop_accepting();
         connections_.clear();
       }
     };
@@ -15,6 +15,7 @@
 /// @brief Contains the tcp_adaptor socket adaptor class.
 //////////////////////////////////////////////////////////////////////////////
 #include "socket_adaptor.hpp"
+#include "timestamping.hpp"
 #include <string_view>
 
 namespace via
@@ -51,6 +52,10 @@ namespace via
       ASIO::ip::tcp::socket socket_; ///< The asio TCP socket.
       /// The host iterator used by the resolver.
       ASIO::ip::tcp::resolver::iterator host_iterator_;
+#ifdef VIA_SO_TIMESTAMPING
+      /// The socket timestamps, nullptr if not enabled.
+      std::shared_ptr<socket_timestamps> timestamps_;
+#endif
 
     protected:
 
@@ -80,13 +85,21 @@ namespace via
         io_context_(io_context),
         socket_(io_context_),
         host_iterator_()
+#ifdef VIA_SO_TIMESTAMPING
+      , timestamps_()
+#endif
       {}
 
     public:
 
       /// A virtual destructor because connection inherits from this class.
       virtual ~tcp_adaptor()
-      {}
+      {
+#ifdef VIA_SO_TIMESTAMPING
+        if (timestamps_)
+          timestamps_->release();
+#endif
+      }
 
       /// The default HTTP port.
       static const unsigned short DEFAULT_HTTP_PORT = 80;
@@ -119,6 +132,13 @@ namespace via
       /// @param read_handler the handler for received messages.
       void read(void* ptr, size_t size, CommsHandler read_handler)
       {
+#ifdef VIA_SO_TIMESTAMPING
+        if (timestamps_)
+        {
+          timestamps_->read(ptr, size, read_handler);
+          return;
+        }
+#endif
         socket_.async_read_some
             (ASIO::buffer(ptr, size), read_handler);
       }
@@ -129,6 +149,10 @@ namespace via
       /// @param write_handler the handler called after a message is sent.
       void write(ConstBuffers& buffers, CommsHandler write_handler)
       {
+#ifdef VIA_SO_TIMESTAMPING
+        if (timestamps_)
+          timestamps_->written(ASIO::buffer_size(buffers));
+#endif
         ASIO::async_write(socket_, buffers, write_handler);
       }
 
@@ -151,6 +175,13 @@ namespace via
       /// Cancels any send, receive or connect operations and closes the socket.
       void close()
       {
+#ifdef VIA_SO_TIMESTAMPING
+        if (timestamps_)
+        {
+          timestamps_->release();
+          timestamps_.reset();
+        }
+#endif
         ASIO_ERROR_CODE ignoredEc;
         if (socket_.is_open())
           socket_.close (ignoredEc);
@@ -182,6 +213,38 @@ namespace via
       /// @return a reference to the tcp socket.
       ASIO::ip::tcp::socket& socket() noexcept
       { return socket_; }
+
+      /// @fn enable_timestamping
+      /// Enable kernel software timestamps on the connected socket: receive
+      /// timestamps for the data read and send and acknowledgement
+      /// timestamps for the data written.
+      /// Note: only supported on Linux.
+      /// @pre the socket is connected and nothing has been written to it.
+      /// @param stats the latency statistics to update.
+      /// @return true if timestamping is enabled, false otherwise.
+      bool enable_timestamping([[maybe_unused]]
+                               std::shared_ptr<latency_stats> stats)
+      {
+#ifdef VIA_SO_TIMESTAMPING
+        if (!timestamps_ && socket_timestamps::enable(socket_))
+          timestamps_ = std::make_shared<socket_timestamps>(socket_, stats);
+        return static_cast<bool>(timestamps_);
+#else
+        return false;
+#endif
+      }
+
+      /// @fn rx_timestamp
+      /// The kernel receive timestamp of the last data read.
+      /// @return the timestamp, the epoch if timestamping is not enabled.
+      std::chrono::system_clock::time_point rx_timestamp()
+      {
+#ifdef VIA_SO_TIMESTAMPING
+        if (timestamps_)
+          return timestamps_->rx_time();
+#endif
+        return std::chrono::system_clock::time_point();
+      }
     };
 
   }
@@ -0,0 +1,445 @@
+#ifndef TIMESTAMPING_HPP_VIA_HTTPLIB_
+#define TIMESTAMPING_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file timestamping.hpp
+/// @brief Contains the latency_stats and socket_timestamps classes, which
+/// measure latencies from kernel socket timestamps.
+//////////////////////////////////////////////////////////////////////////////
+#include "loop_monitor.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+#if defined(__linux__) && __has_include(<linux/net_tstamp.h>)
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <deque>
+#define VIA_SO_TIMESTAMPING
+#endif
+
+namespace via
+{
+  namespace comms
+  {
+    /// Whether a SocketAdaptor can timestamp its socket, e.g. tcp_adaptor.
+    template <typename SocketAdaptor, typename = void>
+    struct supports_timestamping : std::false_type
+    {};
+
+    /// Whether a SocketAdaptor can timestamp its socket: it has an
+    /// enable_timestamping function.
+    template <typename SocketAdaptor>
+    struct supports_timestamping<SocketAdaptor,
+                   std::void_t<decltype(&SocketAdaptor::enable_timestamping)>>
+      : std::true_type
+    {};
+
+    /// The latency histograms measured from socket timestamps.
+    struct latency_histograms
+    {
+      /// From the kernel receiving a request to its handler being called.
+      lag_histogram kernel_to_handler;
+      /// From a response being written to the kernel sending it.
+      lag_histogram queued_to_sent;
+      /// From a response being written to the peer acknowledging it.
+      lag_histogram queued_to_acked;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class latency_stats
+    /// The latencies measured from the socket timestamps of a server's
+    /// connections.
+    //////////////////////////////////////////////////////////////////////////
+    class latency_stats
+    {
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_;              ///< protects the histograms.
+#endif
+      latency_histograms histograms_; ///< the latency histograms.
+
+      /// Add a latency to a histogram.
+      /// @param histogram the histogram.
+      /// @param from the start time.
+      /// @param to the end time.
+      void add(lag_histogram& histogram,
+               std::chrono::system_clock::time_point from,
+               std::chrono::system_clock::time_point to)
+      {
+        auto latency(std::chrono::duration_cast<std::chrono::microseconds>
+                       (std::max(to - from,
+                                 std::chrono::system_clock::duration::zero())));
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        histogram.add(latency);
+      }
+
+    public:
+
+      /// Default constructor.
+      latency_stats() :
+#ifdef HTTP_THREAD_SAFE
+        mutex_(),
+#endif
+        histograms_()
+      {}
+
+      /// Add a kernel receive to handler latency.
+      /// @param received the kernel receive timestamp.
+      /// @param handled the time that the handler was called.
+      void add_kernel_to_handler(std::chrono::system_clock::time_point received,
+                                 std::chrono::system_clock::time_point handled)
+      { add(histograms_.kernel_to_handler, received, handled); }
+
+      /// Add a write to kernel send latency.
+      /// @param queued the time that the data was written.
+      /// @param sent the kernel send timestamp.
+      void add_queued_to_sent(std::chrono::system_clock::time_point queued,
+                              std::chrono::system_clock::time_point sent)
+      { add(histograms_.queued_to_sent, queued, sent); }
+
+      /// Add a write to peer acknowledgement latency.
+      /// @param queued the time that the data was written.
+      /// @param acked the kernel acknowledgement timestamp.
+      void add_queued_to_acked(std::chrono::system_clock::time_point queued,
+                               std::chrono::system_clock::time_point acked)
+      { add(histograms_.queued_to_acked, queued, acked); }
+
+      /// A copy of the latency histograms.
+      latency_histograms histograms()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return histograms_;
+      }
+    };
+
+#ifdef VIA_SO_TIMESTAMPING
+    //////////////////////////////////////////////////////////////////////////
+    /// @class socket_timestamps
+    /// Reads a tcp socket with Linux SO_TIMESTAMPING software timestamps.
+    ///
+    /// Asio's read functions discard the control messages that contain the
+    /// receive timestamps, so the socket is read with recvmsg when asio
+    /// reports that it's readable. The timestamp of the last read is kept
+    /// for the request parser.
+    ///
+    /// The kernel also queues a timestamp on the socket's error queue when
+    /// data that has been written is sent and when the peer acknowledges it.
+    /// They're matched to the writes by byte offset and read whenever the
+    /// socket is read or written.
+    ///
+    /// The class is shared with the asio handlers, so that it can detect
+    /// that its socket adaptor has been destroyed, see release.
+    //////////////////////////////////////////////////////////////////////////
+    class socket_timestamps
+      : public std::enable_shared_from_this<socket_timestamps>
+    {
+    public:
+
+      /// The clock of the kernel software timestamps.
+      typedef std::chrono::system_clock clock_type;
+
+      /// The size of a control message buffer.
+      static const size_t CONTROL_SIZE = 256;
+
+    private:
+
+      /// A write waiting for its timestamps.
+      struct tx_record
+      {
+        std::uint32_t last_byte;       ///< the offset of its last byte.
+        clock_type::time_point queued; ///< the time it was written.
+        bool sent;                     ///< whether it's been sent.
+      };
+
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_;                   ///< protects the socket.
+#endif
+      ASIO::ip::tcp::socket* socket_;      ///< the socket, nullptr if released.
+      std::shared_ptr<latency_stats> stats_; ///< the latency statistics.
+      clock_type::time_point rx_time_;     ///< the last receive timestamp.
+      std::uint32_t tx_bytes_;             ///< the number of bytes written.
+      std::deque<tx_record> tx_records_;   ///< the writes to timestamp.
+
+      /// Convert a kernel timestamp to a time_point.
+      static clock_type::time_point to_time_point(timespec const& ts) noexcept
+      {
+        return clock_type::time_point(
+          std::chrono::duration_cast<clock_type::duration>
+            (std::chrono::seconds(ts.tv_sec) +
+             std::chrono::nanoseconds(ts.tv_nsec)));
+      }
+
+      /// Read the software timestamp in a message's control data.
+      /// @param msg the message.
+      /// @param ts the timestamp, unchanged if there isn't one.
+      /// @return the extended error of an error queue message, if any.
+      static sock_extended_err const* read_control(msghdr& msg,
+                                                   clock_type::time_point& ts)
+      {
+        sock_extended_err const* error(nullptr);
+        for (cmsghdr* cmsg(CMSG_FIRSTHDR(&msg)); cmsg;
+             cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+          if ((cmsg->cmsg_level == SOL_SOCKET) &&
+              (cmsg->cmsg_type == SO_TIMESTAMPING))
+          {
+            auto stamps(reinterpret_cast<scm_timestamping const*>
+                          (CMSG_DATA(cmsg)));
+            if (stamps->ts[0].tv_sec || stamps->ts[0].tv_nsec)
+              ts = to_time_point(stamps->ts[0]);
+          }
+          else if (((cmsg->cmsg_level == SOL_IP) &&
+                    (cmsg->cmsg_type == IP_RECVERR)) ||
+                   ((cmsg->cmsg_level == SOL_IPV6) &&
+                    (cmsg->cmsg_type == IPV6_RECVERR)))
+            error = reinterpret_cast<sock_extended_err const*>
+                      (CMSG_DATA(cmsg));
+        }
+        return error;
+      }
+
+      /// Match a transmit timestamp to the writes that it covers.
+      /// @param type the timestamp type: SCM_TSTAMP_SND or SCM_TSTAMP_ACK.
+      /// @param id the offset of the last byte timestamped.
+      /// @param ts the timestamp.
+      void transmitted(std::uint32_t type, std::uint32_t id,
+                       clock_type::time_point ts)
+      {
+        if (type == SCM_TSTAMP_ACK)
+        {
+          while (!tx_records_.empty() &&
+                 (static_cast<std::int32_t>
+                    (tx_records_.front().last_byte - id) <= 0))
+          {
+            stats_->add_queued_to_acked(tx_records_.front().queued, ts);
+            tx_records_.pop_front();
+          }
+        }
+        else if (type == SCM_TSTAMP_SND)
+        {
+          for (auto& record : tx_records_)
+          {
+            if (static_cast<std::int32_t>(record.last_byte - id) > 0)
+              break;
+
+            if (!record.sent)
+            {
+              record.sent = true;
+              stats_->add_queued_to_sent(record.queued, ts);
+            }
+          }
+        }
+      }
+
+      /// Read the transmit timestamps on the socket's error queue.
+      /// @pre the mutex is locked and the socket hasn't been released.
+      void read_timestamps()
+      {
+        char control[CONTROL_SIZE];
+        for (;;)
+        {
+          msghdr msg{};
+          msg.msg_control = control;
+          msg.msg_controllen = sizeof(control);
+          if (::recvmsg(socket_->native_handle(), &msg,
+                        MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+          clock_type::time_point ts;
+          sock_extended_err const* error(read_control(msg, ts));
+          if (error && (error->ee_errno == ENOMSG) &&
+              (error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING) &&
+              (ts != clock_type::time_point()))
+            transmitted(error->ee_info, error->ee_data, ts);
+        }
+      }
+
+      /// Wait for the socket to be readable.
+      /// @pre the mutex is locked and the socket hasn't been released.
+      void wait_read(void* ptr, size_t size, CommsHandler read_handler)
+      {
+        std::shared_ptr<socket_timestamps> self(shared_from_this());
+        socket_->async_wait(ASIO::ip::tcp::socket::wait_read,
+          [self, ptr, size, read_handler](ASIO_ERROR_CODE const& error)
+        { self->receive(error, ptr, size, read_handler); });
+      }
+
+      /// Read the socket when it's readable.
+      /// @param error the asio wait error, if any.
+      /// @param ptr pointer to the receive buffer.
+      /// @param size the size of the receive buffer.
+      /// @param read_handler the handler for received data.
+      void receive(ASIO_ERROR_CODE error, void* ptr, size_t size,
+                   CommsHandler read_handler)
+      {
+        size_t bytes(0u);
+        if (!error)
+        {
+#ifdef HTTP_THREAD_SAFE
+          std::lock_guard<std::mutex> lock(mutex_);
+#endif
+          if (!socket_)
+            error = ASIO::error::operation_aborted;
+          else
+          {
+            read_timestamps();
+
+            iovec iov{ptr, size};
+            char control[CONTROL_SIZE];
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            auto result(::recvmsg(socket_->native_handle(), &msg,
+                                  MSG_DONTWAIT));
+            if (result > 0)
+            {
+              bytes = static_cast<size_t>(result);
+              rx_time_ = clock_type::now();
+              read_control(msg, rx_time_);
+            }
+            else if (result == 0)
+              error = ASIO::error::eof;
+            else if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                     (errno == EINTR))
+            {
+              // Woken by a transmit timestamp, not data
+              wait_read(ptr, size, read_handler);
+              return;
+            }
+            else
+              error = ASIO_ERROR_CODE(errno, ASIO::error::get_system_category());
+          }
+        }
+
+        read_handler(error, bytes);
+      }
+
+    public:
+
+      /// Enable software receive and transmit timestamps on a socket.
+      /// @param socket the connected tcp socket.
+      /// @return true if enabled, false otherwise.
+      static bool enable(ASIO::ip::tcp::socket& socket) noexcept
+      {
+        int flags(SOF_TIMESTAMPING_SOFTWARE |
+                  SOF_TIMESTAMPING_RX_SOFTWARE |
+                  SOF_TIMESTAMPING_TX_SOFTWARE |
+                  SOF_TIMESTAMPING_TX_ACK |
+                  SOF_TIMESTAMPING_OPT_ID |
+                  SOF_TIMESTAMPING_OPT_TSONLY);
+        return ::setsockopt(socket.native_handle(), SOL_SOCKET,
+                            SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+      }
+
+      /// Constructor.
+      /// @pre timestamps have been enabled on the socket, see enable, and
+      /// no data has been written to it.
+      /// @param socket the tcp socket.
+      /// @param stats the latency statistics to update.
+      socket_timestamps(ASIO::ip::tcp::socket& socket,
+                        std::shared_ptr<latency_stats> stats) :
+#ifdef HTTP_THREAD_SAFE
+        mutex_(),
+#endif
+        socket_(&socket),
+        stats_(stats),
+        rx_time_(),
+        tx_bytes_(0u),
+        tx_records_()
+      {}
+
+      /// Disable copy construction.
+      socket_timestamps(socket_timestamps const&) = delete;
+
+      /// Disable assignment.
+      socket_timestamps& operator=(socket_timestamps const&) = delete;
+
+      /// Release the socket, before it's closed or destroyed.
+      /// Pending reads complete with operation_aborted.
+      void release()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        socket_ = nullptr;
+      }
+
+      /// Read data from the socket with its receive timestamp.
+      /// @param ptr pointer to the receive buffer.
+      /// @param size the size of the receive buffer.
+      /// @param read_handler the handler for received data.
+      void read(void* ptr, size_t size, CommsHandler read_handler)
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (socket_)
+          wait_read(ptr, size, read_handler);
+      }
+
+      /// Record data being written to the socket, to match it to its
+      /// transmit timestamps.
+      /// @param bytes the number of bytes being written.
+      void written(size_t bytes)
+      {
+        if (bytes == 0u)
+          return;
+
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (!socket_)
+          return;
+
+        read_timestamps();
+        tx_bytes_ += static_cast<std::uint32_t>(bytes);
+        tx_records_.push_back(tx_record{tx_bytes_ - 1u, clock_type::now(),
+                                        false});
+      }
+
+      /// Read the transmit timestamps that the kernel has queued.
+      void update()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (socket_)
+          read_timestamps();
+      }
+
+      /// The kernel receive timestamp of the last data read.
+      clock_type::time_point rx_time()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return rx_time_;
+      }
+    };
+#endif
+  }
+}
+
+#endif
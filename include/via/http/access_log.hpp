@@ -0,0 +1,380 @@
+#ifndef ACCESS_LOG_HPP_VIA_HTTPLIB_
+#define ACCESS_LOG_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file access_log.hpp
+/// @brief Contains the access_record struct and the access_log class.
+//////////////////////////////////////////////////////////////////////////////
+#include "request.hpp"
+#include "via/thread/ring_buffer.hpp"
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace via
+{
+  namespace http
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @struct access_record
+    /// A fixed size record of a request and its response.
+    /// Strings longer than their fields are truncated.
+    //////////////////////////////////////////////////////////////////////////
+    struct access_record
+    {
+      /// The size of the remote address field, enough for an IPv6 address.
+      static const size_t ADDRESS_SIZE = 48;
+
+      /// The size of the method field.
+      static const size_t METHOD_SIZE  = 8;
+
+      /// The size of the path field.
+      static const size_t PATH_SIZE    = 192;
+
+      std::int64_t  timestamp;   ///< microseconds since the epoch.
+      std::uint64_t latency;     ///< microseconds to respond to the request.
+      std::uint64_t bytes;       ///< the size of the response body.
+      std::uint16_t status;      ///< the response status code.
+      char major_version;        ///< the request major version.
+      char minor_version;        ///< the request minor version.
+      char remote_address[ADDRESS_SIZE]; ///< the client address.
+      char method[METHOD_SIZE];  ///< the request method.
+      char path[PATH_SIZE];      ///< the request uri path.
+
+      /// Create a record for a response to a request.
+      /// @param request the request.
+      /// @param remote_address the remote address of the connection.
+      /// @param status the response status code.
+      /// @param bytes the size of the response body.
+      /// @param latency the time taken to respond to the request.
+      static access_record create(rx_request const& request,
+                                  std::string_view remote_address,
+                                  int status, size_t bytes,
+                                  std::chrono::microseconds latency)
+      {
+        // Value initialise the record, so that its padding is written as zeros
+        access_record record{};
+        record.timestamp = std::chrono::duration_cast<std::chrono::microseconds>
+            (std::chrono::system_clock::now().time_since_epoch()).count();
+        record.latency = static_cast<std::uint64_t>(latency.count());
+        record.bytes   = bytes;
+        record.status  = static_cast<std::uint16_t>(status);
+        record.major_version = request.major_version();
+        record.minor_version = request.minor_version();
+        copy(remote_address, record.remote_address);
+        copy(request.method(), record.method);
+        std::string_view uri(request.uri());
+        copy(uri.substr(0, uri.find('?')), record.path);
+        return record;
+      }
+
+      /// Copy a string into a fixed size field, truncating if necessary.
+      /// @param value the string.
+      /// @retval field the field, always null terminated.
+      template <size_t N>
+      static void copy(std::string_view value, char (&field)[N]) noexcept
+      {
+        size_t size(std::min(value.size(), N - 1));
+        std::memcpy(field, value.data(), size);
+        std::memset(field + size, 0, N - size);
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class access_log
+    /// An asynchronous access log writer.
+    ///
+    /// Threads log access_records into their own lock-free ring buffers,
+    /// a background thread writes them to the log file in batches in either
+    /// Common Log Format or the binary access_record format.
+    /// The file is flushed after each batch and synchronised to disk
+    /// periodically.
+    ///
+    /// If a ring buffer is full, then records are dropped and counted, so
+    /// logging never blocks a thread that's handling requests.
+    //////////////////////////////////////////////////////////////////////////
+    class access_log
+    {
+    public:
+
+      /// The format of the log file.
+      enum class format
+      {
+        COMMON, ///< Common Log Format.
+        BINARY  ///< access_records.
+      };
+
+      /// The default number of records in each thread's ring buffer.
+      static const size_t DEFAULT_BUFFER_SIZE = 4096;
+
+    private:
+
+      /// The ring buffer type.
+      typedef thread::ring_buffer<access_record> ring_buffer_type;
+
+      /// A thread's ring buffer.
+      typedef std::pair<std::thread::id, std::unique_ptr<ring_buffer_type>>
+        thread_buffer_type;
+
+      /// The instance id, so that thread_local caches can't confuse logs.
+      const size_t id_;
+      std::FILE* file_;               ///< the log file.
+      format format_;                 ///< the log file format.
+      size_t buffer_size_;            ///< the size of each ring buffer.
+      std::chrono::milliseconds flush_interval_; ///< batch write interval.
+      std::chrono::milliseconds sync_interval_;  ///< the fsync interval.
+
+      /// Protects buffers_ and running_.
+      std::mutex mutex_;
+      /// Signals the writer thread to stop.
+      std::condition_variable condition_;
+      /// The ring buffers, one for each thread that logs records.
+      std::vector<thread_buffer_type> buffers_;
+      bool running_;                  ///< whether the writer should run.
+
+      std::atomic<std::uint64_t> written_; ///< the number of records written.
+      std::atomic<std::uint64_t> dropped_; ///< the number of records dropped.
+
+      std::thread writer_;            ///< the writer thread.
+
+      /// The next instance id.
+      static size_t next_id()
+      {
+        static std::atomic<size_t> id(0u);
+        return ++id;
+      }
+
+      /// Get the ring buffer for the calling thread, creating it if
+      /// necessary.
+      ring_buffer_type& thread_buffer()
+      {
+        thread_local size_t cached_id(0u);
+        thread_local ring_buffer_type* cached_buffer(nullptr);
+        if (cached_id != id_)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          auto iter(std::find_if(buffers_.begin(), buffers_.end(),
+            [](thread_buffer_type const& elem)
+              { return elem.first == std::this_thread::get_id(); }));
+          if (iter == buffers_.end())
+            iter = buffers_.emplace(buffers_.end(), std::this_thread::get_id(),
+                               std::make_unique<ring_buffer_type>(buffer_size_));
+          cached_buffer = iter->second.get();
+          cached_id = id_;
+        }
+        return *cached_buffer;
+      }
+
+      /// Append a record to the output in Common Log Format.
+      /// @param record the access record.
+      /// @retval output the output.
+      static void format_common(access_record const& record,
+                                std::string& output)
+      {
+        std::time_t seconds(static_cast<std::time_t>
+                            (record.timestamp / 1000000));
+        std::tm time_value;
+#ifdef _WIN32
+        gmtime_s(&time_value, &seconds);
+#else
+        gmtime_r(&seconds, &time_value);
+#endif
+        char date[32];
+        std::strftime(date, sizeof(date), "%d/%b/%Y:%H:%M:%S +0000",
+                      &time_value);
+
+        output += record.remote_address;
+        output += " - - [";
+        output += date;
+        output += "] \"";
+        output += record.method;
+        output += ' ';
+        output += record.path;
+        output += " HTTP/";
+        output += record.major_version;
+        output += '.';
+        output += record.minor_version;
+        output += "\" ";
+        output += std::to_string(record.status);
+        output += ' ';
+        output += (record.bytes == 0) ? std::string("-")
+                                      : std::to_string(record.bytes);
+        output += '\n';
+      }
+
+      /// Write the records in the ring buffers to the log file.
+      void write_records(std::string& output)
+      {
+        output.clear();
+        std::uint64_t count(0u);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          access_record record;
+          for (auto& buffer : buffers_)
+          {
+            while (buffer.second->pop(record))
+            {
+              if (format_ == format::BINARY)
+                output.append(reinterpret_cast<const char*>(&record),
+                              sizeof(record));
+              else
+                format_common(record, output);
+              ++count;
+            }
+          }
+        }
+
+        if (count > 0u)
+        {
+          std::fwrite(output.data(), 1, output.size(), file_);
+          std::fflush(file_);
+          written_ += count;
+        }
+      }
+
+      /// Synchronise the log file with the disk.
+      void sync()
+      {
+#ifdef _WIN32
+        _commit(_fileno(file_));
+#else
+        fsync(fileno(file_));
+#endif
+      }
+
+      /// The writer thread function.
+      void run()
+      {
+        std::string output;
+        auto last_sync(std::chrono::steady_clock::now());
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_)
+        {
+          condition_.wait_for(lock, flush_interval_);
+          lock.unlock();
+
+          write_records(output);
+          auto now(std::chrono::steady_clock::now());
+          if (now - last_sync >= sync_interval_)
+          {
+            sync();
+            last_sync = now;
+          }
+
+          lock.lock();
+        }
+        lock.unlock();
+
+        write_records(output);
+        sync();
+      }
+
+    public:
+
+      /// Constructor, opens the log file and starts the writer thread.
+      /// @param filename the name of the log file, it is appended to.
+      /// @param log_format the format of the log file, default COMMON.
+      /// @param buffer_size the number of records in each thread's ring
+      /// buffer, default DEFAULT_BUFFER_SIZE.
+      /// @param flush_interval the interval between batch writes,
+      /// default 100mS.
+      /// @param sync_interval the interval between synchronising the file
+      /// with the disk, default 1S.
+      explicit access_log(std::string const& filename,
+                          format log_format = format::COMMON,
+                          size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                          std::chrono::milliseconds flush_interval =
+                            std::chrono::milliseconds(100),
+                          std::chrono::milliseconds sync_interval =
+                            std::chrono::milliseconds(1000)) :
+        id_(next_id()),
+        file_(std::fopen(filename.c_str(),
+                         log_format == format::BINARY ? "ab" : "a")),
+        format_(log_format),
+        buffer_size_(buffer_size),
+        flush_interval_(flush_interval),
+        sync_interval_(sync_interval),
+        mutex_(),
+        condition_(),
+        buffers_(),
+        running_(file_ != nullptr),
+        written_(0u),
+        dropped_(0u),
+        writer_()
+      {
+        if (file_)
+          writer_ = std::thread([this]{ run(); });
+      }
+
+      /// Destructor, writes any outstanding records and closes the file.
+      ~access_log()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          running_ = false;
+        }
+        condition_.notify_one();
+
+        if (writer_.joinable())
+          writer_.join();
+        if (file_)
+          std::fclose(file_);
+      }
+
+      /// Disable copy construction.
+      access_log(access_log const& other) = delete;
+
+      /// Disable assignment.
+      access_log& operator=(access_log const& other) = delete;
+
+      /// Whether the log file is open.
+      bool is_open() const noexcept
+      { return file_ != nullptr; }
+
+      /// Log an access record.
+      /// It never blocks: if the calling thread's ring buffer is full, the
+      /// record is dropped.
+      /// @param record the access record.
+      /// @return true if logged, false if dropped.
+      bool log(access_record const& record)
+      {
+        if (file_ && thread_buffer().push(record))
+          return true;
+
+        dropped_.fetch_add(1u, std::memory_order_relaxed);
+        return false;
+      }
+
+      /// The number of records written to the log file.
+      std::uint64_t written() const noexcept
+      { return written_.load(std::memory_order_relaxed); }
+
+      /// The number of records dropped.
+      std::uint64_t dropped() const noexcept
+      { return dropped_.load(std::memory_order_relaxed); }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef BODY_SPOOL_HPP_VIA_HTTPLIB_
+#define BODY_SPOOL_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file body_spool.hpp
+/// @brief Contains the body_spool class.
+//////////////////////////////////////////////////////////////////////////////
+#include <cstdio>
+#include <cstdlib>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+namespace via
+{
+  namespace http
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class body_spool
+    /// An anonymous temporary file to hold a large message body.
+    ///
+    /// On Linux the file is created with O_TMPFILE in the directory given
+    /// by the TMPDIR environment variable (default /tmp), so it never has a
+    /// name and is deleted when it is closed, even if the process crashes.
+    /// Elsewhere, or if the file system does not support O_TMPFILE, it is
+    /// created with std::tmpfile.
+    //////////////////////////////////////////////////////////////////////////
+    class body_spool
+    {
+      std::FILE* file_; ///< the temporary file, nullptr if not open.
+      size_t     size_; ///< the number of bytes written to the file.
+
+      /// Create an anonymous temporary file.
+      /// @return the file, nullptr on failure.
+      static std::FILE* create_file() noexcept
+      {
+#if defined(__linux__) && defined(O_TMPFILE)
+        const char* tmp_dir(std::getenv("TMPDIR"));
+        int fd(::open(((tmp_dir != nullptr) && (*tmp_dir != '\0'))
+                        ? tmp_dir : "/tmp",
+                      O_TMPFILE | O_RDWR | O_EXCL | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR));
+        if (fd >= 0)
+        {
+          std::FILE* file(::fdopen(fd, "w+b"));
+          if (file != nullptr)
+            return file;
+          ::close(fd);
+        }
+#endif
+        return std::tmpfile();
+      }
+
+    public:
+
+      /// Default constructor.
+      body_spool() noexcept :
+        file_(nullptr),
+        size_(0u)
+      {}
+
+      /// Destructor, closes (and so deletes) the file.
+      ~body_spool()
+      { close(); }
+
+      /// Disable copy construction.
+      body_spool(body_spool const&) = delete;
+
+      /// Disable assignment.
+      body_spool& operator=(body_spool const&) = delete;
+
+      /// Move constructor.
+      body_spool(body_spool&& other) noexcept :
+        file_(other.file_),
+        size_(other.size_)
+      {
+        other.file_ = nullptr;
+        other.size_ = 0u;
+      }
+
+      /// Whether the file is open.
+      bool is_open() const noexcept
+      { return file_ != nullptr; }
+
+      /// Open a new temporary file, closing any current file.
+      /// @return true if the file was created, false otherwise.
+      bool open() noexcept
+      {
+        close();
+        file_ = create_file();
+        return file_ != nullptr;
+      }
+
+      /// Append data to the file.
+      /// @pre the file must be open.
+      /// @param data pointer to the data.
+      /// @param size the number of bytes to write.
+      /// @return true if all of the data was written, false otherwise.
+      bool write(const void* data, size_t size) noexcept
+      {
+        if ((size == 0u) || (std::fwrite(data, 1u, size, file_) == size))
+        {
+          size_ += size;
+          return true;
+        }
+        return false;
+      }
+
+      /// Flush the file and set its position to the start, ready to be read.
+      /// @pre the file must be open.
+      /// @return true if successful, false otherwise.
+      bool rewind() noexcept
+      { return (std::fflush(file_) == 0) && (std::fseek(file_, 0L, SEEK_SET) == 0); }
+
+      /// Close the file, which deletes it.
+      void close() noexcept
+      {
+        if (file_ != nullptr)
+        {
+          std::fclose(file_);
+          file_ = nullptr;
+        }
+        size_ = 0u;
+      }
+
+      /// The file, nullptr if not open.
+      std::FILE* file() const noexcept
+      { return file_; }
+
+      /// The file descriptor of the file, e.g. for mmap or sendfile.
+      /// @return the file descriptor, -1 if the file is not open.
+      int fd() const noexcept
+      {
+#if defined(_WIN32)
+        return (file_ != nullptr) ? ::_fileno(file_) : -1;
+#else
+        return (file_ != nullptr) ? ::fileno(file_) : -1;
+#endif
+      }
+
+      /// The number of bytes written to the file.
+      size_t size() const noexcept
+      { return size_; }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CANNED_RESPONSE_HPP_VIA_HTTPLIB_
+#define CANNED_RESPONSE_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file canned_response.hpp
+/// @brief Contains the canned_response class.
+//////////////////////////////////////////////////////////////////////////////
+#include "response.hpp"
+#include <string>
+#include <string_view>
+
+namespace via
+{
+  namespace http
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class canned_response
+    /// A pre-serialised HTTP/1.1 response for a fixed route, e.g. a health
+    /// check or static JSON.
+    ///
+    /// The status line and headers are formatted once, without the Date
+    /// header or the blank line that ends the headers, so that the response
+    /// can be sent as: header(), a Date header line and a CRLF, then body().
+    //////////////////////////////////////////////////////////////////////////
+    class canned_response
+    {
+      tx_response response_; ///< the response, without Date & Server headers.
+      std::string header_;   ///< the serialised status line and headers.
+      std::string body_;     ///< the response body.
+
+    public:
+
+      /// Constructor.
+      /// @pre the response must not contain any split headers.
+      /// @param response the response, it should not contain a Date header.
+      /// @param body the response body.
+      canned_response(tx_response response, std::string_view body) :
+        response_(std::move(response)),
+        header_(),
+        body_(body)
+      {
+        tx_response canned(response_);
+        canned.add_server_header();
+        header_ = canned.message(body_.size());
+        header_.resize(header_.size() - 2u); // remove the final CRLF
+      }
+
+      /// The response status code.
+      int status() const noexcept
+      { return response_.status(); }
+
+      /// The response that was canned, for requests other than HTTP/1.1.
+      tx_response const& response() const noexcept
+      { return response_; }
+
+      /// The serialised status line and headers, without the Date header
+      /// and the final CRLF.
+      std::string const& header() const noexcept
+      { return header_; }
+
+      /// The response body.
+      std::string const& body() const noexcept
+      { return body_; }
+    };
+  }
+}
+
+#endif
@@ -14,13 +14,12 @@
 /// @file character.hpp
 /// @brief Low level functions to classify characters and manipulate strings.
 //////////////////////////////////////////////////////////////////////////////
-#include <cctype>
 #include <string>
 #include <string_view>
 #include <algorithm>
-#include <sstream>
-#include <cstdlib>
-#include <cerrno>
+#include <array>
+#include <charconv>
+#include <cstdint>
 
 namespace via
 {
@@ -29,6 +28,144 @@ namespace via
     /// The standard HTTP line terminator.
     constexpr char CRLF[]{"\r\n"};
 
+    /// @enum char_class the character classes of RFC 7230 and RFC 3986.
+    /// They are bit flags, so classes may be combined in a mask.
+    enum char_class : std::uint16_t
+    {
+      CC_END_OF_LINE  = 0x0001, ///< CR or LF
+      CC_SPACE_OR_TAB = 0x0002, ///< SP or HTAB
+      CC_CTL          = 0x0004, ///< a control character: 0-31 and DEL
+      CC_SEPARATOR    = 0x0008, ///< an RFC 2616 separator character
+      CC_TOKEN        = 0x0010, ///< an RFC 7230 tchar
+      CC_DIGIT        = 0x0020, ///< 0-9
+      CC_HEX_DIGIT    = 0x0040, ///< 0-9, A-F and a-f
+      CC_ALPHA        = 0x0080, ///< A-Z and a-z
+      CC_UPPER        = 0x0100, ///< A-Z
+      CC_UNRESERVED   = 0x0200, ///< an RFC 3986 unreserved character
+      CC_GEN_DELIM    = 0x0400, ///< an RFC 3986 gen-delim character
+      CC_SUB_DELIM    = 0x0800, ///< an RFC 3986 sub-delim character
+      CC_FIELD_CHAR   = 0x1000, ///< an RFC 7230 field-vchar, SP or HTAB
+      CC_URI_CHAR     = 0x2000  ///< an RFC 3986 unreserved, reserved or '%'
+    };
+
+    namespace detail
+    {
+      /// Whether a character is in a string.
+      constexpr bool is_one_of(char c, const char* chars) noexcept
+      {
+        for (; *chars != '\0'; ++chars)
+          if (*chars == c)
+            return true;
+        return false;
+      }
+
+      /// Create the character class table.
+      constexpr std::array<std::uint16_t, 256> make_char_classes() noexcept
+      {
+        std::array<std::uint16_t, 256> table{};
+        for (int i(0); i < 256; ++i)
+        {
+          char c(static_cast<char>(i));
+          std::uint16_t flags(0u);
+          bool digit((i >= '0') && (i <= '9'));
+          bool upper((i >= 'A') && (i <= 'Z'));
+          bool lower((i >= 'a') && (i <= 'z'));
+          bool ctl((i <= 31) || (i == 127));
+          bool separator(is_one_of(c, "()<>@,;:\\\"/[]?={} \t"));
+
+          if ((c == '\r') || (c == '\n'))
+            flags |= CC_END_OF_LINE;
+          if ((c == ' ') || (c == '\t'))
+            flags |= CC_SPACE_OR_TAB | CC_FIELD_CHAR;
+          if (ctl)
+            flags |= CC_CTL;
+          else if (i > 32)
+            flags |= CC_FIELD_CHAR; // VCHAR or obs-text
+          if (separator)
+            flags |= CC_SEPARATOR;
+          if ((i < 127) && !ctl && !separator)
+            flags |= CC_TOKEN;
+          if (digit)
+            flags |= CC_DIGIT | CC_HEX_DIGIT | CC_UNRESERVED;
+          if (((i >= 'A') && (i <= 'F')) || ((i >= 'a') && (i <= 'f')))
+            flags |= CC_HEX_DIGIT;
+          if (upper || lower)
+            flags |= CC_ALPHA | CC_UNRESERVED;
+          if (upper)
+            flags |= CC_UPPER;
+          if (is_one_of(c, "-._~"))
+            flags |= CC_UNRESERVED;
+          if (is_one_of(c, ":/?#[]@"))
+            flags |= CC_GEN_DELIM;
+          if (is_one_of(c, "!$&'()*+,;="))
+            flags |= CC_SUB_DELIM;
+          if ((flags & (CC_UNRESERVED | CC_GEN_DELIM | CC_SUB_DELIM)) ||
+              (c == '%'))
+            flags |= CC_URI_CHAR;
+
+          table[static_cast<size_t>(i)] = flags;
+        }
+        return table;
+      }
+    }
+
+    /// The character class flags of every character.
+    constexpr std::array<std::uint16_t, 256> CHAR_CLASSES
+      { detail::make_char_classes() };
+
+    /// Test whether a character is in any of the character classes.
+    /// @param c the character
+    /// @param classes a mask of char_class flags.
+    /// @return true if the character is in one of the classes, false otherwise.
+    constexpr bool is_char_class(char c, std::uint16_t classes) noexcept
+    { return (CHAR_CLASSES[static_cast<unsigned char>(c)] & classes) != 0u; }
+
+    /// Test whether every character in a range is in the character classes.
+    /// It checks the whole range in one pass without branching on each
+    /// character, so it is faster than testing each character when the
+    /// range is expected to be valid.
+    /// @param begin an iterator to the first character.
+    /// @param end an iterator to the end of the characters.
+    /// @param classes a mask of char_class flags, a character in any of the
+    /// classes is valid.
+    /// @return true if every character is valid, false otherwise.
+    template<typename ForwardIterator>
+    constexpr bool is_all_char_class(ForwardIterator begin, ForwardIterator end,
+                                     std::uint16_t classes) noexcept
+    {
+      bool invalid(false);
+      for (; begin != end; ++begin)
+        invalid |= (CHAR_CLASSES[static_cast<unsigned char>(*begin)]
+                    & classes) == 0u;
+      return !invalid;
+    }
+
+    /// Test whether every character in a string is in the character classes.
+    /// @see is_all_char_class(ForwardIterator, ForwardIterator, std::uint16_t)
+    /// @param chars the string
+    /// @param classes a mask of char_class flags, a character in any of the
+    /// classes is valid.
+    /// @return true if every character is valid, false otherwise.
+    constexpr bool is_all_char_class(std::string_view chars,
+                                     std::uint16_t classes) noexcept
+    { return is_all_char_class(chars.cbegin(), chars.cend(), classes); }
+
+    /// Find the first character in any of the character classes.
+    /// @param begin an iterator to the first character.
+    /// @param end an iterator to the end of the characters.
+    /// @param classes a mask of char_class flags.
+    /// @return an iterator to the first character in one of the classes,
+    /// end if none.
+    template<typename ForwardIterator>
+    ForwardIterator find_char_class(ForwardIterator begin, ForwardIterator end,
+                                    std::uint16_t classes) noexcept
+    {
+      for (; begin != end; ++begin)
+        if (is_char_class(static_cast<char>(*begin), classes))
+          break;
+      return begin;
+    }
+
     /// Test whether a character is an end of line character,
     /// i.e. CR or LF.
     /// @param c the character
@@ -43,97 +180,88 @@ namespace via
     constexpr bool is_space_or_tab(char c) noexcept
     { return (' ' == c) || ('\t' == c); }
 
+    /// Test whether a character is a decimal digit.
+    /// Note: unlike std::isdigit it does not depend upon the locale.
+    /// @param c the character
+    /// @return true if character is 0-9, false otherwise.
+    constexpr bool is_digit(char c) noexcept
+    { return is_char_class(c, CC_DIGIT); }
+
+    /// Test whether a character is a hexadecimal digit.
+    /// @param c the character
+    /// @return true if character is 0-9, A-F or a-f, false otherwise.
+    constexpr bool is_hex_digit(char c) noexcept
+    { return is_char_class(c, CC_HEX_DIGIT); }
+
+    /// Test whether a character is an ASCII letter.
+    /// @param c the character
+    /// @return true if character is A-Z or a-z, false otherwise.
+    constexpr bool is_alpha(char c) noexcept
+    { return is_char_class(c, CC_ALPHA); }
+
+    /// Test whether a character is an ASCII upper case letter.
+    /// @param c the character
+    /// @return true if character is A-Z, false otherwise.
+    constexpr bool is_upper(char c) noexcept
+    { return is_char_class(c, CC_UPPER); }
+
+    /// Convert an ASCII upper case letter to lower case.
+    /// Note: unlike std::tolower it does not depend upon the locale.
+    /// @param c the character
+    /// @return the lower case letter, otherwise the character.
+    constexpr char to_lower(char c) noexcept
+    { return is_upper(c) ? static_cast<char>(c + ('a' - 'A')) : c; }
+
     /// Test whether a character is a control character.
     /// @param c the character
     /// @return true if character is control character, false otherwise.
     constexpr bool is_ctl(char c) noexcept
-    { return ((0 <= c) && (31 >= c)) || (127 ==c); }
+    { return is_char_class(c, CC_CTL); }
 
     /// Test whether a character is a separator character.
     /// @param c the character
     /// @return true if character is a separator character, false otherwise.
-    inline bool is_separator(char c) noexcept
-    {
-      switch (c)
-      {
-      case '(': case ')': case '<': case '>': case '@':
-      case ',': case ';': case ':': case '\\': case '"':
-      case '/': case '[': case ']': case '?': case '=':
-      case '{': case '}': case ' ': case '\t':
-        return true;
-      default:
-        return false;
-      }
-    }
+    constexpr bool is_separator(char c) noexcept
+    { return is_char_class(c, CC_SEPARATOR); }
 
     /// Test whether a sequence of three characters is a percent encoding
     /// character according to RFC 3986.
     /// @param c the characters
     /// @return true if character is a percent encoding character, false otherwise.
-    inline bool is_pct_encoded(char const* c) noexcept
-    { return (c[0] == '%') && std::isxdigit(c[1]) && std::isxdigit(c[2]); }
+    constexpr bool is_pct_encoded(char const* c) noexcept
+    { return (c[0] == '%') && is_hex_digit(c[1]) && is_hex_digit(c[2]); }
 
     /// Test whether a character is a gen-delim according to RFC3986.
     /// @param c the character
     /// @return true if character is a gen-delim character, false otherwise.
-    inline bool is_gen_delim(char c) noexcept
-    {
-      switch (c)
-      {
-      case ':': case '/': case '?': case '#': case '[': case ']': case '@':
-        return true;
-      default:
-        return false;
-      }
-    }
+    constexpr bool is_gen_delim(char c) noexcept
+    { return is_char_class(c, CC_GEN_DELIM); }
 
     /// Test whether a character is a sub-delim according to RFC 3986.
     /// @param c the character
     /// @return true if character is a sub-delim character, false otherwise.
-    inline bool is_sub_delim(char c) noexcept
-    {
-      switch (c)
-      {
-      case '!': case '$': case '&': case '\'': case '(': case ')':
-      case '*': case '+': case ',': case ';': case '=':
-        return true;
-      default:
-        return false;
-      }
-    }
+    constexpr bool is_sub_delim(char c) noexcept
+    { return is_char_class(c, CC_SUB_DELIM); }
 
     /// Test whether a character is a reserved character according to RFC3986.
     /// I.e. whether it is a gen-delim or a sub-delim character.
     /// @param c the character
     /// @return true if character is a reserved character, false otherwise.
-    inline bool is_reserved(char c) noexcept
-    { return is_gen_delim(c) || is_sub_delim(c); }
+    constexpr bool is_reserved(char c) noexcept
+    { return is_char_class(c, CC_GEN_DELIM | CC_SUB_DELIM); }
 
     /// Test whether a character is a unreserved character according to RFC3986.
     /// @param c the character
     /// @return true if character is a unreserved character, false otherwise.
-    inline bool is_unreserved(char c) noexcept
-    {
-      if (std::isalnum(c))
-        return true;
-      else
-      {
-        switch (c)
-        {
-        case '-': case '.': case '_': case '~':
-          return true;
-        default:
-          return false;
-        }
-      }
-    }
+    constexpr bool is_unreserved(char c) noexcept
+    { return is_char_class(c, CC_UNRESERVED); }
 
-    /// Test whether a character is a token character.
-    /// i.e. not a control or separator character.
+    /// Test whether a character is a token character according to RFC 7230.
+    /// i.e. a visible ASCII character that is not a separator character.
     /// @param c the character
     /// @return true if character is a token character, false otherwise.
-    inline bool is_token(char c) noexcept
-    { return !is_ctl(c) && !is_separator(c); }
+    constexpr bool is_token(char c) noexcept
+    { return is_char_class(c, CC_TOKEN); }
 
     /// Convert a digit charcter to an integer.
     /// @pre the character must be a valid digit character.
@@ -155,71 +283,57 @@ namespace via
       return output;
     }
 
+    /// Convert a string of digits in the given base to a number, in one
+    /// pass and without allocating memory.
+    /// @param digits the string, it must contain only digits in the base:
+    /// no sign, prefix or whitespace.
+    /// @param base the number base: 10 or 16.
+    /// @return the number represented by the string, -1 if invalid or if it
+    /// is too large for a std::ptrdiff_t.
+    inline std::ptrdiff_t from_digit_string(std::string_view digits,
+                                            int base) noexcept
+    {
+      const char* const end(digits.data() + digits.size());
+      size_t value(0u);
+      auto [ptr, error](std::from_chars(digits.data(), end, value, base));
+      if ((error != std::errc()) || (ptr != end) ||
+          (value > static_cast<size_t>(PTRDIFF_MAX)))
+        return -1;
+      else
+        return static_cast<std::ptrdiff_t>(value);
+    }
+
     /// Convert a string representing a hexadecimal number to an unsigned int.
     /// @param hex_string the string containing a vald hexadecimal number
     /// @return the number represented by the string, -1 if invalid.
     inline std::ptrdiff_t from_hex_string(std::string_view hex_string) noexcept
-    {
-      // Ensure that the string only contains hexadecimal characters
-      if (!hex_string.empty() &&
-          std::all_of(hex_string.cbegin(), hex_string.cend(),
-                      [](auto c){ return std::isxdigit(c); }))
-      {
-        // Get the length from the hex_string.
-        // Note: strtol may return zero for a string containing zero or if
-        // no valid conversion could be performed. It may also set errno
-        // if the number is out of range...
-        errno = 0;
-        std::ptrdiff_t value(std::strtol(hex_string.data(), 0, 16));
-        if (errno || ((value == 0) && (hex_string[0] != '0')))
-          return -1;
-        else
-          return value;
-      }
-      else
-        return -1;
-    }
+    { return from_digit_string(hex_string, 16); }
 
     /// Convert an unsigned int into a hexadecimal string.
     /// @param number to be represented
     /// @return the string containing the number in hexadecimal.
     inline std::string to_hex_string(size_t number)
     {
-      std::stringstream number_stream;
-      number_stream << std::hex << number;
-      return number_stream.str();
+      char buffer[2 * sizeof(size_t)];
+      auto result(std::to_chars(buffer, buffer + sizeof(buffer), number, 16));
+      return std::string(buffer, result.ptr);
     }
 
     /// Convert a string representing a decimal number to an unsigned int.
     /// @param dec_string the string containing a vald decimal number
     /// @return the number represented by the string, -1 if invalid.
     inline std::ptrdiff_t from_dec_string(std::string_view dec_string) noexcept
-    {
-      // Ensure that the string only contains decimal characters
-      if (!dec_string.empty() &&
-          std::all_of(dec_string.cbegin(), dec_string.cend(),
-                      [](auto c){ return std::isdigit(c); }))
-      {
-        // Get the length from the dec_string.
-        // Note: strtol may return zero for a string containing zero or if
-        // no valid conversion could be performed. It may also set errno
-        // if the number is out of range...
-        errno = 0;
-        std::ptrdiff_t value(std::strtol(dec_string.data(), 0, 10));
-        if (errno || ((value == 0) && (dec_string[0] != '0')))
-          return -1;
-        else
-          return value;
-      }
-      else
-        return -1;
-    }
+    { return from_digit_string(dec_string, 10); }
 
     /// Convert an int into a decimal string.
     /// @param number to be represented
     /// @return the string containing the number in decimal.
     inline std::string to_dec_string(size_t number)
-    { return std::to_string(number); }
+    {
+      char buffer[20]; // the number of digits in the maximum 64 bit number
+      auto result(std::to_chars(buffer, buffer + sizeof(buffer), number));
+      return std::string(buffer, result.ptr);
+    }
   }
 }
 
@@ -16,6 +16,7 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "headers.hpp"
 #include <algorithm>
+#include <charconv>
 
 namespace via
 {
@@ -64,13 +65,15 @@ namespace via
 
       /// Parse an individual character.
       /// @param c the current character to be parsed.
+      /// @param limits the parser limits.
       /// @return true if the character is valid, false otherwise.
-      bool parse_char(char c)
+      template<typename Limits>
+      bool parse_char(char c, Limits const& limits)
       {
         static constexpr size_t MAX_SIZE_DIGITS(16); // enough for a 64 bit number
 
         // Ensure that the overall header length is within limits
-        if (++length_ > max_line_length_)
+        if (++length_ > limits.max_line_length())
           state_ = CHUNK_ERROR_LENGTH;
 
         switch (state_)
@@ -80,7 +83,7 @@ namespace via
           if (is_space_or_tab(c))
           {
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
             {
               state_ = CHUNK_ERROR_WS;
               return false;
@@ -93,7 +96,7 @@ namespace via
           [[fallthrough]]; // intentional fall-through
 
         case CHUNK_SIZE:
-          if (std::isxdigit (c))
+          if (is_hex_digit(c))
           {
             hex_size_.push_back(c);
             // limit the length of the hex string
@@ -109,7 +112,7 @@ namespace via
             {
               size_ = from_hex_string(hex_size_);
               size_read_ = true;
-              if (size_ > max_chunk_size_)
+              if (size_ > limits.max_chunk_size())
               {
                 state_ = CHUNK_ERROR_SIZE;
                 return false;
@@ -126,7 +129,7 @@ namespace via
                   state_ = CHUNK_LF;
                 else // ('\n' == c)
                 {
-                  if (strict_crlf_)
+                  if (limits.strict_crlf())
                     return false;
                   else
                     state_ = CHUNK_VALID;
@@ -143,7 +146,7 @@ namespace via
           if (is_space_or_tab(c))
           {
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
               return false;
             else
               break;
@@ -159,7 +162,7 @@ namespace via
             state_ = CHUNK_LF;
           else // ('\n' == c)
           {
-            if (strict_crlf_)
+            if (limits.strict_crlf())
             {
               state_ = CHUNK_ERROR_CRLF;
               return false;
@@ -249,14 +252,16 @@ namespace via
       /// @retval iter to an iterator to the start of the http chunk.
       /// If parsed sucessfully, it will refer to the start of the data.
       /// @param end the end of the buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
         while ((iter != end) && (CHUNK_VALID != state_))
         {
           char c(*iter++);
-          if (!parse_char(c))
+          if (!parse_char(c, limits))
             return false;
         }
 
@@ -264,11 +269,32 @@ namespace via
         return valid_;
       }
 
+      /// Parse an http 1.1 chunk size line using the constructor limits.
+      /// @retval iter to an iterator to the start of the http chunk.
+      /// If parsed sucessfully, it will refer to the start of the data.
+      /// @param end the end of the buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
       /// Accessor for the strict crlf parsing state.
       /// @return the strict_crlf_ state.
       bool strict_crlf() const noexcept
       { return strict_crlf_; }
 
+      /// Accessor for the max no of consectutive whitespace characters.
+      unsigned char max_whitespace() const noexcept
+      { return max_whitespace_; }
+
+      /// Accessor for the max length of a chunk size line.
+      unsigned short max_line_length() const noexcept
+      { return max_line_length_; }
+
+      /// Accessor for the maximum size of a chunk body.
+      size_t max_chunk_size() const noexcept
+      { return max_chunk_size_; }
+
       /// Accessor for the chunk size.
       /// @return the chunk size in bytes.
       size_t size() const noexcept
@@ -334,6 +360,80 @@ namespace via
       }
     }; // class chunk_header
 
+    //////////////////////////////////////////////////////////////////////////
+    /// @class chunk_size_line
+    /// The size line of a chunk without an extension: the size in
+    /// hexadecimal and a CRLF, formatted into fixed storage.
+    //////////////////////////////////////////////////////////////////////////
+    class chunk_size_line
+    {
+      /// The maximum length of a chunk size line.
+      static constexpr size_t MAX_LENGTH = 2 * sizeof(size_t) + 2;
+
+      char   line_[MAX_LENGTH]; ///< the chunk size line
+      size_t length_;           ///< the length of the chunk size line
+
+    public:
+
+      /// Constructor.
+      /// @param size the size of the chunk in bytes.
+      explicit chunk_size_line(size_t size = 0u) noexcept :
+        line_{},
+        length_(0u)
+      {
+        char* end(std::to_chars(line_, line_ + MAX_LENGTH - 2, size, 16).ptr);
+        *end++ = '\r';
+        *end++ = '\n';
+        length_ = static_cast<size_t>(end - line_);
+      }
+
+      /// The chunk size line.
+      char const* data() const noexcept
+      { return line_; }
+
+      /// The length of the chunk size line, including the CRLF.
+      size_t size() const noexcept
+      { return length_; }
+    };
+
+    /// Append the size line of a chunk to a frame.
+    /// @retval frame the frame to append the size line to.
+    /// @param size the size of the chunk in bytes.
+    /// @param extension the (optional) chunk extension.
+    template <typename Container>
+    void encode_chunk_header(Container& frame, size_t size,
+                             std::string_view extension = std::string_view())
+    {
+      chunk_size_line line(size);
+      if (extension.empty())
+        frame.insert(frame.end(), line.data(), line.data() + line.size());
+      else
+      {
+        frame.insert(frame.end(), line.data(), line.data() + line.size() - 2);
+        frame.insert(frame.end(), {';', ' '});
+        frame.insert(frame.end(), extension.cbegin(), extension.cend());
+        frame.insert(frame.end(), CRLF, CRLF + 2);
+      }
+    }
+
+    /// Append a chunk to a frame, so that the chunk can be sent in one
+    /// write and consecutive small chunks can be combined in one frame.
+    /// @retval frame the frame to append the chunk to.
+    /// @param data pointer to the chunk data.
+    /// @param size the size of the chunk in bytes.
+    /// @param extension the (optional) chunk extension.
+    template <typename Container>
+    void encode_chunk(Container& frame, char const* data, size_t size,
+                      std::string_view extension = std::string_view())
+    {
+      frame.reserve(frame.size() + (2 * sizeof(size_t) + 2) +
+                    (extension.empty() ? 0u : extension.size() + 2u) +
+                    size + 2u);
+      encode_chunk_header(frame, size, extension);
+      frame.insert(frame.end(), data, data + size);
+      frame.insert(frame.end(), CRLF, CRLF + 2);
+    }
+
     //////////////////////////////////////////////////////////////////////////
     /// @class rx_chunk
     /// A class to receive an HTTP chunk.
@@ -402,17 +502,19 @@ namespace via
       ///   - the start of the next http message, or
       ///   - the end of the data buffer.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
-        if (!chunk_header::valid() && !chunk_header::parse(iter, end))
+        if (!chunk_header::valid() && !chunk_header::parse(iter, end, limits))
           return false;
 
         // Only the last chunk has a trailer.
         if (chunk_header::is_last())
         {
-          if (!trailers_.parse(iter, end))
+          if (!trailers_.parse(iter, end, limits))
             return false;
         }
         else
@@ -437,7 +539,7 @@ namespace via
               ++iter;
             else
             { // enforce if strict
-              if (strict_crlf())
+              if (limits.strict_crlf())
                 return false;
             }
 
@@ -459,6 +561,22 @@ namespace via
         return valid_;
       }
 
+      /// Parse an HTTP chunk using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the max no of trailer fields.
+      unsigned short max_header_number() const noexcept
+      { return trailers_.max_header_number(); }
+
+      /// Accessor for the max cumulative length of the trailer fields.
+      size_t max_header_length() const noexcept
+      { return trailers_.max_header_length(); }
+
       /// Accessor for the chunk message trailers.
       /// @return a constant reference to the trailer message_headers
       const message_headers& trailers() const noexcept
@@ -0,0 +1,204 @@
+#ifndef ETAG_HPP_VIA_HTTPLIB_
+#define ETAG_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file etag.hpp
+/// @brief Functions to create and compare HTTP entity tags.
+/// See RFC7232 Section 2.3.
+//////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+namespace via
+{
+  namespace http
+  {
+    namespace detail
+    {
+      constexpr uint64_t XXH_PRIME64_1 = 11400714785074694791ULL;
+      constexpr uint64_t XXH_PRIME64_2 = 14029467366897019727ULL;
+      constexpr uint64_t XXH_PRIME64_3 =  1609587929392839161ULL;
+      constexpr uint64_t XXH_PRIME64_4 =  9650029242287828579ULL;
+      constexpr uint64_t XXH_PRIME64_5 =  2870177450012600261ULL;
+
+      inline uint64_t rotl64(uint64_t x, int r) noexcept
+      { return (x << r) | (x >> (64 - r)); }
+
+      /// Read a little endian 64 bit value.
+      inline uint64_t read64(unsigned char const* p) noexcept
+      {
+        uint64_t value(0u);
+        for (int i(7); i >= 0; --i)
+          value = (value << 8) | p[i];
+        return value;
+      }
+
+      /// Read a little endian 32 bit value.
+      inline uint64_t read32(unsigned char const* p) noexcept
+      {
+        return static_cast<uint64_t>(p[0])        |
+               (static_cast<uint64_t>(p[1]) << 8)  |
+               (static_cast<uint64_t>(p[2]) << 16) |
+               (static_cast<uint64_t>(p[3]) << 24);
+      }
+
+      inline uint64_t xxh64_round(uint64_t acc, uint64_t input) noexcept
+      {
+        acc += input * XXH_PRIME64_2;
+        return rotl64(acc, 31) * XXH_PRIME64_1;
+      }
+
+      inline uint64_t xxh64_merge(uint64_t acc, uint64_t value) noexcept
+      {
+        acc ^= xxh64_round(0u, value);
+        return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+      }
+    }
+
+    /// The XXH64 hash of some data: a fast, non-cryptographic hash.
+    /// @param data pointer to the data.
+    /// @param size the size of the data.
+    /// @param seed the hash seed, default zero.
+    /// @return the 64 bit hash of the data.
+    inline uint64_t xxh64(void const* data, size_t size,
+                          uint64_t seed = 0u) noexcept
+    {
+      using namespace detail;
+      unsigned char const* p(static_cast<unsigned char const*>(data));
+      unsigned char const* const end(p + size);
+      uint64_t hash;
+
+      if (size >= 32u)
+      {
+        uint64_t v1(seed + XXH_PRIME64_1 + XXH_PRIME64_2);
+        uint64_t v2(seed + XXH_PRIME64_2);
+        uint64_t v3(seed);
+        uint64_t v4(seed - XXH_PRIME64_1);
+
+        for (unsigned char const* const limit(end - 32); p <= limit; p += 32)
+        {
+          v1 = xxh64_round(v1, read64(p));
+          v2 = xxh64_round(v2, read64(p + 8));
+          v3 = xxh64_round(v3, read64(p + 16));
+          v4 = xxh64_round(v4, read64(p + 24));
+        }
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge(hash, v1);
+        hash = xxh64_merge(hash, v2);
+        hash = xxh64_merge(hash, v3);
+        hash = xxh64_merge(hash, v4);
+      }
+      else
+        hash = seed + XXH_PRIME64_5;
+
+      hash += static_cast<uint64_t>(size);
+
+      for (; (end - p) >= 8; p += 8)
+      {
+        hash ^= xxh64_round(0u, read64(p));
+        hash = rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+      }
+
+      if ((end - p) >= 4)
+      {
+        hash ^= read32(p) * XXH_PRIME64_1;
+        hash = rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+      }
+
+      for (; p < end; ++p)
+      {
+        hash ^= (*p) * XXH_PRIME64_5;
+        hash = rotl64(hash, 11) * XXH_PRIME64_1;
+      }
+
+      hash ^= hash >> 33;
+      hash *= XXH_PRIME64_2;
+      hash ^= hash >> 29;
+      hash *= XXH_PRIME64_3;
+      hash ^= hash >> 32;
+      return hash;
+    }
+
+    /// A strong entity tag for a response body: the XXH64 hash of the body
+    /// as 16 hexadecimal digits in double quotes.
+    /// @param body pointer to the response body.
+    /// @param size the size of the response body.
+    /// @return the entity tag, e.g. "\"44bc2cf5ad770999\"".
+    inline std::string strong_etag(void const* body, size_t size)
+    {
+      static constexpr char HEX_DIGITS[] {"0123456789abcdef"};
+      uint64_t hash(xxh64(body, size));
+
+      std::string etag(18u, '"');
+      for (size_t i(16u); i > 0u; --i, hash >>= 4)
+        etag[i] = HEX_DIGITS[hash & 0x0f];
+      return etag;
+    }
+
+    /// A strong entity tag for a version tag supplied by an application.
+    /// @param version the version tag, it must not contain '"' characters.
+    /// @return the version tag in double quotes.
+    inline std::string version_etag(std::string_view version)
+    {
+      std::string etag;
+      etag.reserve(version.size() + 2u);
+      etag += '"';
+      etag += version;
+      etag += '"';
+      return etag;
+    }
+
+    /// Whether an If-None-Match header matches an entity tag.
+    /// Uses the weak comparison function, see RFC7232 Section 3.2.
+    /// @param if_none_match the value of the If-None-Match header.
+    /// @param etag the entity tag of the current representation.
+    /// @return true if the header is "*" or contains the entity tag.
+    inline bool if_none_match(std::string_view if_none_match,
+                              std::string_view etag) noexcept
+    {
+      if ((etag.size() > 2u) && (etag[0] == 'W') && (etag[1] == '/'))
+        etag.remove_prefix(2u);
+
+      size_t pos(0u);
+      while (pos < if_none_match.size())
+      {
+        size_t comma(if_none_match.find(',', pos));
+        if (comma == std::string_view::npos)
+          comma = if_none_match.size();
+
+        std::string_view tag(if_none_match.substr(pos, comma - pos));
+        size_t first(tag.find_first_not_of(" \t"));
+        if (first != std::string_view::npos)
+        {
+          tag = tag.substr(first, tag.find_last_not_of(" \t") - first + 1u);
+          if (tag == "*")
+            return true;
+
+          if ((tag.size() > 2u) && (tag[0] == 'W') && (tag[1] == '/'))
+            tag.remove_prefix(2u);
+          if (tag == etag)
+            return true;
+        }
+
+        pos = comma + 1u;
+      }
+
+      return false;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,598 @@
+#ifndef FORM_DATA_HPP_VIA_HTTPLIB_
+#define FORM_DATA_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file form_data.hpp
+/// @brief Incremental parsers for HTML form bodies:
+/// application/x-www-form-urlencoded and multipart/form-data.
+///
+/// The parsers are given the body as it's received, e.g. in request chunks,
+/// and call their handlers as soon as each field or part of a field is
+/// complete, so large file parts don't have to be buffered in memory.
+//////////////////////////////////////////////////////////////////////////////
+#include "character.hpp"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstring>
+
+namespace via
+{
+  namespace http
+  {
+    /// Decode an application/x-www-form-urlencoded string: '+' characters
+    /// are decoded to spaces and percent encoded characters are decoded.
+    /// @param encoded the encoded string.
+    /// @retval decoded the decoded string.
+    /// @return true if decoded, false if it contained an invalid percent
+    /// encoding.
+    inline bool form_decode(std::string_view encoded, std::string& decoded)
+    {
+      decoded.clear();
+      for (size_t i(0u); i < encoded.size(); ++i)
+      {
+        char c(encoded[i]);
+        if (c == '+')
+          decoded.push_back(' ');
+        else if (c == '%')
+        {
+          if ((i + 2u >= encoded.size()) || !is_pct_encoded(&encoded[i]))
+            return false;
+
+          decoded.push_back(static_cast<char>
+                              (from_hex_string(encoded.substr(i + 1u, 2u))));
+          i += 2u;
+        }
+        else
+          decoded.push_back(c);
+      }
+
+      return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class urlencoded_parser
+    /// An incremental parser for application/x-www-form-urlencoded bodies.
+    ///
+    /// Only the current field is buffered: its decoded name and value are
+    /// passed to the field handler as soon as the '&' after it (or the end
+    /// of the body) is received.
+    //////////////////////////////////////////////////////////////////////////
+    class urlencoded_parser
+    {
+    public:
+
+      /// The field handler type.
+      /// @param name the decoded field name.
+      /// @param value the decoded field value.
+      typedef std::function<void (std::string_view name,
+                                  std::string_view value)> FieldHandler;
+
+      /// The default maximum length of an encoded field.
+      static const size_t DEFAULT_MAX_FIELD_LENGTH = 8190;
+
+    private:
+
+      FieldHandler field_handler_; ///< the field handler.
+      size_t max_field_length_;    ///< the maximum encoded field length.
+      std::string field_;          ///< the encoded field being received.
+      std::string name_;           ///< the decoded field name.
+      std::string value_;          ///< the decoded field value.
+      bool fail_;                  ///< whether the body is invalid.
+
+      /// Decode the current field and pass it to the field handler.
+      bool end_field()
+      {
+        if (!field_.empty())
+        {
+          std::string_view field(field_);
+          size_t equals(field.find('='));
+          if (!form_decode(field.substr(0, equals), name_) ||
+              !form_decode((equals == std::string_view::npos) ?
+                             std::string_view() : field.substr(equals + 1u),
+                           value_))
+            return false;
+
+          field_handler_(name_, value_);
+          field_.clear();
+        }
+
+        return true;
+      }
+
+    public:
+
+      /// Constructor.
+      /// @param field_handler the handler for decoded fields.
+      /// @param max_field_length the maximum length of an encoded field,
+      /// default DEFAULT_MAX_FIELD_LENGTH.
+      explicit urlencoded_parser(FieldHandler field_handler,
+                     size_t max_field_length = DEFAULT_MAX_FIELD_LENGTH) :
+        field_handler_(field_handler),
+        max_field_length_(max_field_length),
+        field_(),
+        name_(),
+        value_(),
+        fail_(false)
+      {}
+
+      /// Parse the next part of the body.
+      /// @param data pointer to the data.
+      /// @param size the size of the data.
+      /// @return true if valid so far, false if the body is invalid.
+      bool parse(const char* data, size_t size)
+      {
+        const char* end(data + size);
+        while (!fail_ && (data != end))
+        {
+          const char* amp(static_cast<const char*>
+                            (std::memchr(data, '&', end - data)));
+          const char* field_end(amp ? amp : end);
+          if (field_.size() + static_cast<size_t>(field_end - data)
+                > max_field_length_)
+            fail_ = true;
+          else
+          {
+            field_.append(data, field_end);
+            if (amp)
+            {
+              fail_ = !end_field();
+              ++field_end;
+            }
+            data = field_end;
+          }
+        }
+
+        return !fail_;
+      }
+
+      /// Parse the next part of the body.
+      /// @param data the data.
+      /// @return true if valid so far, false if the body is invalid.
+      bool parse(std::string_view data)
+      { return parse(data.data(), data.size()); }
+
+      /// Complete the body, passing the last field to the field handler.
+      /// @return true if the body is valid, false otherwise.
+      bool finish()
+      {
+        if (!fail_)
+          fail_ = !end_field();
+        return !fail_;
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class form_part
+    /// The headers of a part of a multipart/form-data body.
+    //////////////////////////////////////////////////////////////////////////
+    class form_part
+    {
+      /// The headers: lower case names and values.
+      std::vector<std::pair<std::string, std::string>> headers_;
+      std::string name_;     ///< the name from the Content-Disposition.
+      std::string filename_; ///< the filename from the Content-Disposition.
+
+      /// Get a parameter from a header value, e.g. name="field1".
+      /// @param value the header value.
+      /// @param parameter the parameter name with '=', e.g. "name=".
+      static std::string get_parameter(std::string_view value,
+                                       std::string_view parameter)
+      {
+        size_t pos(0u);
+        while ((pos = value.find(parameter, pos)) != std::string_view::npos)
+        {
+          // The parameter must follow a ';' and optional whitespace.
+          size_t before(pos);
+          while ((before > 0u) && is_space_or_tab(value[before - 1u]))
+            --before;
+          if ((before > 0u) && (value[before - 1u] == ';'))
+            break;
+          pos += parameter.size();
+        }
+
+        if (pos == std::string_view::npos)
+          return std::string();
+
+        value.remove_prefix(pos + parameter.size());
+        if (!value.empty() && (value[0] == '"'))
+        {
+          value.remove_prefix(1u);
+          return std::string(value.substr(0, value.find('"')));
+        }
+
+        return std::string(value.substr(0, value.find(';')));
+      }
+
+    public:
+
+      /// Default constructor.
+      form_part() :
+        headers_(),
+        name_(),
+        filename_()
+      {}
+
+      /// Clear the part.
+      void clear() noexcept
+      {
+        headers_.clear();
+        name_.clear();
+        filename_.clear();
+      }
+
+      /// Add a header.
+      /// @param name the lower case header name.
+      /// @param value the header value.
+      void add_header(std::string name, std::string value)
+      {
+        if (name == "content-disposition")
+        {
+          name_     = get_parameter(value, "name=");
+          filename_ = get_parameter(value, "filename=");
+        }
+        headers_.emplace_back(std::move(name), std::move(value));
+      }
+
+      /// Find the value of a header.
+      /// @param name the lower case header name.
+      /// @return the value, blank if not found.
+      std::string_view find(std::string_view name) const noexcept
+      {
+        for (auto const& header : headers_)
+          if (header.first == name)
+            return header.second;
+        return std::string_view();
+      }
+
+      /// The headers, lower case names and values.
+      std::vector<std::pair<std::string, std::string>> const& headers()
+        const noexcept
+      { return headers_; }
+
+      /// The form field name from the Content-Disposition header.
+      std::string const& name() const noexcept
+      { return name_; }
+
+      /// The filename from the Content-Disposition header, if any.
+      std::string const& filename() const noexcept
+      { return filename_; }
+
+      /// The Content-Type header value, if any.
+      std::string_view content_type() const noexcept
+      { return find("content-type"); }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class multipart_parser
+    /// An incremental parser for multipart/form-data bodies, see RFC 7578.
+    ///
+    /// When a part's headers have been received, the part handler is called.
+    /// The part's data is then passed to the data handler in views of the
+    /// received data as it arrives, followed by a call to the part end
+    /// handler. Only the headers of each part are buffered.
+    ///
+    /// The boundary delimiters are found by searching for their leading CR
+    /// with std::memchr, which the standard library vectorises.
+    //////////////////////////////////////////////////////////////////////////
+    class multipart_parser
+    {
+    public:
+
+      /// The part handler type, called when a part's headers are received.
+      typedef std::function<void (form_part const&)> PartHandler;
+
+      /// The data handler type, called with each piece of a part's data.
+      typedef std::function<void (form_part const&, std::string_view data)>
+        DataHandler;
+
+      /// The default maximum length of a part's headers.
+      static const size_t DEFAULT_MAX_HEADER_LENGTH = 8190;
+
+      /// The parser states.
+      enum state
+      {
+        PREAMBLE,     ///< searching for the first delimiter.
+        DELIMITER_1,  ///< the first character after a delimiter.
+        DELIMITER_2,  ///< the second character after a delimiter.
+        HEADERS,      ///< receiving a part's headers.
+        DATA,         ///< receiving a part's data.
+        EPILOGUE,     ///< after the close delimiter.
+        FAILED        ///< the body is invalid.
+      };
+
+    private:
+
+      PartHandler part_handler_;   ///< the part handler.
+      DataHandler data_handler_;   ///< the data handler.
+      PartHandler part_end_handler_; ///< the part end handler.
+      size_t max_header_length_;   ///< the maximum length of part headers.
+      std::string delimiter_;      ///< CRLF "--" boundary.
+      size_t matched_;             ///< the delimiter characters matched.
+      state state_;                ///< the parser state.
+      bool is_close_;              ///< whether the delimiter is the close.
+      std::string line_;           ///< the header line being received.
+      size_t header_length_;       ///< the length of the part's headers.
+      form_part part_;             ///< the current part.
+
+      /// Pass data to the data handler, unless in the preamble.
+      void data(const char* data, size_t size)
+      {
+        if ((state_ == DATA) && (size > 0u))
+          data_handler_(part_, std::string_view(data, size));
+      }
+
+      /// Search for the delimiter, passing any data before it to the
+      /// data handler.
+      /// @return a pointer to the character after the delimiter if found,
+      /// end otherwise.
+      const char* find_delimiter(const char* iter, const char* end,
+                                 bool& found)
+      {
+        found = false;
+
+        // Continue matching a delimiter split across buffers.
+        if (matched_ > 0u)
+        {
+          while ((iter != end) && (matched_ < delimiter_.size()) &&
+                 (*iter == delimiter_[matched_]))
+          {
+            ++iter;
+            ++matched_;
+          }
+
+          if (matched_ == delimiter_.size())
+          {
+            matched_ = 0u;
+            found = true;
+            return iter;
+          }
+
+          if (iter == end)
+            return end;
+
+          // Not a delimiter: the matched characters are data.
+          // Note: a boundary can't contain CR, so no delimiter can start
+          // within the matched characters.
+          data(delimiter_.data(), matched_);
+          matched_ = 0u;
+        }
+
+        const char* start(iter);
+        while (iter != end)
+        {
+          const char* cr(static_cast<const char*>
+                           (std::memchr(iter, '\r', end - iter)));
+          if (!cr)
+            break;
+
+          size_t available(static_cast<size_t>(end - cr));
+          size_t length(std::min(available, delimiter_.size()));
+          if (std::memcmp(cr, delimiter_.data(), length) == 0)
+          {
+            data(start, static_cast<size_t>(cr - start));
+            if (length == delimiter_.size())
+            {
+              found = true;
+              return cr + length;
+            }
+
+            // A partial delimiter at the end of the buffer.
+            matched_ = length;
+            return end;
+          }
+
+          iter = cr + 1;
+        }
+
+        data(start, static_cast<size_t>(end - start));
+        return end;
+      }
+
+      /// Parse a header line.
+      /// @return true if valid, false otherwise.
+      bool parse_header_line()
+      {
+        size_t colon(line_.find(':'));
+        if ((colon == 0u) || (colon == std::string::npos))
+          return false;
+
+        std::string name(line_.substr(0, colon));
+        std::transform(name.begin(), name.end(), name.begin(), to_lower);
+
+        size_t start(line_.find_first_not_of(" \t", colon + 1u));
+        size_t last(line_.find_last_not_of(" \t"));
+        std::string value((start == std::string::npos) ? std::string()
+                          : line_.substr(start, last + 1u - start));
+        part_.add_header(std::move(name), std::move(value));
+        return true;
+      }
+
+      /// Receive the part's headers.
+      /// @return a pointer to the next character.
+      const char* parse_headers(const char* iter, const char* end)
+      {
+        while ((iter != end) && (state_ == HEADERS))
+        {
+          const char* lf(static_cast<const char*>
+                           (std::memchr(iter, '\n', end - iter)));
+          const char* line_end(lf ? lf : end);
+          header_length_ += static_cast<size_t>(line_end - iter);
+          if (header_length_ > max_header_length_)
+          {
+            state_ = FAILED;
+            return end;
+          }
+
+          line_.append(iter, line_end);
+          if (!lf)
+            return end;
+
+          iter = lf + 1;
+          if (!line_.empty() && (line_.back() == '\r'))
+            line_.pop_back();
+
+          if (line_.empty())
+          {
+            state_ = DATA;
+            part_handler_(part_);
+          }
+          else if (!parse_header_line())
+          {
+            state_ = FAILED;
+            return end;
+          }
+          line_.clear();
+        }
+
+        return iter;
+      }
+
+    public:
+
+      /// Constructor.
+      /// @param boundary the boundary from the Content-Type header.
+      /// @see boundary
+      /// @param part_handler the handler for a part's headers.
+      /// @param data_handler the handler for a part's data.
+      /// @param part_end_handler the handler for the end of a part.
+      /// @param max_header_length the maximum length of a part's headers,
+      /// default DEFAULT_MAX_HEADER_LENGTH.
+      multipart_parser(std::string_view boundary,
+                       PartHandler part_handler,
+                       DataHandler data_handler,
+                       PartHandler part_end_handler,
+                       size_t max_header_length = DEFAULT_MAX_HEADER_LENGTH) :
+        part_handler_(part_handler),
+        data_handler_(data_handler),
+        part_end_handler_(part_end_handler),
+        max_header_length_(max_header_length),
+        delimiter_(std::string(CRLF) + "--" + std::string(boundary)),
+        matched_(2u), // the body may start with the delimiter without a CRLF
+        state_(boundary.empty() ? FAILED : PREAMBLE),
+        is_close_(false),
+        line_(),
+        header_length_(0u),
+        part_()
+      {}
+
+      /// Get the boundary parameter from a Content-Type header value.
+      /// @param content_type the Content-Type header value, e.g.
+      /// multipart/form-data; boundary=abc
+      /// @return the boundary, blank if not found.
+      static std::string boundary(std::string_view content_type)
+      {
+        size_t pos(content_type.find("boundary="));
+        if (pos == std::string_view::npos)
+          return std::string();
+
+        content_type.remove_prefix(pos + 9u);
+        if (!content_type.empty() && (content_type[0] == '"'))
+        {
+          content_type.remove_prefix(1u);
+          return std::string(content_type.substr(0, content_type.find('"')));
+        }
+
+        return std::string(content_type.substr
+                             (0, content_type.find_first_of("; \t")));
+      }
+
+      /// Parse the next part of the body.
+      /// @param data pointer to the data.
+      /// @param size the size of the data.
+      /// @return true if valid so far, false if the body is invalid.
+      bool parse(const char* data, size_t size)
+      {
+        const char* iter(data);
+        const char* end(data + size);
+        while ((iter != end) && (state_ != FAILED) && (state_ != EPILOGUE))
+        {
+          switch (state_)
+          {
+          case PREAMBLE:
+          case DATA:
+            {
+              bool found(false);
+              iter = find_delimiter(iter, end, found);
+              if (found)
+              {
+                if (state_ == DATA)
+                  part_end_handler_(part_);
+                state_ = DELIMITER_1;
+              }
+            }
+            break;
+
+          case DELIMITER_1:
+            if (*iter == '-')
+            {
+              is_close_ = true;
+              state_ = DELIMITER_2;
+            }
+            else if (*iter == '\r')
+            {
+              is_close_ = false;
+              state_ = DELIMITER_2;
+            }
+            else if (!is_space_or_tab(*iter)) // transport padding
+              state_ = FAILED;
+            ++iter;
+            break;
+
+          case DELIMITER_2:
+            if (is_close_ && (*iter == '-'))
+              state_ = EPILOGUE;
+            else if (!is_close_ && (*iter == '\n'))
+            {
+              part_.clear();
+              header_length_ = 0u;
+              state_ = HEADERS;
+            }
+            else
+              state_ = FAILED;
+            ++iter;
+            break;
+
+          case HEADERS:
+            iter = parse_headers(iter, end);
+            break;
+
+          default:
+            iter = end;
+            break;
+          }
+        }
+
+        return state_ != FAILED;
+      }
+
+      /// Parse the next part of the body.
+      /// @param data the data.
+      /// @return true if valid so far, false if the body is invalid.
+      bool parse(std::string_view data)
+      { return parse(data.data(), data.size()); }
+
+      /// The parser state.
+      state get_state() const noexcept
+      { return state_; }
+
+      /// Whether the close delimiter has been received.
+      bool is_complete() const noexcept
+      { return state_ == EPILOGUE; }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,403 @@
+#ifndef HANDLER_WATCHDOG_HPP_VIA_HTTPLIB_
+#define HANDLER_WATCHDOG_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file handler_watchdog.hpp
+/// @brief Contains the handler_watchdog class, which reports request
+/// handlers that run for longer than a time budget.
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if !defined(_WIN32) && __has_include(<execinfo.h>)
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#define VIA_HANDLER_WATCHDOG_BACKTRACE
+#endif
+
+namespace via
+{
+  namespace http
+  {
+    /// A report of a request handler that has run for longer than the
+    /// handler_watchdog budget.
+    struct slow_handler
+    {
+      std::string route;          ///< the request uri path.
+      std::string remote_address; ///< the remote address of the connection.
+      std::chrono::milliseconds elapsed; ///< the time in the handler so far.
+      /// The symbolised stack of the thread running the handler, empty if
+      /// stack capture is not supported.
+      std::vector<std::string> stack;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class handler_watchdog
+    /// A watchdog thread that reports request handlers that run for longer
+    /// than a time budget, e.g. because they block on I/O.
+    ///
+    /// The threads that call request handlers enter a scope for each call.
+    /// The watchdog thread checks the scopes periodically and reports a
+    /// handler call once, when it exceeds the budget, with its route, the
+    /// remote address of its connection and the stack of its thread.
+    ///
+    /// The stack is captured by sending a signal (default SIGUSR2) to the
+    /// thread running the handler, whose signal handler records the return
+    /// addresses with backtrace(3). The watchdog thread then symbolises them.
+    /// Stack capture requires execinfo.h and POSIX signals, e.g. Linux and
+    /// macOS. Link with -rdynamic to get function names from executables.
+    //////////////////////////////////////////////////////////////////////////
+    class handler_watchdog
+    {
+    public:
+
+      /// The function called with the report of a slow handler.
+      /// It's called on the watchdog thread.
+      typedef std::function<void (slow_handler const&)> ReportHandler;
+
+      /// The maximum number of stack frames captured.
+      static const int MAX_FRAMES = 64;
+
+    private:
+
+      typedef std::chrono::steady_clock clock_type;
+
+      /// The state of a thread that calls request handlers.
+      struct thread_slot
+      {
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+        pthread_t thread;                 ///< the thread.
+#endif
+        std::atomic<std::int64_t> start;  ///< the handler start time, 0 idle.
+        std::atomic<std::uint64_t> call;  ///< the handler call number.
+        std::uint64_t reported;           ///< the last call reported.
+        std::mutex mutex;                 ///< protects route and address.
+        std::string route;                ///< the route of the call.
+        std::string remote_address;       ///< the remote address of the call.
+        void* frames[MAX_FRAMES];         ///< the captured stack frames.
+        std::atomic<int> frame_count;     ///< the number of frames, -1 busy.
+
+        thread_slot() :
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+          thread(pthread_self()),
+#endif
+          start(0),
+          call(0u),
+          reported(0u),
+          mutex(),
+          route(),
+          remote_address(),
+          frames(),
+          frame_count(0)
+        {}
+      };
+
+      /// The instance id, so that thread_local caches can't confuse
+      /// watchdogs.
+      const size_t id_;
+      std::chrono::milliseconds budget_; ///< the handler time budget.
+      ReportHandler report_handler_;     ///< the report handler.
+      int signal_;                       ///< the stack capture signal.
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+      /// The disposition of the stack capture signal before the watchdog.
+      struct sigaction old_action_;
+#endif
+
+      /// Protects slots_ and running_.
+      std::mutex mutex_;
+      /// Signals the watchdog thread to stop.
+      std::condition_variable condition_;
+      /// The thread slots, one for each thread that calls handlers.
+      std::vector<std::unique_ptr<thread_slot>> slots_;
+      bool running_;                     ///< whether the watchdog should run.
+      std::atomic<std::uint64_t> reports_; ///< the number of reports.
+
+      std::thread watchdog_;             ///< the watchdog thread.
+
+      /// The next instance id.
+      static size_t next_id()
+      {
+        static std::atomic<size_t> id(0u);
+        return ++id;
+      }
+
+      /// The slot of the current handler call on this thread, for the
+      /// signal handler.
+      static std::atomic<thread_slot*>& current_slot() noexcept
+      {
+        thread_local std::atomic<thread_slot*> slot(nullptr);
+        return slot;
+      }
+
+      /// The current time in nanoseconds, never zero.
+      static std::int64_t now_ns() noexcept
+      {
+        return std::max<std::int64_t>(1,
+          std::chrono::duration_cast<std::chrono::nanoseconds>
+            (clock_type::now().time_since_epoch()).count());
+      }
+
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+      /// The stack capture signal handler.
+      static void capture_stack(int)
+      {
+        thread_slot* slot(current_slot().load(std::memory_order_acquire));
+        if (slot)
+          slot->frame_count.store(backtrace(slot->frames, MAX_FRAMES),
+                                  std::memory_order_release);
+      }
+#endif
+
+      /// Get the slot for the calling thread, creating it if necessary.
+      thread_slot& this_thread_slot()
+      {
+        thread_local size_t cached_id(0u);
+        thread_local thread_slot* cached_slot(nullptr);
+        if (cached_id != id_)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          slots_.push_back(std::make_unique<thread_slot>());
+          cached_slot = slots_.back().get();
+          cached_id = id_;
+        }
+        return *cached_slot;
+      }
+
+      /// Capture and symbolise the stack of a slot's thread.
+      /// @param slot the thread slot.
+      /// @return the symbolised stack frames, empty if not captured.
+      std::vector<std::string> thread_stack(thread_slot& slot)
+      {
+        std::vector<std::string> stack;
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+        slot.frame_count.store(-1, std::memory_order_release);
+        if (pthread_kill(slot.thread, signal_) != 0)
+          return stack;
+
+        // Wait up to 100mS for the signal handler
+        int frames(-1);
+        for (int i(0); (i < 100) && (frames < 0); ++i)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          frames = slot.frame_count.load(std::memory_order_acquire);
+        }
+
+        if (frames > 0)
+        {
+          char** symbols(backtrace_symbols(slot.frames, frames));
+          if (symbols)
+          {
+            stack.assign(symbols, symbols + frames);
+            std::free(symbols);
+          }
+        }
+#else
+        (void)slot;
+#endif
+        return stack;
+      }
+
+      /// Check the thread slots for handlers over the budget.
+      void check()
+      {
+        std::int64_t now(now_ns());
+        std::int64_t budget(std::chrono::duration_cast<std::chrono::nanoseconds>
+                              (budget_).count());
+
+        std::vector<thread_slot*> slots;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          for (auto const& slot : slots_)
+            slots.push_back(slot.get());
+        }
+
+        for (auto slot : slots)
+        {
+          std::int64_t start(slot->start.load(std::memory_order_acquire));
+          std::uint64_t call(slot->call.load(std::memory_order_acquire));
+          if ((start == 0) || (now - start < budget) || (slot->reported == call))
+            continue;
+
+          slot->reported = call;
+          slow_handler report;
+          {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            report.route = slot->route;
+            report.remote_address = slot->remote_address;
+          }
+          report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>
+                             (std::chrono::nanoseconds(now - start));
+          report.stack = thread_stack(*slot);
+
+          // Only report the stack if it's still in the same call
+          if (slot->call.load(std::memory_order_acquire) != call)
+            report.stack.clear();
+
+          reports_.fetch_add(1u, std::memory_order_relaxed);
+          if (report_handler_)
+            report_handler_(report);
+        }
+      }
+
+      /// The watchdog thread function.
+      void run()
+      {
+        std::chrono::milliseconds interval(std::max(budget_ / 4,
+                                           std::chrono::milliseconds(1)));
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_)
+        {
+          condition_.wait_for(lock, interval);
+          if (!running_)
+            break;
+
+          lock.unlock();
+          check();
+          lock.lock();
+        }
+      }
+
+    public:
+
+      //////////////////////////////////////////////////////////////////////
+      /// @class scope
+      /// The scope of a request handler call on the calling thread.
+      //////////////////////////////////////////////////////////////////////
+      class scope
+      {
+        thread_slot* slot_; ///< the thread slot, nullptr if not watched.
+
+      public:
+
+        /// Enter a request handler call.
+        /// @param watchdog the handler_watchdog, nullptr if none.
+        /// @param route the request uri.
+        /// @param remote_address the remote address of the connection.
+        scope(handler_watchdog* watchdog, std::string_view route,
+              std::string_view remote_address) :
+          slot_(watchdog ? &watchdog->this_thread_slot() : nullptr)
+        {
+          // A nested call is part of the enclosing call
+          if (slot_ && (slot_->start.load(std::memory_order_relaxed) != 0))
+            slot_ = nullptr;
+
+          if (slot_)
+          {
+            {
+              std::lock_guard<std::mutex> lock(slot_->mutex);
+              slot_->route.assign(route.substr(0, route.find('?')));
+              slot_->remote_address.assign(remote_address);
+            }
+            slot_->call.fetch_add(1u, std::memory_order_release);
+            current_slot().store(slot_, std::memory_order_release);
+            slot_->start.store(now_ns(), std::memory_order_release);
+          }
+        }
+
+        /// Leave the request handler call.
+        ~scope()
+        {
+          if (slot_)
+          {
+            slot_->start.store(0, std::memory_order_release);
+            current_slot().store(nullptr, std::memory_order_release);
+          }
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+      };
+
+      /// Constructor, starts the watchdog thread.
+      /// @param budget the maximum time that a handler should run for.
+      /// @param report_handler the function to call with the report of a
+      /// slow handler.
+      /// @param signal_number the signal used to capture the stack of a
+      /// thread, default SIGUSR2. Its handler is replaced until the
+      /// watchdog is destroyed.
+      handler_watchdog(std::chrono::milliseconds budget,
+                       ReportHandler report_handler,
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+                       int signal_number = SIGUSR2
+#else
+                       int signal_number = 0
+#endif
+                       ) :
+        id_(next_id()),
+        budget_(budget),
+        report_handler_(report_handler),
+        signal_(signal_number),
+        mutex_(),
+        condition_(),
+        slots_(),
+        running_(true),
+        reports_(0u),
+        watchdog_()
+      {
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+        // Load the unwinder now: backtrace may allocate on its first call.
+        void* frame[1];
+        backtrace(frame, 1);
+
+        struct sigaction action;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        action.sa_handler = capture_stack;
+        old_action_ = action; // in case the signal number is invalid
+        sigaction(signal_, &action, &old_action_);
+#endif
+        watchdog_ = std::thread([this]{ run(); });
+      }
+
+      /// Destructor, stops the watchdog thread and restores the previous
+      /// handler of the stack capture signal.
+      ~handler_watchdog()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          running_ = false;
+        }
+        condition_.notify_one();
+
+        if (watchdog_.joinable())
+          watchdog_.join();
+
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+        sigaction(signal_, &old_action_, nullptr);
+#endif
+      }
+
+      /// Disable copy construction.
+      handler_watchdog(handler_watchdog const& other) = delete;
+
+      /// Disable assignment.
+      handler_watchdog& operator=(handler_watchdog const& other) = delete;
+
+      /// The number of slow handlers reported.
+      std::uint64_t reports() const noexcept
+      { return reports_.load(std::memory_order_relaxed); }
+    };
+  }
+}
+
+#endif
@@ -377,6 +377,31 @@ namespace via
         strftime(dateBuffer, 30, DATE_FORMAT, std::gmtime(&uTime));
         return to_header(HEADER_DATE, dateBuffer);
       }
+
+      /// An http header line for the current date and time, cached by the
+      /// calling thread and only formatted when the time changes.
+      /// @return the Date header line, it is valid until the next call on
+      /// this thread.
+      inline std::string_view cached_date_header()
+      {
+        /// The value to use to format an HTTP date header line.
+        static constexpr char DATE_HEADER_FORMAT[]
+          {"Date: %a, %d %b %Y %H:%M:%S GMT\r\n"};
+
+        thread_local time_t cached_time(0);
+        thread_local char header[40] = { 0 };
+        thread_local size_t length(0u);
+
+        time_t uTime;
+        time(&uTime);
+        if ((uTime != cached_time) || (length == 0u))
+        {
+          length = strftime(header, sizeof(header), DATE_HEADER_FORMAT,
+                            std::gmtime(&uTime));
+          cached_time = uTime;
+        }
+        return std::string_view(header, length);
+      }
 #ifdef _MSC_VER
 #pragma warning( pop )
 #endif
@@ -394,8 +419,11 @@ namespace via
       /// @return http content length header line for the size.
       inline std::string content_length(size_t size)
       {
-        return std::string(HEADER_CONTENT_LENGTH) + SEPARATOR
-             + to_dec_string(size) + CRLF;
+        std::string output(HEADER_CONTENT_LENGTH);
+        output += SEPARATOR;
+        output += to_dec_string(size);
+        output += CRLF;
+        return output;
       }
 
       /// An http transfer encoding header line containing "Chunked".
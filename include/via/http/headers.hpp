@@ -16,6 +16,9 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "header_field.hpp"
 #include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <algorithm>
 
 namespace via
 {
@@ -37,6 +40,37 @@ namespace via
       RX_CHUNK            ///< a valid chunk received
     };
 
+    /// A set of lower case header field names.
+    typedef std::unordered_set<std::string> HeaderNames;
+
+    /// Create the set of header fields to retain from received messages.
+    /// The header fields that the library uses are always retained:
+    /// Content-Length, Transfer-Encoding, Connection, Expect, Host,
+    /// If-None-Match and Authorization.
+    /// @param names the names of the header fields that the application uses,
+    /// in any case.
+    /// @return the lower case names of the header fields to retain.
+    inline std::shared_ptr<const HeaderNames> retained_headers(HeaderNames names)
+    {
+      auto retained(std::make_shared<HeaderNames>());
+      for (std::string name : names)
+      {
+        std::transform(name.begin(), name.end(), name.begin(), to_lower);
+        retained->insert(std::move(name));
+      }
+
+      for (const char* name : {header_field::LC_CONTENT_LENGTH,
+                               header_field::LC_TRANSFER_ENCODING,
+                               header_field::LC_CONNECTION,
+                               header_field::LC_EXPECT,
+                               header_field::LC_HOST,
+                               header_field::LC_IF_NONE_MATCH,
+                               header_field::LC_AUTHORIZATION})
+        retained->insert(name);
+
+      return retained;
+    }
+
     //////////////////////////////////////////////////////////////////////////
     /// @class field_line
     /// An HTTP header field.
@@ -54,7 +88,8 @@ namespace via
         HEADER_VALID,        ///< the header line is valid
         HEADER_ERROR_LENGTH, ///< the header line is longer than max_line_length_
         HEADER_ERROR_CRLF,   ///< strict_crlf_ is true and LF was received without CR
-        HEADER_ERROR_WS      ///< the whitespace is longer than max_whitespace_
+        HEADER_ERROR_WS,     ///< the whitespace is longer than max_whitespace_
+        HEADER_ERROR_CHAR    ///< the value contains an invalid character
       };
 
     private:
@@ -64,29 +99,39 @@ namespace via
       unsigned char  max_whitespace_;  ///< the max no of consectutive whitespace characters.
       unsigned short max_line_length_; ///< the max length of a field line
 
+      /// The header fields to retain, nullptr for all
+      HeaderNames const* retained_;
+
       /// Field information
       std::string   name_;     ///< the field name (lower case)
       std::string   value_;    ///< the field value
       size_t        length_;   ///< the length of the header line in bytes
       size_t        ws_count_; ///< the current whitespace count
+      size_t        skipped_;  ///< the length of a value that is not retained
       Header        state_;    ///< the current parsing state
+      bool          retain_;   ///< whether the field value is retained
 
       /// Parse an individual character.
       /// @param c the current character to be parsed.
+      /// @param limits the parser limits.
       /// @retval state the current state of the parser.
-      bool parse_char(char c)
+      template<typename Limits>
+      bool parse_char(char c, Limits const& limits)
       {
         // Ensure that the overall header length is within limitts
-        if (++length_ > max_line_length_)
+        if (++length_ > limits.max_line_length())
           state_ = HEADER_ERROR_LENGTH;
 
         switch (state_)
         {
         case HEADER_NAME:
-          if (std::isalpha(c) || ('-' == c))
-            name_.push_back(static_cast<char>(std::tolower(c)));
+          if (is_alpha(c) || ('-' == c))
+            name_.push_back(to_lower(c));
           else if (':' == c)
+          {
+            retain_ = (retained_ == nullptr) || (retained_->count(name_) > 0);
             state_ = HEADER_VALUE_LS;
+          }
           else
             return false;
           break;
@@ -95,7 +140,7 @@ namespace via
           // Ignore leading whitespace
           if (is_space_or_tab(c))
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
             {
               state_ = HEADER_ERROR_WS;
               return false;
@@ -109,12 +154,23 @@ namespace via
         case HEADER_VALUE:
           // The header line should end with an \r\n...
           if (!is_end_of_line(c))
-            value_.push_back(c);
+          {
+            if (!is_char_class(c, CC_FIELD_CHAR))
+            {
+              state_ = HEADER_ERROR_CHAR;
+              return false;
+            }
+
+            if (retain_)
+              value_.push_back(c);
+            else
+              ++skipped_;
+          }
           else if ('\r' == c)
             state_ = HEADER_LF;
           else // ('\n' == c)
           {
-            if (strict_crlf_)
+            if (limits.strict_crlf())
             {
               state_ = HEADER_ERROR_CRLF;
               return false;
@@ -154,13 +210,22 @@ namespace via
         strict_crlf_(strict_crlf),
         max_whitespace_(max_whitespace),
         max_line_length_(max_line_length),
+        retained_(nullptr),
         name_(""),
         value_(""),
         length_(0),
         ws_count_(0),
-        state_(HEADER_NAME)
+        skipped_(0),
+        state_(HEADER_NAME),
+        retain_(true)
       {}
 
+      /// Set the header fields to retain, the values of other fields are
+      /// validated but not stored.
+      /// @param names the lower case names of the fields, nullptr for all.
+      void set_retained(HeaderNames const* names) noexcept
+      { retained_ = names; }
+
       /// clear the field_line.
       /// Sets all member variables to their initial state.
       void clear() noexcept
@@ -169,7 +234,9 @@ namespace via
         value_.clear();
         length_ = 0;
         ws_count_ = 0;
+        skipped_ = 0;
         state_ = HEADER_NAME;
+        retain_ = true;
       }
 
       /// swap member variables with another field_line.
@@ -180,7 +247,9 @@ namespace via
         value_.swap(other.value_);
         std::swap(length_, other.length_);
         std::swap(ws_count_, other.ws_count_);
+        std::swap(skipped_, other.skipped_);
         std::swap(state_, other.state_);
+        std::swap(retain_, other.retain_);
       }
 
       /// Parse an individual http header field and extract the field name
@@ -188,20 +257,58 @@ namespace via
       /// @retval iter an iterator to the start of the data.
       /// If valid it will refer to the next char of data to be read.
       /// @param end the end of the buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if a valid HTTP header, false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
         while ((iter != end) && (HEADER_VALID != state_))
         {
+          // Read the rest of the header value in one pass
+          if (HEADER_VALUE == state_)
+          {
+            ForwardIterator next(find_char_class(iter, end, CC_END_OF_LINE));
+            size_t size(static_cast<size_t>(std::distance(iter, next)));
+            if (size > 0u)
+            {
+              size_t available(limits.max_line_length() - length_);
+              if (size > available)
+              {
+                std::advance(iter, available + 1u);
+                state_ = HEADER_ERROR_LENGTH;
+                return false;
+              }
+
+              // A value may only contain field-vchars, spaces and tabs
+              if (!is_all_char_class(iter, next, CC_FIELD_CHAR))
+              {
+                iter = next;
+                state_ = HEADER_ERROR_CHAR;
+                return false;
+              }
+
+              length_ += size;
+              if (retain_)
+                value_.append(iter, next);
+              else
+                skipped_ += size;
+              iter = next;
+              continue;
+            }
+          }
+
           char c(static_cast<char>(*iter++));
-          if (!parse_char(c))
+          if (!parse_char(c, limits))
             return false;
           else if (HEADER_VALID == state_)
           { // determine whether the next line is a continuation header
             if ((iter != end) && is_space_or_tab(*iter))
             {
-              value_.push_back(' ');
+              if (retain_)
+                value_.push_back(' ');
+              else
+                ++skipped_;
               state_ = HEADER_VALUE_LS;
             }
           }
@@ -210,6 +317,27 @@ namespace via
         return (HEADER_VALID == state_);
       }
 
+      /// Parse an individual http header field using the constructor limits.
+      /// @retval iter an iterator to the start of the data.
+      /// If valid it will refer to the next char of data to be read.
+      /// @param end the end of the buffer.
+      /// @return true if a valid HTTP header, false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the strict crlf parsing state.
+      bool strict_crlf() const noexcept
+      { return strict_crlf_; }
+
+      /// Accessor for the max no of consectutive whitespace characters.
+      unsigned char max_whitespace() const noexcept
+      { return max_whitespace_; }
+
+      /// Accessor for the max length of a field line.
+      unsigned short max_line_length() const noexcept
+      { return max_line_length_; }
+
       /// Accessor for the field name.
       /// @return the field name (as a lower case string)
       const std::string& name() const noexcept
@@ -220,9 +348,13 @@ namespace via
       const std::string& value() const noexcept
       { return value_; }
 
+      /// Whether the field value was retained.
+      bool retained() const noexcept
+      { return retain_; }
+
       /// Calculate the length of the header.
       size_t length() const noexcept
-      { return name_.size() + value_.size(); }
+      { return name_.size() + value_.size() + skipped_; }
     }; // class field_line
 
     //////////////////////////////////////////////////////////////////////////
@@ -243,6 +375,8 @@ namespace via
 
       /// The HTTP message header fields.
       std::unordered_map<std::string, std::string> fields_;
+      /// The header fields to retain, all if null.
+      std::shared_ptr<const HeaderNames> retained_;
       field_line field_; ///< the current field being parsed
       bool       valid_; ///< true if the headers are valid
       size_t     length_; ///< the length of the message headers
@@ -269,11 +403,23 @@ namespace via
         max_header_number_(max_header_number),
         max_header_length_(max_header_length),
         fields_(),
+        retained_(),
         field_(strict_crlf, max_whitespace, max_line_length),
         valid_(false),
         length_(0)
       {}
 
+      /// Set the header fields to retain.
+      /// The other fields are parsed and count towards max_header_length but
+      /// are not stored, so find will not find them.
+      /// @param names the lower case header field names, see retained_headers.
+      /// All fields are retained if names is null (the default).
+      void set_retained_headers(std::shared_ptr<const HeaderNames> names)
+      {
+        retained_ = std::move(names);
+        field_.set_retained(retained_.get());
+      }
+
       /// Clear the message_headers.
       /// Sets all member variables to their initial state.
       void clear() noexcept
@@ -298,22 +444,25 @@ namespace via
       /// @retval iter reference to an iterator to the start of the data.
       /// If valid it will refer to the next char of data to be read.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
         while (iter != end && !is_end_of_line(*iter))
         {
          // field_line field;
-          if (!field_.parse(iter, end))
+          if (!field_.parse(iter, end, limits))
             return false;
 
           length_ += field_.length();
-          add(field_.name(), field_.value());
+          if (field_.retained())
+            add(field_.name(), field_.value());
           field_.clear();
 
-          if ((length_ > max_header_length_)
-           || (fields_.size() > max_header_number_))
+          if ((length_ > limits.max_header_length())
+           || (fields_.size() > limits.max_header_number()))
             return false;
         }
 
@@ -334,6 +483,35 @@ namespace via
         return valid_;
       }
 
+      /// Parse message_headers using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// If valid it will refer to the next char of data to be read.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the strict crlf parsing state.
+      bool strict_crlf() const noexcept
+      { return field_.strict_crlf(); }
+
+      /// Accessor for the max no of consectutive whitespace characters.
+      unsigned char max_whitespace() const noexcept
+      { return field_.max_whitespace(); }
+
+      /// Accessor for the max length of a field line.
+      unsigned short max_line_length() const noexcept
+      { return field_.max_line_length(); }
+
+      /// Accessor for the max no of header fields.
+      unsigned short max_header_number() const noexcept
+      { return max_header_number_; }
+
+      /// Accessor for the max cumulative length of the header fields.
+      size_t max_header_length() const noexcept
+      { return max_header_length_; }
+
       /// Add a header to the collection.
       /// @param name the field name (in lower case)
       /// @param value the field value.
@@ -392,7 +570,7 @@ namespace via
           return false;
 
         std::transform(xfer_encoding.begin(), xfer_encoding.end(),
-                       xfer_encoding.begin(), ::tolower);
+                       xfer_encoding.begin(), to_lower);
         // Note: is transfer encoding if "identity" is NOT found.
         return (xfer_encoding.find(IDENTITY) == std::string::npos);
       }
@@ -407,7 +585,7 @@ namespace via
           return false;
 
         std::transform(connection.begin(), connection.end(),
-                       connection.begin(), ::tolower);
+                       connection.begin(), to_lower);
         return (connection.find(CLOSE) != std::string::npos);
       }
 
@@ -422,7 +600,7 @@ namespace via
           return false;
 
         std::transform(expect.begin(), expect.end(),
-                       expect.begin(), ::tolower);
+                       expect.begin(), to_lower);
         return (expect.find(CONTINUE) != std::string::npos);
       }
 
@@ -0,0 +1,154 @@
+#ifndef PARSER_LIMITS_HPP_VIA_HTTPLIB_
+#define PARSER_LIMITS_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file parser_limits.hpp
+/// @brief Policy classes for the HTTP parser limits.
+///
+/// The request_receiver and response_receiver classes take an optional
+/// Limits template parameter. By default (runtime_limits) the parser limits
+/// are passed to their constructors, as before. Otherwise, the Limits class
+/// provides the limits as compile time constants so that the compiler can
+/// fold the limit checks in the parser state machines.
+/// A Limits class must provide the static constexpr functions in
+/// request_limits or response_limits.
+//////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <climits>
+
+namespace via
+{
+  namespace http
+  {
+    /// The Limits policy for parser limits passed to a constructor.
+    struct runtime_limits {};
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class request_limits
+    /// Compile time limits for a request_receiver.
+    /// The default values are the same as the http_server defaults.
+    /// @param STRICT_CRLF enforce strict parsing of CRLF.
+    /// @param MAX_WHITESPACE the maximum number of consectutive whitespace
+    /// characters allowed in a request: min 1, max 254.
+    /// @param MAX_METHOD_LENGTH the maximum length of an HTTP request method:
+    /// min 1, max 254.
+    /// @param MAX_URI_LENGTH the maximum length of an HTTP request uri.
+    /// @param MAX_LINE_LENGTH the maximum length of an HTTP header field line:
+    /// min 1, max 65534.
+    /// @param MAX_HEADER_NUMBER the maximum number of HTTP header field lines:
+    /// max 65534.
+    /// @param MAX_HEADER_LENGTH the maximum cumulative length the HTTP header
+    /// fields.
+    /// @param MAX_BODY_SIZE the maximum size of an HTTP request body.
+    /// @param MAX_CHUNK_SIZE the maximum size of an HTTP request chunk.
+    //////////////////////////////////////////////////////////////////////////
+    template <bool           STRICT_CRLF       = false,
+              unsigned char  MAX_WHITESPACE    = 8,
+              unsigned char  MAX_METHOD_LENGTH = 8,
+              size_t         MAX_URI_LENGTH    = 1024,
+              unsigned short MAX_LINE_LENGTH   = 1024,
+              unsigned short MAX_HEADER_NUMBER = 100,
+              size_t         MAX_HEADER_LENGTH = 8190,
+              size_t         MAX_BODY_SIZE     = 1048576,
+              size_t         MAX_CHUNK_SIZE    = 1048576>
+    struct request_limits
+    {
+      static constexpr bool strict_crlf() noexcept
+      { return STRICT_CRLF; }
+
+      static constexpr unsigned char max_whitespace() noexcept
+      { return MAX_WHITESPACE; }
+
+      static constexpr unsigned char max_method_length() noexcept
+      { return MAX_METHOD_LENGTH; }
+
+      static constexpr size_t max_uri_length() noexcept
+      { return MAX_URI_LENGTH; }
+
+      static constexpr unsigned short max_line_length() noexcept
+      { return MAX_LINE_LENGTH; }
+
+      static constexpr unsigned short max_header_number() noexcept
+      { return MAX_HEADER_NUMBER; }
+
+      static constexpr size_t max_header_length() noexcept
+      { return MAX_HEADER_LENGTH; }
+
+      static constexpr size_t max_body_size() noexcept
+      { return MAX_BODY_SIZE; }
+
+      static constexpr size_t max_chunk_size() noexcept
+      { return MAX_CHUNK_SIZE; }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class response_limits
+    /// Compile time limits for a response_receiver.
+    /// The default values are the same as the http_client defaults.
+    /// @param STRICT_CRLF enforce strict parsing of CRLF.
+    /// @param MAX_WHITESPACE the maximum number of consectutive whitespace
+    /// characters allowed in a response: min 1, max 254.
+    /// @param MAX_STATUS_NO the maximum number of an HTTP response status:
+    /// max 65534.
+    /// @param MAX_REASON_LENGTH the maximum length of a response reason:
+    /// max 65534.
+    /// @param MAX_LINE_LENGTH the maximum length of an HTTP header field line:
+    /// min 1, max 65534.
+    /// @param MAX_HEADER_NUMBER the maximum number of HTTP header field lines:
+    /// max 65534.
+    /// @param MAX_HEADER_LENGTH the maximum cumulative length the HTTP header
+    /// fields.
+    /// @param MAX_BODY_SIZE the maximum size of an HTTP response body.
+    /// @param MAX_CHUNK_SIZE the maximum size of an HTTP response chunk.
+    //////////////////////////////////////////////////////////////////////////
+    template <bool           STRICT_CRLF       = false,
+              unsigned char  MAX_WHITESPACE    = 254,
+              unsigned short MAX_STATUS_NO     = 65534,
+              unsigned short MAX_REASON_LENGTH = 65534,
+              unsigned short MAX_LINE_LENGTH   = 65534,
+              unsigned short MAX_HEADER_NUMBER = 65534,
+              size_t         MAX_HEADER_LENGTH = LONG_MAX,
+              size_t         MAX_BODY_SIZE     = LONG_MAX,
+              size_t         MAX_CHUNK_SIZE    = LONG_MAX>
+    struct response_limits
+    {
+      static constexpr bool strict_crlf() noexcept
+      { return STRICT_CRLF; }
+
+      static constexpr unsigned char max_whitespace() noexcept
+      { return MAX_WHITESPACE; }
+
+      static constexpr unsigned short max_status_no() noexcept
+      { return MAX_STATUS_NO; }
+
+      static constexpr size_t max_reason_length() noexcept
+      { return MAX_REASON_LENGTH; }
+
+      static constexpr unsigned short max_line_length() noexcept
+      { return MAX_LINE_LENGTH; }
+
+      static constexpr unsigned short max_header_number() noexcept
+      { return MAX_HEADER_NUMBER; }
+
+      static constexpr size_t max_header_length() noexcept
+      { return MAX_HEADER_LENGTH; }
+
+      static constexpr size_t max_body_size() noexcept
+      { return MAX_BODY_SIZE; }
+
+      static constexpr size_t max_chunk_size() noexcept
+      { return MAX_CHUNK_SIZE; }
+    };
+  }
+}
+
+#endif
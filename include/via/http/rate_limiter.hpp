@@ -0,0 +1,259 @@
+#ifndef RATE_LIMITER_HPP_VIA_HTTPLIB_
+#define RATE_LIMITER_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file rate_limiter.hpp
+/// @brief Contains the rate_limiter class.
+//////////////////////////////////////////////////////////////////////////////
+#include "request.hpp"
+#include <array>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+
+namespace via
+{
+  namespace http
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class rate_limiter
+    /// A per client request rate limiter.
+    ///
+    /// It holds a token bucket for each client, where a client is identified
+    /// by its remote address, the value of a request header or the request
+    /// route. Each request consumes a token from its bucket; the buckets are
+    /// refilled at the configured rate up to the configured burst size.
+    ///
+    /// The buckets are keyed by a hash of the client key and stored in a
+    /// fixed number of shards, each with its own mutex (if HTTP_THREAD_SAFE)
+    /// and a bounded number of entries. When a shard is full, the bucket
+    /// that has been idle longest is evicted, so memory use is bounded
+    /// whatever the number of clients.
+    //////////////////////////////////////////////////////////////////////////
+    class rate_limiter
+    {
+    public:
+
+      /// The clock used to refill the token buckets.
+      typedef std::chrono::steady_clock clock_type;
+
+      /// The source of the key that identifies a client.
+      enum class key
+      {
+        REMOTE_ADDRESS, ///< the remote address of the connection.
+        HEADER,         ///< the value of a request header.
+        ROUTE           ///< the request uri path, without a query.
+      };
+
+      /// The number of shards of token buckets.
+      static const size_t NUMBER_OF_SHARDS = 16;
+
+      /// The default maximum number of token buckets.
+      static const size_t DEFAULT_MAX_KEYS = 65536;
+
+    private:
+
+      /// A token bucket.
+      struct bucket
+      {
+        double tokens;                 ///< the tokens in the bucket.
+        clock_type::time_point update; ///< the time the bucket was updated.
+      };
+
+      /// The token buckets in a shard, keyed by the hash of a client key.
+      typedef std::unordered_map<size_t, bucket> bucket_map;
+
+      /// A shard of token buckets.
+      struct alignas(64) shard
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::mutex mutex_; ///< protects the buckets.
+#endif
+        bucket_map buckets_; ///< the token buckets.
+      };
+
+      double rate_;            ///< the tokens added per second.
+      double burst_;           ///< the maximum number of tokens in a bucket.
+      key    key_;             ///< the source of the client key.
+      std::string header_;     ///< the (lowercase) name of the key header.
+      size_t max_shard_keys_;  ///< the maximum number of buckets per shard.
+      std::array<shard, NUMBER_OF_SHARDS> shards_; ///< the token buckets.
+
+      /// Evict the bucket that has been idle longest from a full shard.
+      /// @param buckets the token buckets of the shard.
+      static void evict(bucket_map& buckets)
+      {
+        auto oldest(std::min_element(buckets.begin(), buckets.end(),
+          [](bucket_map::value_type const& lhs,
+             bucket_map::value_type const& rhs)
+            { return lhs.second.update < rhs.second.update; }));
+        if (oldest != buckets.end())
+          buckets.erase(oldest);
+      }
+
+    public:
+
+      /// Default constructor.
+      /// Rate limiting is disabled until set_limit is called.
+      rate_limiter() :
+        rate_(0.0),
+        burst_(0.0),
+        key_(key::REMOTE_ADDRESS),
+        header_(),
+        max_shard_keys_(DEFAULT_MAX_KEYS / NUMBER_OF_SHARDS),
+        shards_()
+      {}
+
+      /// Set the rate limit.
+      /// @param rate the sustained number of requests per second allowed
+      /// for each client. Zero disables rate limiting.
+      /// @param burst the number of requests that a client may send at once,
+      /// min 1.
+      void set_limit(double rate, double burst)
+      {
+        rate_ = rate;
+        burst_ = std::max(burst, 1.0);
+        clear();
+      }
+
+      /// Set the source of the key that identifies a client.
+      /// @param source the source of the key, default REMOTE_ADDRESS.
+      /// @param header_name the name of the key header, if source is HEADER.
+      /// Requests without the header are keyed by their remote address.
+      void set_key(key source, std::string_view header_name = std::string_view())
+      {
+        key_ = source;
+        header_.clear();
+        std::transform(header_name.cbegin(), header_name.cend(),
+                       std::back_inserter(header_), to_lower);
+        clear();
+      }
+
+      /// Set the maximum number of token buckets.
+      /// @param max_keys the maximum number of clients to track.
+      void set_max_keys(size_t max_keys)
+      {
+        max_shard_keys_ = std::max<size_t>(max_keys / NUMBER_OF_SHARDS, 1);
+        clear();
+      }
+
+      /// Whether rate limiting is enabled.
+      bool enabled() const noexcept
+      { return rate_ > 0.0; }
+
+      /// The number of token buckets in use.
+      size_t size()
+      {
+        size_t total(0);
+        for (auto& elem : shards_)
+        {
+#ifdef HTTP_THREAD_SAFE
+          std::lock_guard<std::mutex> lock(elem.mutex_);
+#endif
+          total += elem.buckets_.size();
+        }
+        return total;
+      }
+
+      /// Remove all of the token buckets.
+      void clear()
+      {
+        for (auto& elem : shards_)
+        {
+#ifdef HTTP_THREAD_SAFE
+          std::lock_guard<std::mutex> lock(elem.mutex_);
+#endif
+          elem.buckets_.clear();
+        }
+      }
+
+      /// Get the client key of a request.
+      /// @param request the received request.
+      /// @param remote_address the remote address of the connection.
+      /// @return the client key.
+      std::string_view client_key(rx_request const& request,
+                                  std::string_view remote_address) const
+      {
+        switch (key_)
+        {
+        case key::HEADER:
+          {
+            std::string_view value(request.headers().find(header_));
+            return value.empty() ? remote_address : value;
+          }
+        case key::ROUTE:
+          {
+            std::string_view uri(request.uri());
+            return uri.substr(0, uri.find('?'));
+          }
+        default:
+          return remote_address;
+        }
+      }
+
+      /// Take a token from a client's bucket.
+      /// @param client the client key.
+      /// @param now the current time.
+      /// @return true if the client is within its limit, false otherwise.
+      bool allow(std::string_view client,
+                 clock_type::time_point now = clock_type::now())
+      {
+        if (!enabled())
+          return true;
+
+        size_t hash(std::hash<std::string_view>()(client));
+        shard& the_shard(shards_[(hash >> 8) % NUMBER_OF_SHARDS]);
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(the_shard.mutex_);
+#endif
+
+        auto iter(the_shard.buckets_.find(hash));
+        if (iter == the_shard.buckets_.end())
+        {
+          if (the_shard.buckets_.size() >= max_shard_keys_)
+            evict(the_shard.buckets_);
+          the_shard.buckets_.emplace(hash, bucket{burst_ - 1.0, now});
+          return true;
+        }
+
+        bucket& the_bucket(iter->second);
+        if (now > the_bucket.update)
+        {
+          std::chrono::duration<double> elapsed(now - the_bucket.update);
+          the_bucket.tokens = std::min(burst_,
+                                  the_bucket.tokens + elapsed.count() * rate_);
+          the_bucket.update = now;
+        }
+
+        if (the_bucket.tokens < 1.0)
+          return false;
+
+        the_bucket.tokens -= 1.0;
+        return true;
+      }
+
+      /// Take a token from the bucket of the client that sent a request.
+      /// @param request the received request.
+      /// @param remote_address the remote address of the connection.
+      /// @param now the current time.
+      /// @return true if the client is within its limit, false otherwise.
+      bool allow(rx_request const& request, std::string_view remote_address,
+                 clock_type::time_point now = clock_type::now())
+      { return allow(client_key(request, remote_address), now); }
+    };
+  }
+}
+
+#endif
@@ -18,7 +18,11 @@
 #include "response_status.hpp"
 #include "headers.hpp"
 #include "chunk.hpp"
+#include "body_spool.hpp"
+#include "parser_limits.hpp"
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 
 namespace via
 {
@@ -50,7 +54,8 @@ namespace via
         REQ_ERROR_CRLF,          ///< strict_crlf_ is true and LF was received without CR
         REQ_ERROR_WS,            ///< the whitespace is longer than max_whitespace_
         REQ_ERROR_METHOD_LENGTH, ///< the method name is longer than max_method_length_
-        REQ_ERROR_URI_LENGTH     ///< then uri is longer than max_uri_length_
+        REQ_ERROR_URI_LENGTH,    ///< then uri is longer than max_uri_length_
+        REQ_ERROR_URI_CHAR       ///< the uri contains an invalid character
       };
 
     private:
@@ -75,17 +80,19 @@ namespace via
 
       /// Parse an individual character.
       /// @param c the character to be parsed.
+      /// @param limits the parser limits.
       /// @return true if valid, false otherwise.
-      bool parse_char(char c)
+      template<typename Limits>
+      bool parse_char(char c, Limits const& limits)
       {
         switch (state_)
         {
         case REQ_METHOD:
           // Valid HTTP methods must be uppercase chars
-          if (std::isupper(c))
+          if (is_upper(c))
           {
             method_.push_back(c);
-            if (method_.size() > max_method_length_)
+            if (method_.size() > limits.max_method_length())
             {
               state_ = REQ_ERROR_METHOD_LENGTH;
               return false;
@@ -108,7 +115,7 @@ namespace via
           {
             // Ignore leading whitespace
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
             {
               state_ = REQ_ERROR_WS;
               return false;
@@ -120,10 +127,15 @@ namespace via
               state_ = REQ_HTTP_H;
             }
           }
+          else if (!is_char_class(c, CC_URI_CHAR))
+          {
+            state_ = REQ_ERROR_URI_CHAR;
+            return false;
+          }
           else
           {
             uri_.push_back(c);
-            if (uri_.size() > max_uri_length_)
+            if (uri_.size() > limits.max_uri_length())
             {
               state_ = REQ_ERROR_URI_LENGTH;
               return false;
@@ -136,7 +148,7 @@ namespace via
           if (is_space_or_tab(c))
           {
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
             {
               state_ = REQ_ERROR_WS;
               return false;
@@ -180,7 +192,7 @@ namespace via
           break;
 
         case REQ_HTTP_MAJOR:
-          if (std::isdigit(c))
+          if (is_digit(c))
           {
             major_version_ = c;
             state_ = REQ_HTTP_DOT;
@@ -197,7 +209,7 @@ namespace via
           break;
 
         case REQ_HTTP_MINOR:
-          if (std::isdigit(c))
+          if (is_digit(c))
           {
             minor_version_ = c;
             state_ = REQ_CR;
@@ -213,7 +225,7 @@ namespace via
           else
           {
             // but (if not being strict) permit just \n
-            if (!strict_crlf_ && ('\n' == c))
+            if (!limits.strict_crlf() && ('\n' == c))
               state_ = REQ_VALID;
             else
             {
@@ -315,14 +327,48 @@ namespace via
       /// @retval iter reference to an iterator to the start of the data.
       /// If valid it will refer to the next char of data to be read.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
         while ((iter != end) && (REQ_VALID != state_))
         {
+          // Read the rest of the uri in one pass
+          if (REQ_URI == state_)
+          {
+            ForwardIterator next(find_char_class(iter, end,
+                                   CC_SPACE_OR_TAB | CC_END_OF_LINE));
+            size_t size(static_cast<size_t>(std::distance(iter, next)));
+            if (size > 0u)
+            {
+              size_t available(limits.max_uri_length() - uri_.size());
+              if (size > available)
+              {
+                std::advance(iter, available + 1u);
+                state_ = REQ_ERROR_URI_LENGTH;
+                fail_ = true;
+                return false;
+              }
+
+              // The uri may only contain RFC 3986 characters
+              if (!is_all_char_class(iter, next, CC_URI_CHAR))
+              {
+                iter = next;
+                state_ = REQ_ERROR_URI_CHAR;
+                fail_ = true;
+                return false;
+              }
+
+              uri_.append(iter, next);
+              iter = next;
+              continue;
+            }
+          }
+
           char c(*iter++);
-          if ((fail_ = !parse_char(c))) // Note: deliberate assignment
+          if ((fail_ = !parse_char(c, limits))) // Note: deliberate assignment
             return false;
         }
         valid_ = (REQ_VALID == state_);
@@ -331,6 +377,32 @@ namespace via
 #ifdef _MSC_VER
 #pragma warning( pop )
 #endif
+
+      /// Parse the line as an HTTP request using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// If valid it will refer to the next char of data to be read.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the strict crlf parsing state.
+      bool strict_crlf() const noexcept
+      { return strict_crlf_; }
+
+      /// Accessor for the max no of consectutive whitespace characters.
+      unsigned char max_whitespace() const noexcept
+      { return max_whitespace_; }
+
+      /// Accessor for the maximum length of a request method.
+      unsigned char max_method_length() const noexcept
+      { return max_method_length_; }
+
+      /// Accessor for the maximum length of a request uri.
+      size_t max_uri_length() const noexcept
+      { return max_uri_length_; }
+
       /// Accessor for the HTTP minor version number.
       /// @return the minor version number.
       const std::string& method() const noexcept
@@ -374,6 +446,11 @@ namespace via
               ((major_version_ == '1') && (minor_version_ == '0'));
       }
 
+      /// Test for HTTP/1.1
+      /// @return true if HTTP/1.1.
+      bool is_http_1_1() const noexcept
+      { return (major_version_ == '1') && (minor_version_ == '1'); }
+
       ////////////////////////////////////////////////////////////////////////
       // Encoding interface.
 
@@ -530,20 +607,47 @@ namespace via
       ///   - the start of the next http response, or
       ///   - the end of the data buffer.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok, false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
-        if (!request_line::valid() && !request_line::parse(iter, end))
+        if (!request_line::valid() && !request_line::parse(iter, end, limits))
           return false;
 
-        if (!headers_.valid() && !headers_.parse(iter, end))
+        if (!headers_.valid() && !headers_.parse(iter, end, limits))
           return false;
 
         valid_ = true;
         return valid_;
       }
 
+      /// Parse an HTTP request using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok, false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the max length of a header field line.
+      unsigned short max_line_length() const noexcept
+      { return headers_.max_line_length(); }
+
+      /// Accessor for the max no of header fields.
+      unsigned short max_header_number() const noexcept
+      { return headers_.max_header_number(); }
+
+      /// Accessor for the max cumulative length of the header fields.
+      size_t max_header_length() const noexcept
+      { return headers_.max_header_length(); }
+
+      /// Set the header fields to retain, see message_headers.
+      /// @param names the lower case header field names, all if null.
+      void set_retained_headers(std::shared_ptr<const HeaderNames> names)
+      { headers_.set_retained_headers(std::move(names)); }
+
       /// Accessor for the request message headers.
       /// @return a constant reference to the message_headers
       const message_headers& headers() const noexcept
@@ -595,6 +699,11 @@ namespace via
                headers_.expect_continue();
       }
 
+      /// Whether the request is "GET"
+      /// @return true if the request is "GET"
+      bool is_get() const noexcept
+      { return request_method::GET == method(); }
+
       /// Whether the request is "HEAD"
       /// @return true if the request is "HEAD"
       bool is_head() const noexcept
@@ -702,12 +811,33 @@ namespace via
     /// @class request_receiver
     /// A template class to receive HTTP requests and any associated data.
     /// @param Container the type of container in which the request is held.
+    /// @param Limits the parser limits: runtime_limits (the default) for the
+    /// limits passed to the constructor, or a class with compile time limits,
+    /// e.g. request_limits, see parser_limits.hpp.
     //////////////////////////////////////////////////////////////////////////
-    template <typename Container>
+    template <typename Container, typename Limits = runtime_limits>
     class request_receiver
     {
+    public:
+
+      /// The type of function called to check a request before its body is
+      /// received.
+      /// It returns response_status::code::OK to accept the request or the
+      /// response_status::code to reject it with.
+      typedef std::function<response_status::code (rx_request const&)>
+        RequestCheck;
+
+      /// The type of function called with the data of a request body as it
+      /// is received, see set_body_handler.
+      /// It returns true if it has taken the data, false otherwise.
+      typedef std::function<bool (rx_request const&, char const*, size_t)>
+        BodyHandler;
+
+    private:
+
       /// Parser parameters
       size_t max_body_size_;       ///< the maximum size of a request body.
+      size_t spool_threshold_;     ///< the maximum body size held in memory.
 
       /// Behaviour
       bool   translate_head_;      ///< pass a HEAD request as a GET request.
@@ -717,11 +847,103 @@ namespace via
       rx_request request_;         ///< the received request
       rx_chunk<Container> chunk_;  ///< the received chunk
       Container  body_;    ///< the request body or data for the last chunk
+      body_spool spool_;           ///< the request body, if spooled to a file
       /// the appropriate response to the request:
       /// either an error code or 100 Continue.
       response_status::code response_code_;
       bool       continue_sent_;   ///< a 100 Continue response has been sent
       bool       is_head_;         ///< whether it's a HEAD request
+      RequestCheck request_check_; ///< the request check function
+      BodyHandler body_handler_;   ///< the body handler function
+      size_t     streamed_size_;   ///< the body data taken by body_handler_
+
+      /// Append data to the request body, spooling it to a temporary file
+      /// if the body would exceed the spool threshold.
+      /// @param begin an iterator to the beginning of the data.
+      /// @param end an iterator to the end of the data.
+      /// @return true if successful, false if the data could not be written
+      /// to the temporary file.
+      template<typename ForwardIterator>
+      bool append_body(ForwardIterator begin, ForwardIterator end)
+      {
+        size_t size(static_cast<size_t>(std::distance(begin, end)));
+        if (!spool_.is_open())
+        {
+          if ((spool_threshold_ == 0u) ||
+              ((body_.size() + size) <= spool_threshold_))
+          {
+            body_.insert(body_.end(), begin, end);
+            return true;
+          }
+
+          // move the body received so far into a new temporary file
+          if (!spool_.open() || !spool_.write(body_.data(), body_.size()))
+            return false;
+          Container().swap(body_); // release the memory
+        }
+
+        return (size == 0u) || spool_.write(&*begin, size);
+      }
+
+      /// Receive data of a request body with a Content-Length: pass it to
+      /// the body handler, if the handler takes the body, or append it to
+      /// the request body.
+      /// @param begin an iterator to the beginning of the data.
+      /// @param end an iterator to the end of the data.
+      /// @return response_status::code::OK if successful, otherwise the
+      /// code to reject the request with.
+      template<typename ForwardIterator>
+      response_status::code receive_content(ForwardIterator begin,
+                                            ForwardIterator end)
+      {
+        // The body handler is asked to take the first data of a body
+        if (body_handler_ && ((streamed_size_ > 0u) || (body_size() == 0u)))
+        {
+          size_t size(static_cast<size_t>(std::distance(begin, end)));
+          if (body_handler_(request_, &*begin, size))
+          {
+            streamed_size_ += size;
+            return response_status::code::OK;
+          }
+
+          // the body handler has rejected the rest of the body
+          if (streamed_size_ > 0u)
+            return response_status::code::BAD_REQUEST;
+        }
+
+        return append_body(begin, end)
+            ? response_status::code::OK
+            : response_status::code::INTERNAL_SERVER_ERROR;
+      }
+
+      /// Parse the request with the Limits.
+      template<typename ForwardIterator>
+      bool parse_request(ForwardIterator& iter, ForwardIterator end)
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return request_.parse(iter, end);
+        else
+          return request_.parse(iter, end, Limits());
+      }
+
+      /// Parse a chunk with the Limits.
+      template<typename ForwardIterator>
+      bool parse_chunk(ForwardIterator& iter, ForwardIterator end)
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return chunk_.parse(iter, end);
+        else
+          return chunk_.parse(iter, end, Limits());
+      }
+
+      /// The maximum size of a request body.
+      size_t max_body_size() const noexcept
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return max_body_size_;
+        else
+          return Limits::max_body_size();
+      }
 
     public:
 
@@ -780,6 +1002,7 @@ namespace via
                                 size_t         max_body_size,
                                 size_t         max_chunk_size) :
         max_body_size_(max_body_size),
+        spool_threshold_(0u),
         translate_head_(true),
         concatenate_chunks_(true),
         request_(strict_crlf, max_whitespace, max_method_length, max_uri_length,
@@ -787,9 +1010,27 @@ namespace via
         chunk_(strict_crlf, max_whitespace, max_line_length, max_chunk_size,
                max_header_number, max_header_length),
         body_(),
+        spool_(),
         response_code_(response_status::code::NO_CONTENT),
         continue_sent_(false),
-        is_head_(false)
+        is_head_(false),
+        request_check_(),
+        body_handler_(),
+        streamed_size_(0u)
+      {}
+
+      /// Default constructor.
+      /// Only available if Limits provides compile time limits.
+      request_receiver() :
+        request_receiver(Limits::strict_crlf(),
+                         Limits::max_whitespace(),
+                         Limits::max_method_length(),
+                         Limits::max_uri_length(),
+                         Limits::max_line_length(),
+                         Limits::max_header_number(),
+                         Limits::max_header_length(),
+                         Limits::max_body_size(),
+                         Limits::max_chunk_size())
       {}
 
       /// Enable whether HEAD requests are translated into GET
@@ -803,6 +1044,40 @@ namespace via
       void set_concatenate_chunks(bool enable) noexcept
       { concatenate_chunks_ = enable; }
 
+      /// Set the maximum size of a request body to hold in memory.
+      /// Larger bodies are written to an anonymous temporary file, see
+      /// spool_file.
+      /// @param threshold the maximum size of a body to hold in memory,
+      /// zero (the default) to always hold bodies in memory.
+      void set_spool_threshold(size_t threshold) noexcept
+      { spool_threshold_ = threshold; }
+
+      /// Set the request header fields to retain, the others are parsed but
+      /// not stored.
+      /// @param names the lower case header field names, see
+      /// retained_headers. All fields are retained if names is null.
+      void set_retained_headers(std::shared_ptr<const HeaderNames> names)
+      { request_.set_retained_headers(std::move(names)); }
+
+      /// Set the function to check requests before their bodies are received.
+      /// E.g. to reject requests from clients that have exceeded a rate limit.
+      /// @param check the request check function.
+      void set_request_check(RequestCheck check)
+      { request_check_ = check; }
+
+      /// Set the function to receive the data of request bodies with a
+      /// Content-Length as it arrives, instead of holding the body in memory
+      /// or spooling it, e.g. to parse a multipart/form-data upload.
+      /// The handler is called with the first data of each body: if it
+      /// takes it, it's called with the rest of the body and the request's
+      /// body() is empty, otherwise the body is received as usual.
+      /// If the handler doesn't take the rest of a body that it has taken,
+      /// the request is rejected with 400 Bad Request.
+      /// Note: chunked bodies are received by the chunk handler.
+      /// @param handler the body handler function.
+      void set_body_handler(BodyHandler handler)
+      { body_handler_ = handler; }
+
       /// set the continue_sent_ flag
       void set_continue_sent() noexcept
       { continue_sent_ = true; }
@@ -814,9 +1089,11 @@ namespace via
         request_.clear();
         chunk_.clear();
         body_.clear();
+        spool_.close();
         // response_code_ is required for response so NOT cleared.
         continue_sent_ = false;
         is_head_ = false;
+        streamed_size_ = 0u;
       }
 
       /// Accessor for the is_head flag.
@@ -838,6 +1115,25 @@ namespace via
       Container const& body() const noexcept
       { return body_; }
 
+      /// Accessor for a request body that exceeded the spool threshold.
+      /// The file is positioned at the start of the body and is deleted
+      /// when the receiver is cleared, i.e. when the request handler returns
+      /// or a response is sent, so a handler that needs it afterwards must
+      /// duplicate its file descriptor.
+      /// @return the body_spool, body_spool::is_open is false if the body
+      /// is in memory.
+      body_spool const& spool_file() const noexcept
+      { return spool_; }
+
+      /// The size of the request body, in memory or in the spool file.
+      size_t body_size() const noexcept
+      { return spool_.is_open() ? spool_.size() : body_.size(); }
+
+      /// The size of the request body taken by the body handler.
+      /// @see set_body_handler
+      size_t streamed_size() const noexcept
+      { return streamed_size_; }
+
       /// Accessor for the response code.
       response_status::code response_code() const noexcept
       { return response_code_; }
@@ -862,7 +1158,7 @@ namespace via
         if (request_parsed)
         {
           // failed to parse request
-          if (!request_.parse(iter, end))
+          if (!parse_request(iter, end))
           {
             // if a parsing error (not run out of data)
             if ((iter != end) || request_.fail())
@@ -894,6 +1190,18 @@ namespace via
           return RX_INVALID;
         }
 
+        // check the request before receiving its body
+        if (request_parsed && request_check_)
+        {
+          response_status::code check_code(request_check_(request_));
+          if (check_code != response_status::code::OK)
+          {
+            response_code_ = check_code;
+            clear();
+            return RX_INVALID;
+          }
+        }
+
         // build a response body or receive a chunk
         if (!request_.is_chunked())
         {
@@ -928,7 +1236,7 @@ namespace via
             if (content_length > 0)
             {
               // test the size
-              if (content_length > static_cast<std::ptrdiff_t>(max_body_size_))
+              if (content_length > static_cast<std::ptrdiff_t>(max_body_size()))
               {
                 response_code_ = response_status::code::PAYLOAD_TOO_LARGE;
                 clear();
@@ -944,27 +1252,41 @@ namespace via
             }
           }
 
-          // received buffer contains more than the required data
-          std::ptrdiff_t required(content_length -
-                                  static_cast<std::ptrdiff_t>(body_.size()));
-          if (rx_size > required)
+          // If the client is waiting for a 100 Continue before sending the body
+          if (request_parsed && (content_length > 0) && (iter == end) &&
+              request_.expect_continue() && !continue_sent_)
           {
-              ForwardIterator next(iter + required);
-              body_.insert(body_.end(), iter, next);
-              iter = next;
+            response_code_ = response_status::code::CONTINUE;
+            return RX_EXPECT_CONTINUE;
           }
-          else // received buffer <= required data
+
+          // received buffer contains more than the required data
+          std::ptrdiff_t required(content_length -
+              static_cast<std::ptrdiff_t>(body_size() + streamed_size_));
+          ForwardIterator next((rx_size > required) ? iter + required : end);
+          if (next > iter)
           {
-            if (end > iter)
+            response_status::code code(receive_content(iter, next));
+            if (code != response_status::code::OK)
             {
-              body_.insert(body_.end(), iter, end);
-              iter = end;
+              response_code_ = code;
+              clear();
+              return RX_INVALID;
             }
+            iter = next;
           }
 
           // determine whether the body is complete
-          if (body_.size() == static_cast<size_t>(request_.content_length()))
+          if ((body_size() + streamed_size_) ==
+              static_cast<size_t>(request_.content_length()))
           {
+            if (spool_.is_open() && !spool_.rewind())
+            {
+              response_code_ = response_status::code::INTERNAL_SERVER_ERROR;
+              clear();
+              return RX_INVALID;
+            }
+
             is_head_ = request_.is_head();
             // If enabled, translate a HEAD request to a GET request
             if (is_head_ && translate_head_)
@@ -995,7 +1317,7 @@ namespace via
           }
 
           // parse the chunk
-          if (!chunk_.parse(iter, end))
+          if (!parse_chunk(iter, end))
           {
             // if a parsing error (not run out of data)
             if (iter != end)
@@ -1012,20 +1334,32 @@ namespace via
             if (concatenate_chunks_)
             {
               if (chunk_.is_last())
+              {
+                if (spool_.is_open() && !spool_.rewind())
+                {
+                  response_code_ = response_status::code::INTERNAL_SERVER_ERROR;
+                  clear();
+                  return RX_INVALID;
+                }
                 return RX_VALID;
+              }
               else
               {
                 // Determine whether the total size of the concatenated chunks
                 // is within the maximum body size.
-                if ((body_.size() + chunk_.data().size()) > max_body_size_)
+                if ((body_size() + chunk_.data().size()) > max_body_size())
                 {
                   response_code_ = response_status::code::PAYLOAD_TOO_LARGE;
                   clear();
                   return RX_INVALID;
                 }
                 else // concatenate the chunk into the message body
-                  body_.insert(body_.end(),
-                               chunk_.data().begin(), chunk_.data().end());
+                  if (!append_body(chunk_.data().begin(), chunk_.data().end()))
+                  {
+                    response_code_ = response_status::code::INTERNAL_SERVER_ERROR;
+                    clear();
+                    return RX_INVALID;
+                  }
               }
             }
             else
@@ -16,9 +16,14 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "via/http/request_handler.hpp"
 #include "via/http/request_uri.hpp"
+#include "via/http/canned_response.hpp"
+#include "via/http/etag.hpp"
+#include "via/http/route_costs.hpp"
 #include "via/http/authentication/authentication.hpp"
 #include <boost/algorithm/string.hpp>
 #include <map>
+#include <vector>
+#include <unordered_map>
 
 namespace via
 {
@@ -96,11 +101,41 @@ namespace via
                                          Container const& data,
                                          Container& response_body)> Handler;
 
+      /// A function to get a version tag for the current response to a
+      /// request, e.g. a database row version or a file modification time.
+      /// It returns an empty string if the version is not known.
+      typedef std::function<std::string (rx_request const& request,
+                                         Parameters const& parameters)>
+        VersionHandler;
+
+      /// A request in a batch of requests for a batch handler.
+      struct BatchRequest
+      {
+        rx_request request;    ///< the HTTP request
+        Parameters parameters; ///< the route parameters
+        Container  body;       ///< the request body
+      };
+
+      /// A response to a request in a batch: the response and its body.
+      typedef std::pair<tx_response, Container> BatchResponse;
+
+      /// An HTTP request handler function for a batch of requests.
+      /// It returns a response for each request, in the same order.
+      typedef std::function<std::vector<BatchResponse>
+                            (std::vector<BatchRequest> const& requests)>
+        BatchHandler;
+
       /// A request handler with an (optional) authentication object pointer.
       struct AuthenticatedHandler
       {
         Handler handler;
         authentication::authentication const* auth_ptr;
+        /// The batch handler, if the requests are handled in batches.
+        BatchHandler batch_handler;
+        /// The maximum number of requests in a batch.
+        size_t max_batch_size;
+        /// The priority class of the requests, see http_server.
+        unsigned char priority;
       };
 
       /// A map of handlers
@@ -119,6 +154,10 @@ namespace via
         std::string    search_path;
         /// The map of HTTP methods to request handlers.
         MethodHandlers method_handlers;
+        /// Whether responses to GET and HEAD requests have ETags.
+        bool           etag;
+        /// The optional function to get the version tag of a response.
+        VersionHandler version_handler;
 
         /// Constructor
         Route(std::string const& path_str,
@@ -126,6 +165,8 @@ namespace via
           : path(path_str)
           , search_path(path_str)
           , method_handlers{method_handler}
+          , etag(false)
+          , version_handler()
         {
           // Find the first ':' in the path
           auto param_start(search_path.find(':'));
@@ -162,11 +203,41 @@ namespace via
       /// A const_iterator to the collection of routes.
       typedef typename Routes::const_iterator Routes_const_iterator;
 
+      /// The canned responses, keyed by uri.
+      typedef std::unordered_map<std::string, canned_response> CannedResponses;
+
+      /// @class routed_request
+      /// The result of routing a request, so that a request is only routed
+      /// and authenticated once.
+      struct routed_request
+      {
+        /// The canned response for the request, if any.
+        canned_response const* canned;
+        /// The handler for the request, nullptr if canned or not found.
+        AuthenticatedHandler const* handler;
+        /// The route of the request, if the handler was found.
+        Routes_const_iterator route_itr;
+        /// The route parameters (if any).
+        Parameters parameters;
+        /// The NOT_FOUND, METHOD_NOT_ALLOWED or UNAUTHORISED response if the
+        /// handler was not found.
+        tx_response response;
+      };
+
     private:
 
       /// The routes to search for an HTTP request.
       Routes routes_;
 
+      /// The canned responses to GET and HEAD requests.
+      CannedResponses canned_responses_;
+
+      /// Whether any routes have batch handlers.
+      bool has_batch_handlers_;
+
+      /// The costs of the handler calls, if accounted.
+      std::shared_ptr<http::route_costs> route_costs_;
+
       /// Searches for the request in the routes collection.
       /// @param uri_path the http request uri path
       /// @retval parameters the route paramters (if any)
@@ -194,6 +265,142 @@ namespace via
         return iter;
       }
 
+      /// A 304 Not Modified response with an ETag header.
+      /// @param etag the entity tag.
+      static tx_response not_modified(std::string const& etag)
+      {
+        tx_response response(response_status::code::NOT_MODIFIED);
+        response.add_header(header_field::HEADER_ETAG, etag);
+        return response;
+      }
+
+      /// Call a route's handler for a GET or HEAD request, adding an ETag
+      /// header to an OK response.
+      /// @param route the route with ETags enabled.
+      /// @param handler the request handler for the route and method.
+      /// @param request the HTTP request.
+      /// @param parameters the route parameters.
+      /// @param request_body the body of the HTTP request.
+      /// @retval response_body the body for the HTTP response, empty if the
+      /// response is 304 Not Modified.
+      /// @return the response header from the handler or Not Modified.
+      static tx_response handle_etag_request(Route const& route,
+                                             Handler const& handler,
+                                             rx_request const& request,
+                                             Parameters const& parameters,
+                                             Container const& request_body,
+                                             Container& response_body)
+      {
+        std::string_view if_none(request.headers().find
+                                   (header_field::LC_IF_NONE_MATCH));
+
+        // A version tag avoids calling the handler if the client is current
+        std::string etag;
+        if (route.version_handler)
+        {
+          std::string version(route.version_handler(request, parameters));
+          if (!version.empty())
+          {
+            etag = version_etag(version);
+            if (!if_none.empty() && if_none_match(if_none, etag))
+              return not_modified(etag);
+          }
+        }
+
+        tx_response response(handler(request, parameters,
+                                     request_body, response_body));
+        if (response.status() == static_cast<int>(response_status::code::OK))
+        {
+          if (etag.empty())
+            etag = strong_etag(response_body.data(), response_body.size());
+
+          if (!if_none.empty() && if_none_match(if_none, etag))
+          {
+            response_body.clear();
+            return not_modified(etag);
+          }
+
+          response.add_header(header_field::HEADER_ETAG, etag);
+        }
+
+        return response;
+      }
+
+      /// Find the handler for a request: search for its route and method and
+      /// authenticate it.
+      /// @param request the HTTP request.
+      /// @retval parameters the route parameters (if any).
+      /// @retval route_itr the route of the request, if found.
+      /// @retval response the NOT_FOUND, METHOD_NOT_ALLOWED or UNAUTHORISED
+      /// response if the handler was not found, unchanged otherwise.
+      /// @return a pointer to the handler, nullptr if not found.
+      AuthenticatedHandler const* find_handler(rx_request const& request,
+                                               Parameters& parameters,
+                                               Routes_const_iterator& route_itr,
+                                               tx_response& response) const
+      {
+        request_uri uri(request.uri());
+
+        // Search for the path and any route parameters associated with it
+        route_itr = find_route(uri.path(), parameters);
+        if (route_itr == routes_.cend())
+        {
+          response = tx_response(response_status::code::NOT_FOUND);
+          return nullptr;
+        }
+
+        // Search for the method
+        auto methods_iter(route_itr->method_handlers.find(request.method()));
+        if (methods_iter == route_itr->method_handlers.cend())
+        {
+          // send a METHOD_NOT_ALLOWED response with an ALLOW header
+          response = tx_response(response_status::code::METHOD_NOT_ALLOWED);
+          response.add_header(header_field::HEADER_ALLOW, route_itr->allowed_methods());
+          return nullptr;
+        }
+
+        // If this method has authentication
+        if (methods_iter->second.auth_ptr)
+        {
+          // authenticate the request
+          std::string challenge
+              (methods_iter->second.auth_ptr->authenticate(request));
+          if (!challenge.empty())
+          {
+            // authentication failed, send an UNAUTHORISED response
+            response = tx_response(response_status::code::UNAUTHORISED);
+            response.add_header(header_field::HEADER_WWW_AUTHENTICATE, challenge);
+            return nullptr;
+          }
+        }
+
+        return &methods_iter->second;
+      }
+
+      /// Add a handler for a method to the given path.
+      /// Creates the path if it's not already got any handlers.
+      /// @param method the method name (an uppercase string).
+      /// @param path the uri path.
+      /// @param handler the handler and its authentication.
+      /// @return true if the path is new, false otherwise.
+      bool add_handler(std::string_view method, std::string_view path,
+                       AuthenticatedHandler handler)
+      {
+        // Serach for the path in the existing routes
+        auto iter(std::find(routes_.begin(), routes_.end(), std::string(path)));
+        bool is_new_path(iter == routes_.end());
+        if (is_new_path)
+          routes_.push_back(Route(std::string(path),
+                    MethodHandlers_value_type(std::string(method),
+                                              std::move(handler))));
+        else
+          iter->method_handlers.insert
+              (MethodHandlers_value_type(std::string(method),
+                                         std::move(handler)));
+
+        return is_new_path;
+      }
+
     public:
 
       /// Constructor
@@ -201,6 +408,9 @@ namespace via
       explicit request_router()
         : request_handler<Container>()
         , routes_()
+        , canned_responses_()
+        , has_batch_handlers_(false)
+        , route_costs_()
       {}
 
       /// Destructor
@@ -213,22 +423,16 @@ namespace via
       /// @param path the uri path. Note: it may contain ':' characters to
       /// capture paramters from the uri path like Node.js.
       /// @param handler the request handler to be called.
+      /// @param priority the priority class of the requests, used if the
+      /// http_server schedules requests, default 0.
       /// @return true if the path is new, false otherwise.
       bool add_method(std::string_view method, std::string_view path,
                       Handler handler,
-                      authentication::authentication const* auth_ptr = nullptr)
+                      authentication::authentication const* auth_ptr = nullptr,
+                      unsigned char priority = 0u)
       {
-        // Serach for the path in the existing routes
-        auto iter(std::find(routes_.begin(), routes_.end(), path.data()));
-        bool is_new_path(iter == routes_.end());
-        if (is_new_path)
-          routes_.push_back(Route(std::string(path),
-                    MethodHandlers_value_type(std::string(method), { handler, auth_ptr })));
-        else
-          iter->method_handlers.insert
-              (MethodHandlers_value_type(std::string(method), { handler, auth_ptr }));
-
-        return is_new_path;
+        return add_handler(method, path,
+                           { handler, auth_ptr, BatchHandler(), 0u, priority });
       }
 
       /// Add a method and it's handler to the given path.
@@ -237,11 +441,158 @@ namespace via
       /// @param path the uri path. Note: it may contain ':' characters to
       /// capture paramters from the uri path like Node.js.
       /// @param handler the request handler to be called.
+      /// @param priority the priority class of the requests, used if the
+      /// http_server schedules requests, default 0.
       /// @return true if the path is new, false otherwise.
       bool add_method(request_method::id method_id, std::string_view path,
                       Handler handler,
+                      authentication::authentication const* auth_ptr = nullptr,
+                      unsigned char priority = 0u)
+      {
+        return add_method(request_method::name(method_id), path, handler,
+                          auth_ptr, priority);
+      }
+
+      /// Add a method and a batch handler to the given path.
+      /// An http_server collects the requests for the path and method that
+      /// are received in the same turn of the io_context, up to
+      /// max_batch_size, and passes them to one call of the batch handler.
+      /// So the handler can, for example, make one database query for all of
+      /// them. Otherwise, handle_request calls it with a single request.
+      /// Note: ETags are not supported on batch routes.
+      /// @param method_id the method id, e.g. request_method::id::GET.
+      /// @param path the uri path. Note: it may contain ':' characters to
+      /// capture paramters from the uri path like Node.js.
+      /// @param batch_handler the batch handler to be called.
+      /// @param max_batch_size the maximum number of requests in a batch.
+      /// @return true if the path is new, false otherwise.
+      bool add_batch_method(request_method::id method_id, std::string_view path,
+                            BatchHandler batch_handler,
+                            size_t max_batch_size = 64u,
                       authentication::authentication const* auth_ptr = nullptr)
-      { return add_method(request_method::name(method_id), path, handler, auth_ptr); }
+      {
+        Handler handler([batch_handler](rx_request const& request,
+                                        Parameters const& parameters,
+                                        Container const& body,
+                                        Container& response_body)
+        {
+          std::vector<BatchResponse> responses(batch_handler
+            (std::vector<BatchRequest>{ { request, parameters, body } }));
+          if (responses.empty())
+            return tx_response(response_status::code::INTERNAL_SERVER_ERROR);
+
+          response_body = std::move(responses.front().second);
+          return std::move(responses.front().first);
+        });
+
+        has_batch_handlers_ = true;
+        return add_handler(request_method::name(method_id), path,
+                           { handler, auth_ptr, batch_handler,
+                             std::max<size_t>(max_batch_size, 1u), 0u });
+      }
+
+      /// Enable ETags on the responses to GET and HEAD requests for a path.
+      /// An OK response gets a strong ETag header: the hash of its body or
+      /// the version tag from the version_handler, if given.
+      /// If the request has a matching If-None-Match header, a
+      /// 304 Not Modified response is sent without the body.
+      /// @pre the path must have been added by add_method.
+      /// @param path the uri path, as given to add_method.
+      /// @param version_handler an optional function to get the version tag
+      /// of the response, so that the handler is not called to build the
+      /// body for a client that already has it.
+      /// @return true if the path was found, false otherwise.
+      bool enable_etag(std::string_view path,
+                       VersionHandler version_handler = VersionHandler())
+      {
+        auto iter(std::find(routes_.begin(), routes_.end(), std::string(path)));
+        if (iter == routes_.end())
+          return false;
+
+        iter->etag = true;
+        iter->version_handler = version_handler;
+        return true;
+      }
+
+      /// Add a canned response to GET and HEAD requests for the given uri.
+      /// The response is serialised when it's added, so it can be sent
+      /// without calling a handler or formatting the response.
+      /// @pre canned responses must be added before the server accepts
+      /// connections.
+      /// @param uri the exact request uri, it may not contain ':' parameters.
+      /// @param response the response, without Date or Server headers.
+      /// @param body the response body.
+      /// @return true if the uri is new, false if it replaced a response.
+      bool add_canned_response(std::string_view uri, tx_response response,
+                               std::string_view body = std::string_view())
+      {
+        return canned_responses_.insert_or_assign(std::string(uri),
+                 canned_response(std::move(response), body)).second;
+      }
+
+      /// Find the canned response for a request.
+      /// @param request the HTTP request.
+      /// @return a pointer to the canned response, nullptr if none.
+      canned_response const* find_canned_response(rx_request const& request)
+        const
+      {
+        if (canned_responses_.empty() ||
+            !(request.is_get() || request.is_head()))
+          return nullptr;
+
+        auto iter(canned_responses_.find(request.uri()));
+        return (iter != canned_responses_.cend()) ? &iter->second : nullptr;
+      }
+
+      /// Route a request: find its canned response or search for its route
+      /// and method and authenticate it.
+      /// @param request the HTTP request.
+      /// @return the canned response or handler for the request, or the
+      /// response if neither was found.
+      routed_request route(rx_request const& request) const
+      {
+        routed_request routed{find_canned_response(request), nullptr,
+                              routes_.cend(), Parameters(),
+                              tx_response(response_status::code::OK)};
+        if (!routed.canned)
+          routed.handler = find_handler(request, routed.parameters,
+                                        routed.route_itr, routed.response);
+        return routed;
+      }
+
+      /// Handle an HTTP request that has already been routed.
+      /// @param routed the result of calling route with the request.
+      /// @param request the HTTP request.
+      /// @param request_body the body of the HTTP request.
+      /// @retval response_body the body for the HTTP response.
+      /// @return the response header from the handler or NOT_FOUND if it could
+      /// not find a handler for the request.
+      tx_response handle_request(routed_request const& routed,
+                                 rx_request const& request,
+                                 Container const& request_body,
+                                 Container& response_body) const
+      {
+        if (routed.canned)
+        {
+          response_body = Container(routed.canned->body().cbegin(),
+                                    routed.canned->body().cend());
+          return routed.canned->response();
+        }
+
+        AuthenticatedHandler const* handler(routed.handler);
+        if (!handler)
+          return routed.response;
+
+        // call the registered handler
+        route_costs::scope cost(route_costs_.get(), handler);
+        if (routed.route_itr->etag && (request.is_get() || request.is_head()))
+          return handle_etag_request(*routed.route_itr, handler->handler,
+                                     request, routed.parameters,
+                                     request_body, response_body);
+        else
+          return handler->handler(request, routed.parameters,
+                                  request_body, response_body);
+      }
 
       /// The function handle HTTP requests.
       /// It validates the request and routes it to the
@@ -254,44 +605,108 @@ namespace via
                                          Container const& request_body,
                                          Container& response_body) const
       {
-        request_uri uri(request.uri());
-
-        // Search for the path and any route parameters associated with it
-        Parameters parameters;
-        auto route_itr(find_route(uri.path(), parameters));
-        if (route_itr == routes_.cend())
-          return tx_response(response_status::code::NOT_FOUND);
+        return handle_request(route(request), request,
+                              request_body, response_body);
+      }
 
-        // Search for the method
-        auto methods_iter(route_itr->method_handlers.find(request.method()));
-        if (methods_iter == route_itr->method_handlers.cend())
+      /// Check whether a request would be routed to a handler, from its
+      /// headers alone. E.g. to decide whether to send a 100 Continue
+      /// response before the request body is received.
+      /// @param request the HTTP request.
+      /// @return a 100 Continue response if the request has a route, a
+      /// method handler and is authenticated, otherwise the NOT_FOUND,
+      /// METHOD_NOT_ALLOWED or UNAUTHORISED response.
+      tx_response check_request(rx_request const& request) const
+      {
+        tx_response response(response_status::code::CONTINUE);
+        if (!find_canned_response(request))
         {
-          // send a METHOD_NOT_ALLOWED response with an ALLOW header
-          tx_response response(response_status::code::METHOD_NOT_ALLOWED);
-          response.add_header(header_field::HEADER_ALLOW, route_itr->allowed_methods());
-          return response;
+          Parameters parameters;
+          Routes_const_iterator route_itr;
+          find_handler(request, parameters, route_itr, response);
         }
-        else
-        {
-          // If this method has authentication
-          if (methods_iter->second.auth_ptr)
+        return response;
+      }
+
+      /// Find the batch handler for a request.
+      /// @param request the HTTP request.
+      /// @retval parameters the route parameters (if any).
+      /// @return a pointer to the handler if the request's route and method
+      /// have a batch handler and the request is authenticated,
+      /// nullptr otherwise.
+      AuthenticatedHandler const* find_batch_handler(rx_request const& request,
+                                                     Parameters& parameters)
+        const
+      {
+        if (!has_batch_handlers_)
+          return nullptr;
+
+        Routes_const_iterator route_itr;
+        tx_response response(response_status::code::OK);
+        AuthenticatedHandler const* handler(find_handler(request, parameters,
+                                                         route_itr, response));
+        return (handler && handler->batch_handler) ? handler : nullptr;
+      }
+
+      /// The priority class of a request.
+      /// @param request the HTTP request.
+      /// @return the priority class of the request's route and method,
+      /// 0 if it doesn't have a handler.
+      unsigned char priority(rx_request const& request) const
+      {
+        Parameters parameters;
+        Routes_const_iterator route_itr;
+        tx_response response(response_status::code::OK);
+        AuthenticatedHandler const* handler(find_handler(request, parameters,
+                                                         route_itr, response));
+        return handler ? handler->priority : 0u;
+      }
+
+      /// Call a batch handler with a batch of requests.
+      /// @param handler the handler, from find_batch_handler.
+      /// @param requests the requests.
+      /// @return the responses to the requests.
+      std::vector<BatchResponse> handle_batch(AuthenticatedHandler const& handler,
+                                        std::vector<BatchRequest> const& requests)
+        const
+      {
+        route_costs::scope cost(route_costs_.get(), &handler);
+        return handler.batch_handler(requests);
+      }
+
+      /// Enable accounting for the thread CPU time and, optionally, the heap
+      /// allocations of the handler calls for each route and method.
+      /// @param enable enable the function, default true.
+      /// @param allocation_counter a function that returns the number of
+      /// heap allocations made by the calling thread, optional.
+      void set_cost_accounting(bool enable = true,
+                               route_costs::AllocationCounter
+                                 allocation_counter =
+                                   route_costs::AllocationCounter())
+      {
+        route_costs_ = enable
+          ? std::make_shared<http::route_costs>(allocation_counter) : nullptr;
+      }
+
+      /// The costs of the handler calls, merged from all threads.
+      /// @return the costs of the handlers that have been called, keyed by
+      /// method and route path, e.g. "GET /hello/:name".
+      std::map<std::string, route_cost> handler_costs() const
+      {
+        std::map<std::string, route_cost> named_costs;
+        if (!route_costs_)
+          return named_costs;
+
+        auto costs(route_costs_->costs());
+        for (auto const& route : routes_)
+          for (auto const& method_handler : route.method_handlers)
           {
-            // authenticate the request
-            std::string challenge
-                (methods_iter->second.auth_ptr->authenticate(request));
-            if (!challenge.empty())
-            {
-              // authentication failed, send an UNAUTHORISED response
-              tx_response response(response_status::code::UNAUTHORISED);
-              response.add_header(header_field::HEADER_WWW_AUTHENTICATE, challenge);
-              return response;
-            }
+            auto iter(costs.find(&method_handler.second));
+            if (iter != costs.cend())
+              named_costs.emplace(method_handler.first + ' ' + route.path,
+                                  iter->second);
           }
-
-          // call the registered handler
-          return methods_iter->second.handler(request, parameters,
-                                              request_body, response_body);
-        }
+        return named_costs;
       }
 
       /// Accessor for the stored routes
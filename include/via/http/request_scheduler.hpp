@@ -0,0 +1,216 @@
+#ifndef REQUEST_SCHEDULER_HPP_VIA_HTTPLIB_
+#define REQUEST_SCHEDULER_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file request_scheduler.hpp
+/// @brief Contains the request_scheduler class.
+//////////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#ifdef HTTP_THREAD_SAFE
+#include <mutex>
+#endif
+
+namespace via
+{
+  namespace http
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class request_scheduler
+    /// A weighted fair queue of requests in priority classes.
+    ///
+    /// Each priority class has a weight and a FIFO queue. A request is given
+    /// a virtual finish time when it's queued: the later of the current
+    /// virtual time and the finish time of the last request in its class,
+    /// plus the inverse of the class weight. The request with the earliest
+    /// finish time is served next, so while the classes are busy they are
+    /// served in proportion to their weights and an idle class can't save up
+    /// credit to starve the others.
+    /// @tparam T the type of a queued request.
+    //////////////////////////////////////////////////////////////////////////
+    template <typename T>
+    class request_scheduler
+    {
+    public:
+
+      /// The clock used to measure the time that requests wait.
+      typedef std::chrono::steady_clock clock_type;
+
+      /// The statistics of a priority class.
+      struct class_stats
+      {
+        size_t depth;      ///< the number of requests queued.
+        size_t max_depth;  ///< the maximum number of requests queued.
+        std::uint64_t served; ///< the number of requests served.
+        std::chrono::microseconds total_wait; ///< the total time waited.
+        std::chrono::microseconds max_wait;   ///< the longest time waited.
+      };
+
+    private:
+
+      /// The virtual time of a request in a class of weight one.
+      static const std::uint64_t VIRTUAL_COST = 1u << 20;
+
+      /// A queued request.
+      struct entry
+      {
+        std::uint64_t finish;          ///< the virtual finish time.
+        clock_type::time_point queued; ///< the time it was queued.
+        T item;                        ///< the request.
+      };
+
+      /// A priority class.
+      struct priority_class
+      {
+        std::uint64_t cost;        ///< the virtual cost of a request.
+        std::uint64_t last_finish; ///< the finish time of the last request.
+        std::deque<entry> queue;   ///< the queued requests.
+        class_stats stats;         ///< the class statistics.
+      };
+
+#ifdef HTTP_THREAD_SAFE
+      std::mutex mutex_;                    ///< protects the classes.
+#endif
+      std::vector<priority_class> classes_; ///< the priority classes.
+      std::uint64_t virtual_time_;          ///< the current virtual time.
+      size_t size_;                         ///< the number of requests queued.
+
+    public:
+
+      /// Default constructor.
+      /// Scheduling is disabled until set_weights is called.
+      request_scheduler() :
+#ifdef HTTP_THREAD_SAFE
+        mutex_(),
+#endif
+        classes_(),
+        virtual_time_(0u),
+        size_(0u)
+      {}
+
+      /// Set the priority classes and their weights.
+      /// Any queued requests are discarded.
+      /// @param weights the relative weight of each priority class, min 1.
+      /// An empty vector disables scheduling.
+      void set_weights(std::vector<unsigned int> const& weights)
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        classes_.clear();
+        for (auto weight : weights)
+          classes_.push_back(priority_class{
+            VIRTUAL_COST / std::max(weight, 1u), 0u, std::deque<entry>(),
+            class_stats{0u, 0u, 0u, std::chrono::microseconds::zero(),
+                        std::chrono::microseconds::zero()}});
+        virtual_time_ = 0u;
+        size_ = 0u;
+      }
+
+      /// Whether scheduling is enabled.
+      bool enabled() const noexcept
+      { return !classes_.empty(); }
+
+      /// The number of priority classes.
+      size_t classes() const noexcept
+      { return classes_.size(); }
+
+      /// Queue a request.
+      /// @pre scheduling is enabled.
+      /// @param priority the priority class of the request, the last class
+      /// is used if it's out of range.
+      /// @param item the request.
+      /// @param now the current time.
+      /// @return the number of requests that were queued before this one.
+      size_t push(size_t priority, T item,
+                  clock_type::time_point now = clock_type::now())
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        priority_class& the_class(classes_[std::min(priority,
+                                                    classes_.size() - 1u)]);
+        the_class.last_finish = std::max(virtual_time_, the_class.last_finish)
+                              + the_class.cost;
+        the_class.queue.push_back(entry{the_class.last_finish, now,
+                                        std::move(item)});
+        the_class.stats.depth = the_class.queue.size();
+        the_class.stats.max_depth = std::max(the_class.stats.max_depth,
+                                             the_class.stats.depth);
+        return size_++;
+      }
+
+      /// Remove the next request to serve.
+      /// @param now the current time.
+      /// @return the request, empty if none are queued.
+      std::optional<T> pop(clock_type::time_point now = clock_type::now())
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        priority_class* next(nullptr);
+        for (auto& the_class : classes_)
+          if (!the_class.queue.empty() &&
+              (!next ||
+               (the_class.queue.front().finish < next->queue.front().finish)))
+            next = &the_class;
+
+        if (!next)
+          return std::nullopt;
+
+        entry& front(next->queue.front());
+        virtual_time_ = front.finish;
+        std::optional<T> item(std::move(front.item));
+
+        auto wait(std::chrono::duration_cast<std::chrono::microseconds>
+                    (now - front.queued));
+        next->stats.total_wait += wait;
+        next->stats.max_wait = std::max(next->stats.max_wait, wait);
+        ++next->stats.served;
+
+        next->queue.pop_front();
+        next->stats.depth = next->queue.size();
+        --size_;
+        return item;
+      }
+
+      /// The number of requests queued.
+      size_t size()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return size_;
+      }
+
+      /// The statistics of the priority classes.
+      /// @return the statistics of each class, in class order.
+      std::vector<class_stats> stats()
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        std::vector<class_stats> all_stats;
+        all_stats.reserve(classes_.size());
+        for (auto const& the_class : classes_)
+          all_stats.push_back(the_class.stats);
+        return all_stats;
+      }
+    };
+  }
+}
+
+#endif
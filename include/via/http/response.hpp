@@ -17,8 +17,10 @@
 #include "response_status.hpp"
 #include "headers.hpp"
 #include "chunk.hpp"
+#include "parser_limits.hpp"
 #include <algorithm>
 #include <climits>
+#include <type_traits>
 
 namespace via
 {
@@ -77,8 +79,10 @@ namespace via
 
       /// Parse an individual character.
       /// @param c the character to be parsed.
+      /// @param limits the parser limits.
       /// @return true if valid, false otherwise.
-      bool parse_char(char c)
+      template<typename Limits>
+      bool parse_char(char c, Limits const& limits)
       {
         switch (state_)
         {
@@ -87,7 +91,7 @@ namespace via
           if (is_space_or_tab(c))
           {
             // but only upto to a limit!
-            if (++ws_count_ > max_whitespace_)
+            if (++ws_count_ > limits.max_whitespace())
             {
               state_ = RESP_ERROR_WS;
               return false;
@@ -131,7 +135,7 @@ namespace via
           break;
 
         case RESP_HTTP_MAJOR:
-          if (std::isdigit(c))
+          if (is_digit(c))
           {
             major_version_ = c;
             state_ = RESP_HTTP_DOT;
@@ -148,7 +152,7 @@ namespace via
           break;
 
         case RESP_HTTP_MINOR:
-          if (std::isdigit(c))
+          if (is_digit(c))
           {
             minor_version_ = c;
             // must be at least one whitespace before status
@@ -169,12 +173,12 @@ namespace via
           break;
 
         case RESP_STATUS:
-          if (std::isdigit(c))
+          if (is_digit(c))
           {
             status_read_ = true;
             status_ *= 10;
             status_ += read_digit(c);
-            if (status_ > max_status_no_)
+            if (status_ > limits.max_status_no())
             {
               state_ = RESP_ERROR_STATUS_VALUE;
               return false;
@@ -190,7 +194,7 @@ namespace via
             else // Ignore extra leading whitespace
             {
               // but only upto to a limit!
-              if (++ws_count_ > max_whitespace_)
+              if (++ws_count_ > limits.max_whitespace())
               {
                 state_ = RESP_ERROR_WS;
                 return false;
@@ -208,7 +212,7 @@ namespace via
             if (reason_phrase_.empty() && is_space_or_tab(c))
             {
               // but only upto to a limit!
-              if (++ws_count_ > max_whitespace_)
+              if (++ws_count_ > limits.max_whitespace())
               {
                 state_ = RESP_ERROR_WS;
                 return false;
@@ -217,7 +221,7 @@ namespace via
             else
             {
               reason_phrase_.push_back(c);
-              if (reason_phrase_.size() > max_reason_length_)
+              if (reason_phrase_.size() > limits.max_reason_length())
               {
                 state_ = RESP_ERROR_REASON_LENGTH;
                 return false;
@@ -234,7 +238,7 @@ namespace via
           else
           {
             // but (if not being strict) permit just \n
-            if (!strict_crlf_ && ('\n' == c))
+            if (!limits.strict_crlf() && ('\n' == c))
               state_ = RESP_VALID;
             else
             {
@@ -339,14 +343,16 @@ namespace via
       /// @retval iter reference to an iterator to the start of the data.
       /// If valid it will refer to the next char of data to be read.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
         while ((iter != end) && (RESP_VALID != state_))
         {
           char c(*iter++);
-          if ((fail_ = !parse_char(c))) // Note: deliberate assignment
+          if ((fail_ = !parse_char(c, limits))) // Note: deliberate assignment
             return false;
         }
         valid_ = (RESP_VALID == state_);
@@ -356,6 +362,31 @@ namespace via
 #pragma warning( pop )
 #endif
 
+      /// Parse the line as an HTTP response using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// If valid it will refer to the next char of data to be read.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the strict crlf parsing state.
+      bool strict_crlf() const noexcept
+      { return strict_crlf_; }
+
+      /// Accessor for the max no of consectutive whitespace characters.
+      unsigned char max_whitespace() const noexcept
+      { return max_whitespace_; }
+
+      /// Accessor for the maximum number of a response status.
+      unsigned short max_status_no() const noexcept
+      { return max_status_no_; }
+
+      /// Accessor for the maximum length of a response reason.
+      size_t max_reason_length() const noexcept
+      { return max_reason_length_; }
+
       /// Accessor for the HTTP major version number.
       /// @return the major version number.
       char major_version() const noexcept
@@ -564,20 +595,43 @@ namespace via
       ///   - the start of the next http response, or
       ///   - the end of the data buffer.
       /// @param end the end of the data buffer.
+      /// @param limits the parser limits, see parser_limits.hpp.
       /// @return true if parsed ok false otherwise.
-      template<typename ForwardIterator>
-      bool parse(ForwardIterator& iter, ForwardIterator end)
+      template<typename ForwardIterator, typename Limits>
+      bool parse(ForwardIterator& iter, ForwardIterator end,
+                 Limits const& limits)
       {
-        if (!response_line::valid() && !response_line::parse(iter, end))
+        if (!response_line::valid() &&
+            !response_line::parse(iter, end, limits))
           return false;
 
-        if (!headers_.valid() && !headers_.parse(iter, end))
+        if (!headers_.valid() && !headers_.parse(iter, end, limits))
           return false;
 
         valid_ = true;
         return valid_;
       }
 
+      /// Parse an HTTP response using the constructor limits.
+      /// @retval iter reference to an iterator to the start of the data.
+      /// @param end the end of the data buffer.
+      /// @return true if parsed ok false otherwise.
+      template<typename ForwardIterator>
+      bool parse(ForwardIterator& iter, ForwardIterator end)
+      { return parse(iter, end, *this); }
+
+      /// Accessor for the max length of a header field line.
+      unsigned short max_line_length() const noexcept
+      { return headers_.max_line_length(); }
+
+      /// Accessor for the max no of header fields.
+      unsigned short max_header_number() const noexcept
+      { return headers_.max_header_number(); }
+
+      /// Accessor for the max cumulative length of the header fields.
+      size_t max_header_length() const noexcept
+      { return headers_.max_header_length(); }
+
       /// Accessor for the response message headers.
       /// @return a constant reference to the message_headers
       const message_headers& headers() const noexcept
@@ -674,7 +728,7 @@ namespace via
 
       /// Add a Date header to the response.
       void add_date_header()
-      { header_string_ += header_field::date_header(); }
+      { header_string_ += header_field::cached_date_header(); }
 
       /// Add a Server header to the response.
       void add_server_header()
@@ -689,6 +743,22 @@ namespace via
       bool is_valid() const noexcept
       { return !are_headers_split(header_string_); }
 
+      /// Whether Chunked Transfer Coding is applied to the response.
+      /// @return true if there is a Transfer-Encoding header and it does
+      /// NOT contain the keyword "identity". See RFC2616 section 4.4 para 2.
+      bool is_chunked() const
+      {
+        size_t start(header_string_.find(header_field::HEADER_TRANSFER_ENCODING));
+        if (start == std::string::npos)
+          return false;
+
+        std::string xfer_encoding(header_string_.substr(start,
+                                  header_string_.find(CRLF, start) - start));
+        std::transform(xfer_encoding.begin(), xfer_encoding.end(),
+                       xfer_encoding.begin(), to_lower);
+        return (xfer_encoding.find(IDENTITY) == std::string::npos);
+      }
+
       /// The http message header string.
       /// @param content_length the size of the message body for the
       /// content_length header.
@@ -716,8 +786,12 @@ namespace via
     //////////////////////////////////////////////////////////////////////////
     /// @class response_receiver
     /// A template class to receive HTTP responses and any associated data.
+    /// @param Container the type of container in which the response is held.
+    /// @param Limits the parser limits: runtime_limits (the default) for the
+    /// limits passed to the constructor, or a class with compile time limits,
+    /// e.g. response_limits, see parser_limits.hpp.
     //////////////////////////////////////////////////////////////////////////
-    template <typename Container>
+    template <typename Container, typename Limits = runtime_limits>
     class response_receiver
     {
       /// Parser parameters
@@ -728,6 +802,35 @@ namespace via
       rx_chunk<Container> chunk_; ///< the received chunk
       Container   body_;          ///< the response body or data for the last chunk
 
+      /// Parse the response with the Limits.
+      template<typename ForwardIterator>
+      bool parse_response(ForwardIterator& iter, ForwardIterator end)
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return response_.parse(iter, end);
+        else
+          return response_.parse(iter, end, Limits());
+      }
+
+      /// Parse a chunk with the Limits.
+      template<typename ForwardIterator>
+      bool parse_chunk(ForwardIterator& iter, ForwardIterator end)
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return chunk_.parse(iter, end);
+        else
+          return chunk_.parse(iter, end, Limits());
+      }
+
+      /// The maximum size of a response body.
+      size_t max_body_size() const noexcept
+      {
+        if constexpr (std::is_same_v<Limits, runtime_limits>)
+          return max_body_size_;
+        else
+          return Limits::max_body_size();
+      }
+
     public:
 
       /// The default maximum number of consectutive whitespace characters
@@ -759,6 +862,8 @@ namespace via
       /// Constructor.
       /// Sets the parser parameters and all member variables to their initial
       /// state.
+      /// Note: the parser parameters are not used if Limits provides compile
+      /// time limits.
       /// @param strict_crlf enforce strict parsing of CRLF, default false.
       /// @param max_whitespace the maximum number of consectutive whitespace
       /// characters allowed in a request: default 254, min 1, max 254.
@@ -829,7 +934,7 @@ namespace via
         if (response_parsed)
         {
           // failed to parse response
-          if (!response_.parse(iter, end))
+          if (!parse_response(iter, end))
           {
             // if a parsing error (not run out of data)
             if ((iter != end) || response_.fail())
@@ -859,7 +964,7 @@ namespace via
           std::ptrdiff_t rx_size(std::distance(iter, end));
           if ((rx_size > 0) && (content_length == 0) &&
               response_.headers().find(header_field::LC_CONTENT_LENGTH).empty())
-            content_length = max_body_size_;
+            content_length = max_body_size();
 
           // received buffer contains more than the required data
           std::ptrdiff_t required(content_length -
@@ -895,7 +1000,7 @@ namespace via
             return RX_VALID;
 
           // parse the chunk
-          if (!chunk_.parse(iter, end))
+          if (!parse_chunk(iter, end))
           {
             // if a parsing error (not run out of data)
             if (iter != end)
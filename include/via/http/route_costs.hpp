@@ -0,0 +1,231 @@
+#ifndef ROUTE_COSTS_HPP_VIA_HTTPLIB_
+#define ROUTE_COSTS_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file route_costs.hpp
+/// @brief Contains the route_costs class, which accounts for the CPU time
+/// and allocations of request handlers.
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/loop_monitor.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace via
+{
+  namespace http
+  {
+    /// The cost of the calls to a request handler.
+    struct route_cost
+    {
+      std::uint64_t calls;                ///< the number of calls.
+      std::chrono::nanoseconds cpu_time;  ///< the total thread CPU time.
+      std::uint64_t allocations;          ///< the total heap allocations.
+      comms::lag_histogram cpu_histogram; ///< the CPU time of the calls.
+
+      /// Default constructor.
+      route_cost() :
+        calls(0u),
+        cpu_time(std::chrono::nanoseconds::zero()),
+        allocations(0u),
+        cpu_histogram()
+      {}
+
+      /// Add the costs of other calls to the handler.
+      /// @param other the other costs.
+      void merge(route_cost const& other) noexcept
+      {
+        calls += other.calls;
+        cpu_time += other.cpu_time;
+        allocations += other.allocations;
+        cpu_histogram.merge(other.cpu_histogram);
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class route_costs
+    /// Accounts for the thread CPU time and, optionally, the heap
+    /// allocations of each request handler call.
+    ///
+    /// Unlike the wall clock time of a handler, its thread CPU time doesn't
+    /// include the time that it waited for I/O or for other threads, so it's
+    /// the real cost of the handler.
+    ///
+    /// Each thread that calls handlers adds to its own counters, so the
+    /// threads don't contend; the counters are merged when they're read.
+    /// The CPU time is read from CLOCK_THREAD_CPUTIME_ID, so it's zero on
+    /// platforms without it. The allocations are counted by an optional
+    /// function that returns the number of allocations made by the calling
+    /// thread, e.g. from a replaced operator new or the allocator's
+    /// statistics.
+    /// @see request_router::set_cost_accounting
+    //////////////////////////////////////////////////////////////////////////
+    class route_costs
+    {
+    public:
+
+      /// A function that returns the number of heap allocations made by the
+      /// calling thread so far.
+      typedef std::function<std::uint64_t ()> AllocationCounter;
+
+      /// The costs of the calls to each handler, keyed by handler.
+      typedef std::unordered_map<void const*, route_cost> Costs;
+
+    private:
+
+      /// The costs of the handler calls made by a thread.
+      struct thread_slot
+      {
+        std::mutex mutex; ///< protects costs, only contended by reads.
+        Costs costs;      ///< the costs of the thread's handler calls.
+      };
+
+      /// The instance id, so that thread_local caches can't confuse
+      /// route_costs.
+      const size_t id_;
+      AllocationCounter allocation_counter_; ///< the allocation counter.
+
+      /// Protects slots_.
+      std::mutex mutex_;
+      /// The thread slots, one for each thread that calls handlers.
+      std::vector<std::unique_ptr<thread_slot>> slots_;
+
+      /// The next instance id.
+      static size_t next_id()
+      {
+        static std::atomic<size_t> id(0u);
+        return ++id;
+      }
+
+      /// The CPU time used by the calling thread.
+      static std::chrono::nanoseconds thread_cpu_time() noexcept
+      {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+          return std::chrono::seconds(ts.tv_sec) +
+                 std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+        return std::chrono::nanoseconds::zero();
+      }
+
+      /// Get the slot for the calling thread, creating it if necessary.
+      /// A thread may call the handlers of several routers, so it caches a
+      /// slot for each route_costs.
+      thread_slot& this_thread_slot()
+      {
+        thread_local std::vector<std::pair<size_t, thread_slot*>> cached_slots;
+        for (auto const& cached : cached_slots)
+          if (cached.first == id_)
+            return *cached.second;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_.push_back(std::make_unique<thread_slot>());
+        cached_slots.emplace_back(id_, slots_.back().get());
+        return *slots_.back();
+      }
+
+    public:
+
+      //////////////////////////////////////////////////////////////////////
+      /// @class scope
+      /// The scope of a request handler call on the calling thread.
+      //////////////////////////////////////////////////////////////////////
+      class scope
+      {
+        route_costs* costs_;               ///< the route_costs, if any.
+        void const* handler_;              ///< the handler called.
+        std::chrono::nanoseconds start_;   ///< the CPU time at the start.
+        std::uint64_t allocations_;        ///< the allocations at the start.
+
+      public:
+
+        /// Enter a request handler call.
+        /// @param costs the route_costs, nullptr if none.
+        /// @param handler the handler called.
+        scope(route_costs* costs, void const* handler) :
+          costs_(costs),
+          handler_(handler),
+          start_(costs_ ? thread_cpu_time() : std::chrono::nanoseconds::zero()),
+          allocations_((costs_ && costs_->allocation_counter_)
+                         ? costs_->allocation_counter_() : 0u)
+        {}
+
+        /// Leave the request handler call and add its cost.
+        ~scope()
+        {
+          if (!costs_)
+            return;
+
+          auto cpu_time(thread_cpu_time() - start_);
+          std::uint64_t allocations(costs_->allocation_counter_
+                                      ? costs_->allocation_counter_() -
+                                        allocations_
+                                      : 0u);
+
+          thread_slot& slot(costs_->this_thread_slot());
+          std::lock_guard<std::mutex> lock(slot.mutex);
+          route_cost& cost(slot.costs[handler_]);
+          ++cost.calls;
+          cost.cpu_time += cpu_time;
+          cost.allocations += allocations;
+          cost.cpu_histogram.add
+            (std::chrono::duration_cast<std::chrono::microseconds>(cpu_time));
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+      };
+
+      /// Constructor.
+      /// @param allocation_counter the function that returns the number of
+      /// allocations made by the calling thread, optional.
+      explicit route_costs(AllocationCounter allocation_counter =
+                             AllocationCounter()) :
+        id_(next_id()),
+        allocation_counter_(allocation_counter),
+        mutex_(),
+        slots_()
+      {}
+
+      /// Disable copy construction.
+      route_costs(route_costs const&) = delete;
+
+      /// Disable assignment.
+      route_costs& operator=(route_costs const&) = delete;
+
+      /// The costs of the handler calls made by all threads.
+      /// @return the costs, keyed by handler.
+      Costs costs()
+      {
+        Costs merged;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto const& slot : slots_)
+        {
+          std::lock_guard<std::mutex> slot_lock(slot->mutex);
+          for (auto const& cost : slot->costs)
+            merged[cost.first].merge(cost.second);
+        }
+        return merged;
+      }
+    };
+  }
+}
+
+#endif
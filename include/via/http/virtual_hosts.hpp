@@ -0,0 +1,174 @@
+#ifndef VIRTUAL_HOSTS_HPP_VIA_HTTPLIB_
+#define VIRTUAL_HOSTS_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file virtual_hosts.hpp
+/// @brief Contains the virtual_hosts template class.
+//////////////////////////////////////////////////////////////////////////////
+#include "character.hpp"
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <tuple>
+#include <utility>
+
+namespace via
+{
+  namespace http
+  {
+    /// The host name in a Host header value, without the port number.
+    /// @param host the Host header value, e.g. "example.com:8080" or
+    /// "[::1]:8080".
+    /// @return the host name, e.g. "example.com" or "[::1]".
+    inline std::string_view host_name(std::string_view host) noexcept
+    {
+      // An IPv6 address literal contains ':' characters
+      size_t start(host.empty() || (host[0] != '[') ? 0u : host.find(']'));
+      if (start == std::string_view::npos)
+        return host;
+
+      size_t colon(host.find(':', start));
+      return (colon == std::string_view::npos) ? host : host.substr(0, colon);
+    }
+
+    /// A case insensitive hash of a host name: FNV-1a on the lower case
+    /// characters.
+    struct host_name_hash
+    {
+      /// The hash function.
+      size_t operator()(std::string_view host) const noexcept
+      {
+        size_t hash(static_cast<size_t>(14695981039346656037ULL));
+        for (char c : host)
+        {
+          hash ^= static_cast<unsigned char>(to_lower(c));
+          hash *= static_cast<size_t>(1099511628211ULL);
+        }
+        return hash;
+      }
+    };
+
+    /// A case insensitive comparison of host names.
+    struct host_name_equal
+    {
+      /// The comparison function.
+      bool operator()(std::string_view lhs, std::string_view rhs) const noexcept
+      {
+        if (lhs.size() != rhs.size())
+          return false;
+
+        for (size_t i(0u); i < lhs.size(); ++i)
+          if (to_lower(lhs[i]) != to_lower(rhs[i]))
+            return false;
+        return true;
+      }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @class virtual_hosts
+    /// A collection of values, e.g. request_routers, for host names.
+    ///
+    /// A host name may be a wildcard: "*.example.com", which matches any
+    /// subdomain of example.com but not example.com itself.
+    /// An exact host name is found before a wildcard and the longest
+    /// matching wildcard is found before shorter ones.
+    /// Host names are compared case insensitively.
+    /// @tparam T the type of value, e.g. a request_router.
+    //////////////////////////////////////////////////////////////////////////
+    template <typename T>
+    class virtual_hosts
+    {
+      /// The host names and values, a deque so that references are stable.
+      std::deque<std::pair<std::string, T>> values_;
+
+      /// A map of host names or wildcard suffixes to values.
+      typedef std::unordered_map<std::string_view, T*,
+                                 host_name_hash, host_name_equal> host_map;
+
+      host_map hosts_;     ///< The exact host names.
+      host_map wildcards_; ///< The wildcard suffixes, e.g. ".example.com".
+
+    public:
+
+      /// Default constructor.
+      virtual_hosts() :
+        values_(),
+        hosts_(),
+        wildcards_()
+      {}
+
+      /// Disable copy construction, the maps refer to values_.
+      virtual_hosts(virtual_hosts const& other) = delete;
+
+      /// Disable assignment.
+      virtual_hosts& operator=(virtual_hosts const& other) = delete;
+
+      /// Whether there are any hosts.
+      bool empty() const noexcept
+      { return values_.empty(); }
+
+      /// The number of hosts.
+      size_t size() const noexcept
+      { return values_.size(); }
+
+      /// Get the value for a host name, creating it if necessary.
+      /// @param host the host name, e.g. "api.example.com" or
+      /// "*.example.com".
+      /// @return a reference to the value for the host name.
+      T& operator[](std::string_view host)
+      {
+        bool is_wildcard((host.size() > 1u) && (host[0] == '*') &&
+                         (host[1] == '.'));
+        host_map& hosts(is_wildcard ? wildcards_ : hosts_);
+        std::string_view key(is_wildcard ? host.substr(1) : host);
+
+        auto iter(hosts.find(key));
+        if (iter != hosts.end())
+          return *iter->second;
+
+        values_.emplace_back(std::piecewise_construct,
+                             std::forward_as_tuple(host),
+                             std::forward_as_tuple());
+        auto& value(values_.back());
+        std::string_view stored(value.first);
+        hosts.emplace(is_wildcard ? stored.substr(1) : stored, &value.second);
+        return value.second;
+      }
+
+      /// Find the value for a host name.
+      /// @param host the host name, without a port number.
+      /// @return a pointer to the value, nullptr if not found.
+      T const* find(std::string_view host) const noexcept
+      {
+        auto iter(hosts_.find(host));
+        if (iter != hosts_.end())
+          return iter->second;
+
+        if (!wildcards_.empty())
+        {
+          for (size_t dot(host.find('.')); dot != std::string_view::npos;
+               dot = host.find('.', dot + 1u))
+          {
+            auto wild_iter(wildcards_.find(host.substr(dot)));
+            if (wild_iter != wildcards_.end())
+              return wild_iter->second;
+          }
+        }
+
+        return nullptr;
+      }
+    };
+  }
+}
+
+#endif
@@ -88,6 +88,8 @@ namespace via
 
     std::string tx_header_; /// A buffer for the HTTP request header.
     Container   tx_body_;   /// A buffer for the HTTP request body.
+    http::chunk_size_line tx_chunk_line_; /// The size line of a chunk.
+    size_t chunk_coalesce_size_; /// The maximum size of combined chunks.
     Container   rx_buffer_; /// A buffer for the last packet read.
 
     ResponseHandler   http_response_handler_; ///< the response callback function
@@ -133,6 +135,16 @@ namespace via
       return connection_->send_data(std::move(buffers));
     }
 
+    /// Send a frame of chunked data on the underlying connection.
+    /// The frame is owned by the connection's transmit queue until sent.
+    /// @param frame the frame to send.
+    bool send_frame(Container frame)
+    {
+      rx_.clear();
+      connection_->send_data(std::move(frame), chunk_coalesce_size_);
+      return true;
+    }
+
     /// Receive data on the underlying connection.
     void receive_handler()
     {
@@ -277,6 +289,8 @@ namespace via
       host_name_(),
       tx_header_(),
       tx_body_(),
+      tx_chunk_line_(),
+      chunk_coalesce_size_(0u),
       rx_buffer_(),
       http_response_handler_(response_handler),
       http_chunk_handler_(chunk_handler),
@@ -484,6 +498,8 @@ namespace via
     // send_chunk functions
 
     /// Send an HTTP body chunk.
+    /// The chunk size line, data and CRLF are sent in one frame, which may
+    /// be combined with the previous frame, see set_chunk_coalescing.
     /// @param chunk the body chunk to send
     /// @param extension the (optional) chunk extension.
     bool send_chunk(Container chunk,
@@ -492,18 +508,14 @@ namespace via
       if (!is_connected())
         return false;
 
-      size_t size(chunk.size());
-      http::chunk_header chunk_header(size, extension);
-      tx_header_ = chunk_header.to_string();
-      tx_body_.swap(chunk);
-
-      comms::ConstBuffers buffers(1, ASIO::buffer(tx_header_));
-      buffers.push_back(ASIO::buffer(tx_body_));
-      buffers.push_back(ASIO::buffer(http::CRLF));
-      return send(std::move(buffers));
+      Container frame;
+      http::encode_chunk(frame, chunk.data(), chunk.size(), extension);
+      return send_frame(std::move(frame));
     }
 
     /// Send an HTTP body chunk.
+    /// If nothing is being sent and there is no extension, the buffers are
+    /// sent with the chunk size line, otherwise they are copied into a frame.
     /// @pre The contents of the buffers are NOT buffered.
     /// Their lifetime MUST exceed that of the write
     /// @param buffers the body chunk to send
@@ -514,14 +526,29 @@ namespace via
       if (!is_connected())
         return false;
 
+      std::shared_ptr<connection_type> tcp_pointer(connection_);
       // Calculate the overall size of the data in the buffers
       size_t size(ASIO::buffer_size(buffers));
+      if (extension.empty() && tcp_pointer->tx_idle())
+      {
+        rx_.clear();
+        tx_chunk_line_ = http::chunk_size_line(size);
+        buffers.push_front(ASIO::buffer(tx_chunk_line_.data(),
+                                        tx_chunk_line_.size()));
+        buffers.push_back(ASIO::buffer(http::CRLF, 2));
+        return tcp_pointer->send_data(std::move(buffers));
+      }
 
-      http::chunk_header chunk_header(size, extension);
-      tx_header_ = chunk_header.to_string();
-      buffers.push_front(ASIO::buffer(tx_header_));
-      buffers.push_back(ASIO::buffer(http::CRLF));
-      return send(std::move(buffers));
+      Container frame;
+      frame.reserve(size + 32u + extension.size());
+      http::encode_chunk_header(frame, size, extension);
+      for (auto const& buffer : buffers)
+      {
+        char const* data(static_cast<char const*>(buffer.data()));
+        frame.insert(frame.end(), data, data + buffer.size());
+      }
+      frame.insert(frame.end(), http::CRLF, http::CRLF + 2);
+      return send_frame(std::move(frame));
     }
 
     /// Send the last HTTP chunk for a request.
@@ -533,12 +560,19 @@ namespace via
       if (!is_connected())
         return false;
 
-      http::last_chunk last_chunk(extension, trailer_string);
-      tx_header_ = last_chunk.to_string();
-
-      return send(comms::ConstBuffers(1, ASIO::buffer(tx_header_)));
+      std::string last_chunk(http::last_chunk(extension, trailer_string)
+                               .to_string());
+      return send_frame(Container(last_chunk.cbegin(), last_chunk.cend()));
     }
 
+    /// Set the maximum size of a frame of combined chunks.
+    /// Chunks sent while an earlier write is in progress are combined into
+    /// one frame, up to this size, to reduce the number of writes.
+    /// @param coalesce_size the maximum size of a frame, default zero:
+    /// don't combine chunks.
+    void set_chunk_coalescing(size_t coalesce_size = 0u) noexcept
+    { chunk_coalesce_size_ = coalesce_size; }
+
     ////////////////////////////////////////////////////////////////////////
     // other functions
 
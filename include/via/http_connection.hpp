@@ -17,7 +17,10 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "via/http/request.hpp"
 #include "via/http/response.hpp"
+#include "via/http/canned_response.hpp"
+#include "via/http/access_log.hpp"
 #include "via/comms/connection.hpp"
+#include "via/comms/timestamping.hpp"
 #include <deque>
 #include <iostream>
 
@@ -38,22 +41,29 @@ namespace via
   /// std::vector<char>.
   /// It must contain a contiguous array of bytes. E.g. std::string or
   /// std::array<char, size>
+  /// @tparam Limits the request parser limits: http::runtime_limits (the
+  /// default) for the limits passed to the constructor, or compile time
+  /// limits, e.g. http::request_limits.
   ////////////////////////////////////////////////////////////////////////////
-  template <typename SocketAdaptor, typename Container>
+  template <typename SocketAdaptor, typename Container,
+            typename Limits = http::runtime_limits>
   class http_connection : public std::enable_shared_from_this
-                                   <http_connection<SocketAdaptor, Container>>
+                           <http_connection<SocketAdaptor, Container, Limits>>
   {
   public:
     /// The underlying connection, TCP or SSL.
     typedef comms::connection<SocketAdaptor, Container> connection_type;
 
+    /// The request receiver type.
+    typedef http::request_receiver<Container, Limits> request_receiver_type;
+
     /// A weak pointer to this type.
-    typedef typename std::weak_ptr<http_connection<SocketAdaptor, Container>>
-                                                     weak_pointer;
+    typedef typename std::weak_ptr
+      <http_connection<SocketAdaptor, Container, Limits>> weak_pointer;
 
     /// A strong pointer to this type.
-    typedef typename std::shared_ptr<http_connection<SocketAdaptor, Container>>
-                                                     shared_pointer;
+    typedef typename std::shared_ptr
+      <http_connection<SocketAdaptor, Container, Limits>> shared_pointer;
 
     /// The template requires a typename to access the iterator.
     typedef typename Container::const_iterator Container_const_iterator;
@@ -70,7 +80,7 @@ namespace via
     std::string remote_address_;
 
     /// The request receiver for this connection.
-    http::request_receiver<Container> rx_;
+    request_receiver_type rx_;
 
     /// A buffer for the HTTP header of the response message.
     std::string tx_header_;
@@ -78,12 +88,89 @@ namespace via
     /// A buffer for the body of the response message.
     Container tx_body_;
 
+    /// The size line of the chunk being sent from caller's buffers.
+    http::chunk_size_line tx_chunk_line_;
+
+    /// The maximum size of a frame of combined chunks, zero for none.
+    size_t chunk_coalesce_size_;
+
     /// A buffer for the last packet read on the connection.
     Container rx_buffer_;
 
+    /// The access log, if enabled.
+    std::shared_ptr<http::access_log> access_log_;
+
+    /// The time that the last packet was read on the connection.
+    std::chrono::steady_clock::time_point rx_time_;
+
+    /// The kernel receive timestamp of the last packet, if enabled.
+    std::chrono::system_clock::time_point rx_timestamp_;
+
+    /// The number of received requests that haven't been responded to.
+    size_t responses_due_;
+
+    /// Whether to close the connection after the next response.
+    bool close_after_response_;
+
     ////////////////////////////////////////////////////////////////////////
     // Functions
 
+    /// Add a Connection: close header to a response, if the connection is
+    /// to be closed after it.
+    /// @param response the response.
+    void add_close_header(http::tx_response& response) const
+    {
+      if (close_after_response_ && !response.is_continue())
+        response.add_header(http::header_field::id::CONNECTION, "close");
+    }
+
+    /// Log the response to a request, if the access log is enabled.
+    /// Fires the response_queued probe.
+    /// @param request the request.
+    /// @param status the response status code.
+    /// @param bytes the size of the response body.
+    void log_access(http::rx_request const& request, int status, size_t bytes)
+    {
+      VIA_PROBE3(response_queued, connection_.lock().get(), status, bytes);
+      if (access_log_)
+        access_log_->log(http::access_record::create(request,
+          remote_address_, status, bytes,
+          std::chrono::duration_cast<std::chrono::microseconds>
+            (std::chrono::steady_clock::now() - rx_time_)));
+    }
+
+    /// Whether data is being sent on the connection, e.g. a deferred
+    /// response. A response must then not overwrite tx_header_ or tx_body_,
+    /// which may be being written, see send_data.
+    bool tx_busy() const
+    {
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      return tcp_pointer && !tcp_pointer->tx_idle();
+    }
+
+    /// Send buffers on the connection.
+    /// If data is being sent, the buffers are copied into a frame and
+    /// queued behind it, so that responses are sent in order.
+    /// @param tcp_connection the connection.
+    /// @param buffers the data to write.
+    static void send_data(connection_type& tcp_connection,
+                          comms::ConstBuffers& buffers)
+    {
+      if (tcp_connection.tx_idle())
+        tcp_connection.send_data(std::move(buffers));
+      else
+      {
+        Container frame;
+        frame.reserve(ASIO::buffer_size(buffers));
+        for (auto const& buffer : buffers)
+        {
+          char const* data(static_cast<char const*>(buffer.data()));
+          frame.insert(frame.end(), data, data + buffer.size());
+        }
+        tcp_connection.send_data(std::move(frame));
+      }
+    }
+
     /// Send buffers on the connection.
     /// @param buffers the data to write.
     bool send(comms::ConstBuffers buffers)
@@ -91,7 +178,22 @@ namespace via
       std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
       if (tcp_pointer)
       {
-        tcp_pointer->send_data(std::move(buffers));
+        send_data(*tcp_pointer, buffers);
+        return true;
+      }
+      else
+        return false;
+    }
+
+    /// Send a frame of chunked data on the connection.
+    /// The frame is owned by the connection's transmit queue until sent.
+    /// @param frame the frame to send.
+    bool send_frame(Container frame)
+    {
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      if (tcp_pointer)
+      {
+        tcp_pointer->send_data(std::move(frame), chunk_coalesce_size_);
         return true;
       }
       else
@@ -101,23 +203,32 @@ namespace via
     /// Send buffers on the connection.
     /// @param buffers the data to write.
     /// @param is_continue whether this is a 100 Continue response
-    bool send(comms::ConstBuffers buffers, bool is_continue)
+    /// @param is_chunked whether this is the header of a chunked response,
+    /// which is complete when the last chunk is sent.
+    bool send(comms::ConstBuffers buffers, bool is_continue,
+              bool is_chunked = false)
     {
-      bool keep_alive(rx_.request().keep_alive());
+      bool keep_alive(rx_.request().keep_alive() &&
+                      (is_chunked || !close_after_response_));
       if (is_continue)
         rx_.set_continue_sent();
       else
+      {
         rx_.clear();
+        if (!is_chunked && (responses_due_ > 0u))
+          --responses_due_;
+      }
 
       std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
       if (tcp_pointer)
       {
-        tcp_pointer->send_data(std::move(buffers));
+        send_data(*tcp_pointer, buffers);
 
+        // Shutdown after the response and any data queued before it
         if (keep_alive)
           return true;
         else
-          tcp_pointer->shutdown();
+          tcp_pointer->disconnect();
       }
       else
         std::cerr << "http_connection::send connection weak pointer expired"
@@ -149,6 +260,7 @@ namespace via
     /// max 4 billion.
     /// @param max_chunk_size the maximum size of an HTTP request chunk:
     /// max 4 billion.
+    /// Note: the limits are not used if Limits provides compile time limits.
     http_connection(typename connection_type::weak_pointer connection,
                     bool           strict_crlf,
                     unsigned char  max_whitespace,
@@ -167,7 +279,14 @@ namespace via
           max_body_size, max_chunk_size),
       tx_header_(),
       tx_body_(),
-      rx_buffer_()
+      tx_chunk_line_(),
+      chunk_coalesce_size_(0u),
+      rx_buffer_(),
+      access_log_(),
+      rx_time_(),
+      rx_timestamp_(),
+      responses_due_(0u),
+      close_after_response_(false)
     {}
 
     /// The destructor calls close to ensure that all of the socket's
@@ -194,6 +313,22 @@ namespace via
     void set_concatenate_chunks(bool enable) noexcept
     { rx_.set_concatenate_chunks(enable); }
 
+    /// Set the maximum size of a request body to hold in memory.
+    /// @param threshold the maximum size of a body to hold in memory,
+    /// zero to always hold bodies in memory.
+    void set_spool_threshold(size_t threshold) noexcept
+    { rx_.set_spool_threshold(threshold); }
+
+    /// Set the request header fields to retain.
+    /// @param names the lower case header field names, all if null.
+    void set_retained_headers(std::shared_ptr<const http::HeaderNames> names)
+    { rx_.set_retained_headers(std::move(names)); }
+
+    /// Set the access log for the responses sent on this connection.
+    /// @param access_log the access log, nullptr to disable logging.
+    void set_access_log(std::shared_ptr<http::access_log> access_log) noexcept
+    { access_log_ = access_log; }
+
     ////////////////////////////////////////////////////////////////////////
     // Accessors
 
@@ -202,10 +337,22 @@ namespace via
     /// @return the receive buffer.
     Container const& read_rx_buffer()
     {
-      connection_.lock()->read_rx_buffer(rx_buffer_);
+      if (access_log_)
+        rx_time_ = std::chrono::steady_clock::now();
+      auto connection(connection_.lock());
+      if constexpr (comms::supports_timestamping<SocketAdaptor>::value)
+        rx_timestamp_ = connection->rx_timestamp();
+      connection->read_rx_buffer(rx_buffer_);
       return rx_buffer_;
     }
 
+    /// The kernel receive timestamp of the last packet read on the
+    /// connection, i.e. of the packet that completed the current request.
+    /// @return the timestamp, the epoch if timestamping is not enabled.
+    /// @see http_server::set_timestamping
+    std::chrono::system_clock::time_point rx_timestamp() const noexcept
+    { return rx_timestamp_; }
+
     /// Accessor for the receive buffer.
     /// @return the receive buffer.
     Container const& rx_buffer() const noexcept
@@ -217,7 +364,7 @@ namespace via
     { return remote_address_; }
 
     /// The request receiver for this connection.
-    http::request_receiver<Container>& rx() noexcept
+    request_receiver_type& rx() noexcept
     { return rx_; }
 
     /// Accessor for the HTTP request header.
@@ -230,6 +377,18 @@ namespace via
     Container const& body() const noexcept
     { return rx_.body(); }
 
+    /// Accessor for a request body that was spooled to a temporary file.
+    /// The file is deleted when the request handler returns or a response
+    /// is sent, whichever is first.
+    /// @return a constant reference to the body_spool, it is not open if
+    /// the body is in memory.
+    http::body_spool const& spool_file() const noexcept
+    { return rx_.spool_file(); }
+
+    /// The size of the request body, in memory or in the spool file.
+    size_t body_size() const noexcept
+    { return rx_.body_size(); }
+
     /// Accessor for the received HTTP chunk.
     /// @return a constant reference to an rx_chunk.
     http::rx_chunk<Container> const& chunk() const noexcept
@@ -245,9 +404,14 @@ namespace via
       http::tx_response response(rx_.response_code());
       response.set_major_version(rx_.request().major_version());
       response.set_minor_version(rx_.request().minor_version());
-      tx_header_ = response.message();
-
-      return send(comms::ConstBuffers(1, ASIO::buffer(tx_header_)),
+      add_close_header(response);
+      std::string frame_header;
+      std::string& header(tx_busy() ? frame_header : tx_header_);
+      header = response.message();
+
+      if (!response.is_continue())
+        log_access(rx_.request(), response.status(), 0u);
+      return send(comms::ConstBuffers(1, ASIO::buffer(header)),
                   response.is_continue());
     }
 
@@ -262,10 +426,15 @@ namespace via
 
       response.set_major_version(rx_.request().major_version());
       response.set_minor_version(rx_.request().minor_version());
-      tx_header_ = response.message();
-
-      return send(comms::ConstBuffers(1, ASIO::buffer(tx_header_)),
-                  response.is_continue());
+      add_close_header(response);
+      std::string frame_header;
+      std::string& header(tx_busy() ? frame_header : tx_header_);
+      header = response.message();
+
+      if (!response.is_continue())
+        log_access(rx_.request(), response.status(), 0u);
+      return send(comms::ConstBuffers(1, ASIO::buffer(header)),
+                  response.is_continue(), response.is_chunked());
     }
 
     /// Send an HTTP response with a body.
@@ -280,14 +449,20 @@ namespace via
 
       response.set_major_version(rx_.request().major_version());
       response.set_minor_version(rx_.request().minor_version());
-      tx_header_ = response.message(body.size());
-      comms::ConstBuffers buffers(1, ASIO::buffer(tx_header_));
+      add_close_header(response);
+      bool is_busy(tx_busy());
+      std::string frame_header;
+      std::string& header(is_busy ? frame_header : tx_header_);
+      header = response.message(body.size());
+      comms::ConstBuffers buffers(1, ASIO::buffer(header));
+      log_access(rx_.request(), response.status(), body.size());
 
       // Don't send a body in response to a HEAD request
       if (!rx_.is_head())
       {
-        tx_body_.swap(body);
-        buffers.push_back(ASIO::buffer(tx_body_));
+        if (!is_busy)
+          tx_body_.swap(body);
+        buffers.push_back(ASIO::buffer(is_busy ? body : tx_body_));
       }
 
       return send(std::move(buffers), response.is_continue());
@@ -313,33 +488,113 @@ namespace via
 
       response.set_major_version(rx_.request().major_version());
       response.set_minor_version(rx_.request().minor_version());
-      tx_header_ = response.message(size);
-      buffers.push_front(ASIO::buffer(tx_header_));
+      add_close_header(response);
+      std::string frame_header;
+      std::string& header(tx_busy() ? frame_header : tx_header_);
+      header = response.message(size);
+      buffers.push_front(ASIO::buffer(header));
+      log_access(rx_.request(), response.status(), size);
 
       return send(std::move(buffers), response.is_continue());
     }
 
+    /// Send a canned response.
+    /// The pre-serialised header and body are sent from the canned_response
+    /// with only the Date header formatted for this response.
+    /// @pre the canned_response must exist until the response has been sent.
+    /// @param response the canned response to send.
+    /// @return true if sent, false otherwise.
+    bool send(http::canned_response const& response)
+    {
+      // A canned response is HTTP/1.1 and keeps the connection alive
+      if (!rx_.request().is_http_1_1() || close_after_response_)
+      {
+        http::tx_response tx_response(response.response());
+        tx_response.add_date_header();
+        tx_response.add_server_header();
+        return send(std::move(tx_response),
+                    Container(response.body().cbegin(), response.body().cend()));
+      }
+
+      std::string frame_header;
+      std::string& header(tx_busy() ? frame_header : tx_header_);
+      header = http::header_field::cached_date_header();
+      header += http::CRLF;
+      comms::ConstBuffers buffers(1, ASIO::buffer(response.header()));
+      buffers.push_back(ASIO::buffer(header));
+      log_access(rx_.request(), response.status(), response.body().size());
+
+      // Don't send a body in response to a HEAD request
+      if (!rx_.is_head() && !response.body().empty())
+        buffers.push_back(ASIO::buffer(response.body()));
+
+      return send(std::move(buffers), false);
+    }
+
+    /// Send an HTTP response with a body to a request that is no longer the
+    /// current request, e.g. a request that was handled in a batch.
+    /// The response is sent in one frame, queued behind any data that is
+    /// being sent on the connection.
+    /// @pre the response must not contain any split headers.
+    /// @param request the request that the response is for.
+    /// @param is_head whether the request was a HEAD request.
+    /// @param response the response to send.
+    /// @param body the body to send
+    /// @return true if sent, false otherwise.
+    bool send_deferred(http::rx_request const& request, bool is_head,
+                       http::tx_response response, Container const& body)
+    {
+      if (!response.is_valid())
+        return false;
+
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      if (!tcp_pointer)
+        return false;
+
+      response.set_major_version(request.major_version());
+      response.set_minor_version(request.minor_version());
+      add_close_header(response);
+      std::string header(response.message(body.size()));
+      log_access(request, response.status(), body.size());
+
+      // Don't send a body in response to a HEAD request
+      Container frame(header.cbegin(), header.cend());
+      if (!is_head)
+        frame.insert(frame.end(), body.cbegin(), body.cend());
+      tcp_pointer->send_data(std::move(frame));
+      if (responses_due_ > 0u)
+        --responses_due_;
+
+      if (request.keep_alive() && !close_after_response_)
+        return true;
+
+      // Shutdown after the frame has been sent
+      tcp_pointer->disconnect();
+      return false;
+    }
+
     ////////////////////////////////////////////////////////////////////////
     // send_chunk functions
 
     /// Send an HTTP body chunk.
+    /// The chunk size line is sent in its own frame and the chunk, with a
+    /// CRLF appended, is moved into the transmit queue. The frames are only
+    /// copied if they're combined with the previous frame, see
+    /// set_chunk_coalescing.
     /// @param chunk the body chunk to send
     /// @param extension the (optional) chunk extension.
     bool send_chunk(Container chunk,
                      std::string_view extension = std::string_view())
     {
-      size_t size(chunk.size());
-      http::chunk_header chunk_header(size, extension);
-      tx_header_ = chunk_header.to_string();
-      tx_body_.swap(chunk);
-
-      comms::ConstBuffers buffers(1, ASIO::buffer(tx_header_));
-      buffers.push_back(ASIO::buffer(tx_body_));
-      buffers.push_back(ASIO::buffer(http::CRLF));
-      return send(std::move(buffers));
+      Container frame;
+      http::encode_chunk_header(frame, chunk.size(), extension);
+      chunk.insert(chunk.end(), http::CRLF, http::CRLF + 2);
+      return send_frame(std::move(frame)) && send_frame(std::move(chunk));
     }
 
     /// Send an HTTP body chunk.
+    /// If nothing is being sent and there is no extension, the buffers are
+    /// sent with the chunk size line, otherwise they are copied into a frame.
     /// @pre The contents of the buffers are NOT buffered.
     /// Their lifetime MUST exceed that of the write
     /// @param buffers the body chunk to send
@@ -347,14 +602,31 @@ namespace via
     bool send_chunk(comms::ConstBuffers buffers,
                      std::string_view extension = std::string_view())
     {
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      if (!tcp_pointer)
+        return false;
+
       // Calculate the overall size of the data in the buffers
       size_t size(ASIO::buffer_size(buffers));
+      if (extension.empty() && tcp_pointer->tx_idle())
+      {
+        tx_chunk_line_ = http::chunk_size_line(size);
+        buffers.push_front(ASIO::buffer(tx_chunk_line_.data(),
+                                        tx_chunk_line_.size()));
+        buffers.push_back(ASIO::buffer(http::CRLF, 2));
+        return tcp_pointer->send_data(std::move(buffers));
+      }
 
-      http::chunk_header chunk_header(size, extension);
-      tx_header_ = chunk_header.to_string();
-      buffers.push_front(ASIO::buffer(tx_header_));
-      buffers.push_back(ASIO::buffer(http::CRLF));
-      return send(std::move(buffers));
+      Container frame;
+      frame.reserve(size + 32u + extension.size());
+      http::encode_chunk_header(frame, size, extension);
+      for (auto const& buffer : buffers)
+      {
+        char const* data(static_cast<char const*>(buffer.data()));
+        frame.insert(frame.end(), data, data + buffer.size());
+      }
+      frame.insert(frame.end(), http::CRLF, http::CRLF + 2);
+      return send_frame(std::move(frame));
     }
 
     /// Send the last HTTP chunk for a response.
@@ -363,22 +635,63 @@ namespace via
     bool last_chunk(std::string_view extension = std::string_view(),
                      std::string_view trailer_string = std::string_view())
     {
-      http::last_chunk last_chunk(extension, trailer_string);
-      tx_header_ = last_chunk.to_string();
+      std::string last_chunk(http::last_chunk(extension, trailer_string)
+                               .to_string());
+      if (responses_due_ > 0u)
+        --responses_due_;
+      if (!send_frame(Container(last_chunk.cbegin(), last_chunk.cend())))
+        return false;
 
-      return send(comms::ConstBuffers(1, ASIO::buffer(tx_header_)));
+      // The chunked response is complete
+      if (close_after_response_)
+      {
+        disconnect();
+        return false;
+      }
+      return true;
     }
 
+    /// Set the maximum size of a frame of combined chunks.
+    /// Chunks sent while an earlier write is in progress are combined into
+    /// one frame, up to this size, to reduce the number of writes.
+    /// @param coalesce_size the maximum size of a frame, default zero:
+    /// don't combine chunks.
+    void set_chunk_coalescing(size_t coalesce_size = 0u) noexcept
+    { chunk_coalesce_size_ = coalesce_size; }
+
     ////////////////////////////////////////////////////////////////////////
     // other functions
 
+    /// Count a received request that is due a response.
+    void response_due() noexcept
+    { ++responses_due_; }
+
+    /// Whether the connection is idle: it's not receiving a request and
+    /// all of the requests that it has received have been responded to.
+    bool is_idle() const noexcept
+    { return (responses_due_ == 0u) && rx_.request().method().empty(); }
+
+    /// Close the connection after the next response, which is sent with a
+    /// Connection: close header.
+    /// @see http_server::drain
+    void set_close_after_response() noexcept
+    { close_after_response_ = true; }
+
     /// Disconnect the underlying connection.
     void disconnect()
-    { connection_.lock()->disconnect(); }
+    {
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      if (tcp_pointer)
+        tcp_pointer->disconnect();
+    }
 
-    /// Close the underlying connection.
+    /// Close the underlying connection, if it still exists.
     void close()
-    { connection_.lock()->close(); }
+    {
+      std::shared_ptr<connection_type> tcp_pointer(connection_.lock());
+      if (tcp_pointer)
+        tcp_pointer->close();
+    }
 
     /// Accessor function for the comms connection.
     /// @return a weak pointer to the connection
@@ -49,7 +49,14 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "http_connection.hpp"
 #include "via/comms/server.hpp"
+#include "via/comms/capture.hpp"
+#include "via/comms/loop_monitor.hpp"
+#include "via/comms/timestamping.hpp"
 #include "via/http/request_router.hpp"
+#include "via/http/virtual_hosts.hpp"
+#include "via/http/rate_limiter.hpp"
+#include "via/http/request_scheduler.hpp"
+#include "via/http/handler_watchdog.hpp"
 #ifdef HTTP_SSL
   #ifdef ASIO_STANDALONE
     #include <asio/ssl/context.hpp>
@@ -60,8 +67,11 @@
 #include <map>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
+#include <optional>
 #ifdef HTTP_THREAD_SAFE
 #include "via/thread/threadsafe_hash_map.hpp"
+#include <mutex>
 #else
 #include <map>
 #endif
@@ -79,8 +89,12 @@ namespace via
   /// tcp_adaptor or ssl::ssl_tcp_adaptor
   /// @tparam Container the container to use for the rx & tx buffers:
   /// std::vector<char> (the default) or std::string.
+  /// @tparam Limits the request parser limits: http::runtime_limits (the
+  /// default) for the limits set by the set_max_... functions, or compile
+  /// time limits, e.g. http::request_limits.
   ////////////////////////////////////////////////////////////////////////////
-  template <typename SocketAdaptor, typename Container = std::vector<char>>
+  template <typename SocketAdaptor, typename Container = std::vector<char>,
+            typename Limits = http::runtime_limits>
   class http_server
   {
   public:
@@ -89,7 +103,7 @@ namespace via
     typedef comms::server<SocketAdaptor, Container> server_type;
 
     /// The http_connections managed by this server.
-    typedef http_connection<SocketAdaptor, Container>
+    typedef http_connection<SocketAdaptor, Container, Limits>
       http_connection_type;
 
     /// The underlying comms connection, TCP or SSL.
@@ -108,7 +122,7 @@ namespace via
     typedef typename Container::const_iterator Container_const_iterator;
 
     /// The type of the request_receiver.
-    typedef typename http::request_receiver<Container> http_request;
+    typedef typename http_connection_type::request_receiver_type http_request;
 
     /// The chunk type
     typedef typename http::rx_chunk<Container> chunk_type;
@@ -127,21 +141,112 @@ namespace via
     typedef std::function <void (std::weak_ptr<http_connection_type>)>
       ConnectionHandler;
 
+    /// The BodyHandler type, see body_received_event.
+    typedef std::function <bool (std::weak_ptr<http_connection_type>,
+                                 http::rx_request const&,
+                                 char const*, size_t)>
+      BodyHandler;
+
+    /// The DrainedHandler type, called when a drain has finished.
+    typedef std::function <void ()> DrainedHandler;
+
     /// The built-in request_router type.
     typedef typename http::request_router<Container> request_router_type;
 
     /// The built-in request_router Handler type.
     typedef typename request_router_type::Handler request_router_handler_type;
 
+    /// The built-in rate_limiter type.
+    typedef http::rate_limiter rate_limiter_type;
+
+  private:
+
+    /// The request_scheduler type.
+    struct scheduled_request;
+    typedef http::request_scheduler<scheduled_request> request_scheduler_type;
+
+  public:
+
+    /// The statistics of a request priority class.
+    typedef typename request_scheduler_type::class_stats priority_class_stats;
+
   private:
 
+    /// The request_router handler type, the key of a batch of requests.
+    typedef typename request_router_type::AuthenticatedHandler
+      authenticated_handler_type;
+
+    /// The result of routing a request.
+    typedef typename request_router_type::routed_request routed_request_type;
+
+    /// The connection of a request in a batch.
+    struct batch_connection
+    {
+      std::weak_ptr<http_connection_type> weak_ptr; ///< the connection
+      http_connection_type* pointer; ///< the connection, for comparison
+      bool is_head;                  ///< whether it was a HEAD request
+    };
+
+    /// The requests waiting to be handled by a batch handler.
+    struct request_batch
+    {
+      std::vector<typename request_router_type::BatchRequest> requests;
+      std::vector<batch_connection> connections;
+      bool flush_posted; ///< whether a flush has been posted
+      request_router_type const* router; ///< the router of the handler
+    };
+
+    /// The requests waiting for each batch handler.
+    typedef std::map<authenticated_handler_type const*, request_batch>
+      request_batches;
+
+    /// A request waiting for the request_scheduler.
+    struct scheduled_request
+    {
+      std::weak_ptr<http_connection_type> weak_ptr; ///< the connection
+      http_connection_type* pointer;      ///< the connection, for comparison
+      bool is_head;                       ///< whether it was a HEAD request
+      request_router_type const* router;  ///< the router for the request
+      routed_request_type routed;         ///< the route of the request
+      http::rx_request request;           ///< the request
+      Container body;                     ///< the request body
+      bool is_spooled;                    ///< whether the body was spooled
+    };
+
+    /// The priority class and number of the scheduled requests from a
+    /// connection.
+    typedef std::map<http_connection_type const*,
+                     std::pair<unsigned char, size_t>> scheduled_connections;
+
     ////////////////////////////////////////////////////////////////////////
     // Variables
 
+    ASIO::io_context&     io_context_;       ///< the asio io_context
     std::shared_ptr<server_type> server_;    ///< the communications server
     connection_collection http_connections_; ///< the communications channels
     request_router_type   request_router_;   ///< the built-in request_router
+    /// The request_routers for virtual hosts.
+    http::virtual_hosts<request_router_type> host_routers_;
+    rate_limiter_type     rate_limiter_;     ///< the built-in rate_limiter
+    std::shared_ptr<http::access_log> access_log_; ///< the access log
+    std::shared_ptr<comms::capture_writer> capture_; ///< the traffic capture
+    comms::loop_monitor::shared_pointer loop_monitor_; ///< the lag monitor
+    /// the slow handler watchdog
+    std::shared_ptr<http::handler_watchdog> handler_watchdog_;
+    /// the socket timestamp latencies, if enabled
+    std::shared_ptr<comms::latency_stats> latency_stats_;
     bool                  shutting_down_;    ///< the server is shutting down
+    bool                  draining_;         ///< the server is draining
+    ASIO_TIMER            drain_timer_;      ///< the drain deadline timer
+    DrainedHandler        drained_handler_;  ///< the drained callback function
+    request_batches       request_batches_;  ///< the requests to batch
+    request_scheduler_type request_scheduler_; ///< schedules the handlers
+    std::string           priority_header_;  ///< the priority class header
+    /// the connections with scheduled requests
+    scheduled_connections scheduled_connections_;
+#ifdef HTTP_THREAD_SAFE
+    std::mutex            routing_mutex_;    ///< protects the routing state
+#endif
 
     // Request parser parameters
     bool           strict_crlf_;       ///< enforce strict parsing of CRLF
@@ -153,16 +258,21 @@ namespace via
     size_t         max_header_length_; ///< the max cumulative length
     size_t         max_body_size_;     ///< the maximum size of a request body
     size_t         max_chunk_size_;    ///< the maximum size of a request chunk
+    size_t         spool_threshold_;   ///< the maximum body size held in memory
+    /// the request header fields to retain, all if null
+    std::shared_ptr<const http::HeaderNames> retained_headers_;
 
     // HTTP server options
     bool require_host_header_; ///< whether the http server requires a host header
     bool translate_head_;      ///< whether the http server translates HEAD requests
     bool trace_enabled_;       ///< whether the http server responds to TRACE requests
     bool auto_disconnect_;     ///< whether the http server disconnects invalid requests
+    bool routing_requests_;    ///< whether the request_router handles requests
 
     // callback function pointers
     RequestHandler    http_request_handler_; ///< the request callback function
     ChunkHandler      http_chunk_handler_;   ///< the http chunk callback function
+    BodyHandler       http_body_handler_;    ///< the http body callback function
     RequestHandler    http_continue_handler_;///< the continue callback function
     RequestHandler    http_invalid_handler_; ///< the invalid callback function
     ConnectionHandler connected_handler_;    ///< the connected callback function
@@ -211,7 +321,39 @@ namespace via
 
         http_connection->set_translate_head(translate_head_);
         http_connection->set_concatenate_chunks(!http_chunk_handler_);
+        http_connection->set_spool_threshold(spool_threshold_);
+        http_connection->set_retained_headers(retained_headers_);
+        http_connection->set_access_log(access_log_);
+        if (http_body_handler_)
+        {
+          std::weak_ptr<http_connection_type> weak_ptr(http_connection);
+          http_connection->rx().set_body_handler([this, weak_ptr]
+            (http::rx_request const& request, char const* data, size_t size)
+          { return http_body_handler_(weak_ptr, request, data, size); });
+        }
+        if constexpr (comms::supports_timestamping<SocketAdaptor>::value)
+        {
+          if (latency_stats_)
+            connection.lock()->enable_timestamping(latency_stats_);
+        }
+
+        // Reject requests from clients over the rate limit before their
+        // bodies are received.
+        if (rate_limiter_.enabled())
+        {
+          http_connection_type* raw_pointer(http_connection.get());
+          http_connection->rx().set_request_check([this, raw_pointer]
+            (http::rx_request const& request)
+          {
+            return rate_limiter_.allow(request, raw_pointer->remote_address())
+                ? http::response_status::code::OK
+                : http::response_status::code::TOO_MANY_REQUESTS;
+          });
+        }
         http_connections_.emplace(pointer, http_connection);
+        if (capture_)
+          capture_->write(reinterpret_cast<std::uintptr_t>(pointer),
+                          comms::CONNECTED);
 
         // signal that the socket is connected
         if (connected_handler_)
@@ -222,7 +364,311 @@ namespace via
                   << http_connection->remote_address() << std::endl;
     }
 
-    /// Route the request using the request_router_.
+#ifdef HTTP_SSL
+    /// The SSL contexts for virtual hosts, selected by the TLS Server Name
+    /// Indication (SNI) extension.
+    static http::virtual_hosts<std::shared_ptr<ASIO::ssl::context>>&
+      ssl_host_contexts()
+    {
+      static http::virtual_hosts<std::shared_ptr<ASIO::ssl::context>>
+        contexts_;
+      return contexts_;
+    }
+
+    /// The OpenSSL server name callback function.
+    /// Switches the connection to the SSL context for the server name, if
+    /// there is one.
+    static int server_name_callback(SSL* ssl, int*, void*)
+    {
+      const char* name(SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name));
+      if (name)
+      {
+        auto context(ssl_host_contexts().find(name));
+        if (context && *context)
+          SSL_set_SSL_CTX(ssl, (*context)->native_handle());
+      }
+      return SSL_TLSEXT_ERR_OK;
+    }
+#endif
+
+    /// Select the request_router for a request's Host header.
+    /// @param request the received request.
+    /// @return the request_router for the host, or the request_router_ if
+    /// there isn't one.
+    request_router_type const& select_router(http::rx_request const& request)
+      const
+    {
+      if (!host_routers_.empty())
+      {
+        request_router_type const* router(host_routers_.find(http::host_name
+          (request.headers().find(http::header_field::LC_HOST))));
+        if (router)
+          return *router;
+      }
+
+      return request_router_;
+    }
+
+    /// Respond to a request containing an Expect: 100-continue header,
+    /// before its body is received.
+    /// Sends a 100 Continue response if the request_router would route the
+    /// request to a handler. Otherwise it sends the error response, e.g.
+    /// 404 Not Found, and disconnects so that the body is not received.
+    /// @param connection the connection that received the request.
+    void continue_routed_request
+                       (std::shared_ptr<http_connection_type> const& connection)
+    {
+      http::rx_request const& request(connection->request());
+      http::tx_response response(select_router(request).check_request(request));
+      if (response.is_continue())
+        connection->send_response();
+      else
+      {
+        response.add_date_header();
+        response.add_server_header();
+        response.add_header(http::header_field::id::CONNECTION, "close");
+        connection->send(std::move(response));
+        connection->disconnect();
+      }
+    }
+
+    /// Call a batch handler with its waiting requests and send the
+    /// responses.
+    /// @param handler the batch handler.
+    void flush_batch(authenticated_handler_type const* handler)
+    {
+      request_batch batch;
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        auto iter(request_batches_.find(handler));
+        if (iter == request_batches_.end())
+          return;
+
+        batch = std::move(iter->second);
+        request_batches_.erase(iter);
+      }
+
+      std::vector<typename request_router_type::BatchResponse> responses;
+      {
+        http::handler_watchdog::scope scope(handler_watchdog_.get(),
+                                            batch.requests.front().request.uri(),
+                                            "batch");
+        responses = batch.router->handle_batch(*handler, batch.requests);
+      }
+      for (size_t i(0u); i < batch.connections.size(); ++i)
+      {
+        std::shared_ptr<http_connection_type> connection
+          (batch.connections[i].weak_ptr.lock());
+        if (!connection)
+          continue;
+
+        // A request without a response is an error in the batch handler
+        http::tx_response response(http::response_status::code::
+                                     INTERNAL_SERVER_ERROR);
+        Container response_body;
+        if (i < responses.size())
+        {
+          response = std::move(responses[i].first);
+          response_body = std::move(responses[i].second);
+        }
+
+        response.add_date_header();
+        response.add_server_header();
+        connection->send_deferred(batch.requests[i].request,
+                                  batch.connections[i].is_head,
+                                  std::move(response), response_body);
+      }
+    }
+
+    /// Flush the batches holding requests from a connection, except for
+    /// the given batch handler, so that its responses are sent in order.
+    /// @param connection the connection.
+    /// @param handler the batch handler of the next request, if any.
+    void flush_connection_batches(http_connection_type const* connection,
+                                  authenticated_handler_type const* handler)
+    {
+      std::vector<authenticated_handler_type const*> handlers;
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        for (auto const& batch : request_batches_)
+          if (batch.first != handler)
+            for (auto const& batch_conn : batch.second.connections)
+              if (batch_conn.pointer == connection)
+              {
+                handlers.push_back(batch.first);
+                break;
+              }
+      }
+
+      for (auto batch_handler : handlers)
+        flush_batch(batch_handler);
+    }
+
+    /// Add a request to the batch for its handler.
+    /// The batch is flushed when it's full or, otherwise, after the handlers
+    /// that are ready to run in the io_context.
+    /// @param connection the connection that received the request.
+    /// @param router the request_router of the handler.
+    /// @param handler the batch handler.
+    /// @param request the received request.
+    /// @param parameters the route parameters.
+    /// @param body the received request body.
+    void batch_request(std::shared_ptr<http_connection_type> const& connection,
+                       request_router_type const& router,
+                       authenticated_handler_type const* handler,
+                       http::rx_request const& request,
+                       http::Parameters parameters,
+                       Container const& body)
+    {
+      bool flush_now(false);
+      bool post_flush(false);
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        request_batch& batch(request_batches_[handler]);
+        batch.router = &router;
+        batch.requests.push_back({ request, std::move(parameters), body });
+        batch.connections.push_back({ connection, connection.get(),
+                                      connection->rx().is_head() });
+
+        flush_now = batch.requests.size() >= handler->max_batch_size;
+        post_flush = !flush_now && !batch.flush_posted;
+        if (post_flush)
+          batch.flush_posted = true;
+      }
+
+      if (flush_now)
+        flush_batch(handler);
+      else if (post_flush)
+        ASIO::post(io_context_, [this, handler]{ flush_batch(handler); });
+    }
+
+    /// The priority class of a request: from the priority header, if
+    /// enabled and present, otherwise from its route.
+    /// @param routed the route of the request.
+    /// @param request the received request.
+    /// @return the priority class of the request.
+    unsigned char request_priority(routed_request_type const& routed,
+                                   http::rx_request const& request) const
+    {
+      if (!priority_header_.empty())
+      {
+        std::string_view value(request.headers().find(priority_header_));
+        if (!value.empty())
+        {
+          std::ptrdiff_t priority(http::from_dec_string(value));
+          if (priority >= 0)
+            return static_cast<unsigned char>
+              (std::min<size_t>(static_cast<size_t>(priority),
+                                request_scheduler_.classes() - 1u));
+        }
+      }
+
+      return routed.handler ? routed.handler->priority : 0u;
+    }
+
+    /// Queue a request for the request_scheduler.
+    /// A request from a connection that already has scheduled requests is
+    /// queued in the same priority class, so that its responses are sent in
+    /// order.
+    /// @param connection the connection that received the request.
+    /// @param router the request_router for the request.
+    /// @param routed the route of the request.
+    /// @param request the received request.
+    /// @param body the received request body.
+    /// @param is_spooled whether the request body was spooled.
+    void schedule_request(std::shared_ptr<http_connection_type> const& connection,
+                          request_router_type const& router,
+                          routed_request_type routed,
+                          http::rx_request const& request,
+                          Container const& body, bool is_spooled)
+    {
+      unsigned char priority(request_priority(routed, request));
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        auto& scheduled(scheduled_connections_[connection.get()]);
+        if (scheduled.second++ > 0u)
+          priority = scheduled.first;
+        else
+          scheduled.first = priority;
+      }
+
+      if (request_scheduler_.push(priority, scheduled_request{connection,
+                                  connection.get(), connection->rx().is_head(),
+                                  &router, std::move(routed), request, body,
+                                  is_spooled}) == 0u)
+        ASIO::post(io_context_, [this]{ dispatch_request(); });
+    }
+
+    /// Whether a connection has requests waiting for the request_scheduler.
+    /// @param connection the connection.
+    /// @return true if the connection has scheduled requests.
+    bool is_scheduled(http_connection_type const* connection)
+    {
+#ifdef HTTP_THREAD_SAFE
+      std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+      return scheduled_connections_.find(connection) !=
+             scheduled_connections_.end();
+    }
+
+    /// Handle the next request from the request_scheduler.
+    /// Only one request is handled in each call, so that the io_context can
+    /// receive requests between them.
+    void dispatch_request()
+    {
+      std::optional<scheduled_request> next(request_scheduler_.pop());
+      if (!next)
+        return;
+
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        auto iter(scheduled_connections_.find(next->pointer));
+        if ((iter != scheduled_connections_.end()) && (--iter->second.second == 0u))
+          scheduled_connections_.erase(iter);
+      }
+
+      std::shared_ptr<http_connection_type> connection(next->weak_ptr.lock());
+      if (connection)
+      {
+        Container response_body;
+        http::tx_response response
+            (http::response_status::code::PAYLOAD_TOO_LARGE);
+        if (!next->is_spooled)
+        {
+          http::handler_watchdog::scope scope(handler_watchdog_.get(),
+                                              next->request.uri(),
+                                              connection->remote_address());
+          response = next->router->handle_request(next->routed, next->request,
+                                                  next->body, response_body);
+        }
+        response.add_date_header();
+        response.add_server_header();
+        connection->send_deferred(next->request, next->is_head,
+                                  std::move(response), response_body);
+      }
+
+      if (request_scheduler_.size() > 0u)
+        ASIO::post(io_context_, [this]{ dispatch_request(); });
+    }
+
+    /// Route the request using the request_router for its host.
+    /// Requests with a spooled body are rejected with 413 Payload Too Large.
+    /// Canned responses are sent without calling the request_router.
+    /// Requests for batch handlers are added to their batch and other
+    /// requests are queued for the request_scheduler, if it's enabled.
+    /// All of the requests from a connection with scheduled requests are
+    /// queued for the request_scheduler, so that its responses are sent in
+    /// order.
     /// @param weak_ptr a weak pointer to the comms connection.
     /// @param request the received request.
     /// @param body the received request body.
@@ -233,9 +679,55 @@ namespace via
       std::shared_ptr<http_connection_type> connection(weak_ptr.lock());
       if (connection)
       {
+        request_router_type const& router(select_router(request));
+        routed_request_type routed(router.route(request));
+        authenticated_handler_type const* batch_handler
+          ((routed.handler && routed.handler->batch_handler &&
+            !request.is_chunked()) ? routed.handler : nullptr);
+        flush_connection_batches(connection.get(), batch_handler);
+
+        bool is_spooled(connection->spool_file().is_open());
+        if (request_scheduler_.enabled() && is_scheduled(connection.get()))
+        {
+          schedule_request(connection, router, std::move(routed), request,
+                           body, is_spooled);
+          return;
+        }
+
+        // The request_router's handlers can't receive a spooled body
+        if (is_spooled)
+        {
+          http::tx_response response
+              (http::response_status::code::PAYLOAD_TOO_LARGE);
+          response.add_date_header();
+          response.add_server_header();
+          connection->send(std::move(response));
+          return;
+        }
+
+        if (batch_handler)
+        {
+          batch_request(connection, router, batch_handler, request,
+                        std::move(routed.parameters), body);
+          return;
+        }
+
+        if (routed.canned)
+        {
+          connection->send(*routed.canned);
+          return;
+        }
+
+        if (request_scheduler_.enabled())
+        {
+          schedule_request(connection, router, std::move(routed), request,
+                           body, false);
+          return;
+        }
+
         Container response_body;
         http::tx_response response
-            (request_router_.handle_request(request, body, response_body));
+            (router.handle_request(routed, request, body, response_body));
         response.add_date_header();
         response.add_server_header();
         connection->send(std::move(response), std::move(response_body));
@@ -248,6 +740,8 @@ namespace via
     {
       // Get the receive buffer
       Container const& rx_buffer(http_connection->read_rx_buffer());
+      if (capture_)
+        capture_->write(connection_id(http_connection), rx_buffer);
       Container_const_iterator iter(rx_buffer.begin());
       Container_const_iterator end(rx_buffer.end());
 
@@ -262,12 +756,40 @@ namespace via
         switch (rx_state)
         {
         case http::RX_VALID:
+          VIA_PROBE3(request_parsed, http_connection->connection().lock().get(),
+                     http_connection->request().method().c_str(),
+                     http_connection->request().uri().c_str());
+          if (latency_stats_ &&
+              (http_connection->rx_timestamp() !=
+               std::chrono::system_clock::time_point()))
+            latency_stats_->add_kernel_to_handler
+                              (http_connection->rx_timestamp(),
+                               std::chrono::system_clock::now());
+
+          http_connection->response_due();
+
           // If it's NOT a TRACE request
           if (!http_connection->request().is_trace())
           {
-            http_request_handler_(http_connection,
-                                  http_connection->request(),
-                                  http_connection->body());
+            {
+              http::handler_watchdog::scope scope(handler_watchdog_.get(),
+                                            http_connection->request().uri(),
+                                            http_connection->remote_address());
+              VIA_PROBE2(handler_begin,
+                         http_connection->connection().lock().get(),
+                         http_connection->request().uri().c_str());
+#ifdef VIA_HTTPLIB_PROBES
+              // A handler that responds to the request clears it
+              std::string probe_uri(VIA_PROBE_ENABLED(handler_end)
+                  ? http_connection->request().uri() : std::string());
+#endif
+              http_request_handler_(http_connection,
+                                    http_connection->request(),
+                                    http_connection->body());
+              VIA_PROBE2(handler_end,
+                         http_connection->connection().lock().get(),
+                         probe_uri.c_str());
+            }
             if (!http_connection->request().is_chunked())
               http_connection->rx().clear();
             break;
@@ -304,6 +826,8 @@ namespace via
             http_continue_handler_(http_connection,
                                    http_connection->request(),
                                    http_connection->body());
+          else if (routing_requests_)
+            continue_routed_request(http_connection);
           else
             http_connection->send_response();
           break;
@@ -323,12 +847,39 @@ namespace via
       } // end while
     }
 
+    /// Route requests with the request_router if a request handler has not
+    /// been registered.
+    void use_request_router()
+    {
+      if (!http_request_handler_)
+      {
+        http_request_handler_ =
+            [this](std::weak_ptr<http_connection_type> weak_ptr,
+                   http::rx_request const& request, Container const& body)
+        { route_request(weak_ptr, request, body); };
+        routing_requests_ = true;
+      }
+    }
+
+    /// The connection id of an http_connection in a traffic capture.
+    /// @param http_connection a shared pointer to an http_connection.
+    static std::uint64_t connection_id
+                    (std::shared_ptr<http_connection_type> const& http_connection)
+    {
+      return reinterpret_cast<std::uintptr_t>
+                           (http_connection->connection().lock().get());
+    }
+
     /// Handle a disconnected signal from an underlying comms connection.
     /// Noitfy the handler and erase the connection from the collection.
     /// @param iter a valid iterator into the connection collection.
     void disconnected_handler(void* pointer,
                         std::shared_ptr<http_connection_type> http_connection)
     {
+      if (capture_)
+        capture_->write(reinterpret_cast<std::uintptr_t>(pointer),
+                        comms::DISCONNECTED);
+
       // Noitfy the disconnected handler if one exists
       if (disconnected_handler_)
         disconnected_handler_(http_connection);
@@ -343,6 +894,30 @@ namespace via
       // If the http_server is being shutdown and this was the last connection
       if (shutting_down_ && http_connections_.empty())
         server_->close();
+
+      // If the http_server is being drained and this was the last connection
+      if (draining_ && http_connections_.empty())
+        drained();
+    }
+
+    /// Finish draining the server: cancel the deadline and call the
+    /// drained handler, once.
+    void drained()
+    {
+      DrainedHandler handler;
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        if (!draining_)
+          return;
+        draining_ = false;
+        handler.swap(drained_handler_);
+      }
+
+      drain_timer_.cancel();
+      if (handler)
+        handler();
     }
 
     /// Receive an event from the underlying comms connection.
@@ -423,10 +998,28 @@ namespace via
     /// @param io_context a reference to the ASIO::io_context.
     /// @param auth_ptr a shared pointer to an authentication.
     explicit http_server(ASIO::io_context& io_context) :
+      io_context_(io_context),
       server_(new server_type(io_context)),
       http_connections_(),
       request_router_(),
+      host_routers_(),
+      rate_limiter_(),
+      access_log_(),
+      capture_(),
+      loop_monitor_(),
+      handler_watchdog_(),
+      latency_stats_(),
       shutting_down_(false),
+      draining_(false),
+      drain_timer_(io_context),
+      drained_handler_(),
+      request_batches_(),
+      request_scheduler_(),
+      priority_header_(),
+      scheduled_connections_(),
+#ifdef HTTP_THREAD_SAFE
+      routing_mutex_(),
+#endif
 
       // Set request parser parameters to default values
       strict_crlf_        (false),
@@ -438,14 +1031,18 @@ namespace via
       max_header_length_  (http_request::DEFAULT_MAX_HEADER_LENGTH),
       max_body_size_      (http_request::DEFAULT_MAX_BODY_SIZE),
       max_chunk_size_     (http_request::DEFAULT_MAX_CHUNK_SIZE),
+      spool_threshold_    (0u),
+      retained_headers_   (),
 
       require_host_header_(true),
       translate_head_     (true),
       trace_enabled_      (false),
       auto_disconnect_    (false),
+      routing_requests_   (false),
 
       http_request_handler_ (),
       http_chunk_handler_   (),
+      http_body_handler_    (),
       http_continue_handler_(),
       http_invalid_handler_ (),
       connected_handler_    (),
@@ -481,20 +1078,50 @@ namespace via
                       (unsigned short port = SocketAdaptor::DEFAULT_HTTP_PORT,
                        bool ipv4_only = false)
     {
-      // If a request handler's not been registered, use the request_router
-      if (!http_request_handler_)
-        http_request_handler_ =
-            [this](std::weak_ptr<http_connection_type> weak_ptr,
-                   http::rx_request const& request, Container const& body)
-        { route_request(weak_ptr, request, body); };
-
+      use_request_router();
       return server_->accept_connections(port, ipv4_only);
     }
 
+    /// Start accepting connections on a socket that is already listening,
+    /// e.g. one created by a comms::prefork_master before it forked the
+    /// worker processes.
+    /// @param listener the native handle of the listening socket, the
+    /// server takes ownership of it.
+    /// @return the boost error code, false if no error occured
+    ASIO_ERROR_CODE accept_listener
+                      (ASIO::ip::tcp::acceptor::native_handle_type listener)
+    {
+      use_request_router();
+      return server_->accept_listener(listener);
+    }
+
+    /// The native handles of the server's listening sockets, e.g. to pass
+    /// them to a new process in a hot restart.
+    /// @return the listening sockets, empty if the server is not accepting
+    /// connections.
+    std::vector<ASIO::ip::tcp::acceptor::native_handle_type> listeners()
+    { return server_->listeners(); }
+
     /// Accessor for the request_router_
     request_router_type& request_router()
     { return request_router_; }
 
+    /// Accessor for the request_router of a virtual host, it is created if
+    /// necessary.
+    /// Requests for hosts without a request_router are routed by the
+    /// request_router_.
+    /// @pre the virtual hosts must be added before accepting connections.
+    /// @param host the host name, e.g. "api.example.com" or a wildcard
+    /// for subdomains: "*.example.com".
+    /// @return the request_router for the host.
+    request_router_type& request_router(std::string_view host)
+    { return host_routers_[host]; }
+
+    /// Accessor for the rate_limiter_
+    /// @pre the rate limit must be set before accepting connections.
+    rate_limiter_type& rate_limiter()
+    { return rate_limiter_; }
+
     ////////////////////////////////////////////////////////////////////////
     // Event Handlers
 
@@ -514,6 +1141,18 @@ namespace via
     void chunk_received_event(ChunkHandler handler) noexcept
     { http_chunk_handler_ = handler; }
 
+    /// Connect the body received callback function, to receive the data of
+    /// request bodies with a Content-Length as it arrives, e.g. to parse a
+    /// multipart/form-data upload without holding it in memory.
+    /// The handler is called with the first data of each body and returns
+    /// true to take the body: it's then called with the rest of the body and
+    /// the request is received with an empty body. Otherwise the body is
+    /// received as usual.
+    /// @pre to be called before accepting connections.
+    /// @param handler the handler for received HTTP body data.
+    void body_received_event(BodyHandler handler) noexcept
+    { http_body_handler_ = handler; }
+
     /// Connect the expect continue received callback function.
     ///
     /// If the application registers a handler for this event, then the
@@ -521,6 +1160,11 @@ namespace via
     /// Expect: 100-continue header based upon it's other headers.
     /// Otherwise, the server will automatically send a 100 Continue response,
     /// so that the client can continue to send the body of the request.
+    /// If the request_router handles requests, the request must have a
+    /// route, a method handler and be authenticated for a 100 Continue
+    /// response, otherwise the error response is sent without receiving the
+    /// body. A request body larger than max_body_size is always rejected
+    /// with 413 Payload Too Large.
     /// @post disables automatic sending of a 100 Continue response
     /// @param handler the handler for an "expects continue" request.
     void request_expect_continue_event(RequestHandler handler) noexcept
@@ -553,6 +1197,7 @@ namespace via
 
     ////////////////////////////////////////////////////////////////////////
     // HTTP Request Parser Parameter set functions
+    // Note: they have no effect if Limits provides compile time limits.
 
     /// Set whether to require strict CRLF HTTP request checking.
     /// @param enable strict CRLF HTTP checking
@@ -607,6 +1252,59 @@ namespace via
         http_request::DEFAULT_MAX_CHUNK_SIZE) noexcept
     { max_chunk_size_ = max_size; }
 
+    /// Set the maximum HTTP request body size to hold in memory.
+    /// Larger request bodies are written to an anonymous temporary file,
+    /// so memory use is bounded by the number of connections and the
+    /// threshold instead of the maximum body size.
+    /// A spooled body is NOT passed to handlers in the body parameter, it
+    /// is available from http_connection::spool_file, but only until the
+    /// handler returns or a response is sent on the connection.
+    /// The request_router can't pass a spooled body to its handlers, so
+    /// it rejects those requests with 413 Payload Too Large.
+    /// @param threshold the maximum body size to hold in memory,
+    /// default zero: always hold request bodies in memory.
+    void set_spool_threshold(size_t threshold = 0u) noexcept
+    { spool_threshold_ = threshold; }
+
+    /// Schedule the request handlers by weighted fair queuing of priority
+    /// classes, instead of calling them as requests are received.
+    /// A request's priority class is set by its route, see
+    /// request_router::add_method, or by a request header.
+    /// Note: the priority header must be retained, see set_retained_headers.
+    /// @param weights the relative weight of each priority class, min 1.
+    /// An empty vector (the default) disables scheduling.
+    /// @param header_name the name of a header containing the priority class
+    /// of a request, as a decimal number. Requests without it use the
+    /// priority class of their route. Default none.
+    void set_priority_classes(std::vector<unsigned int> const& weights
+                                = std::vector<unsigned int>(),
+                              std::string_view header_name = std::string_view())
+    {
+      request_scheduler_.set_weights(weights);
+      priority_header_.clear();
+      std::transform(header_name.cbegin(), header_name.cend(),
+                     std::back_inserter(priority_header_), http::to_lower);
+    }
+
+    /// The statistics of the request priority classes.
+    /// @return the queue depths and waiting times of each priority class.
+    std::vector<priority_class_stats> priority_stats()
+    { return request_scheduler_.stats(); }
+
+    /// Only retain the request header fields that the application uses.
+    /// Other header fields are parsed and count towards max_header_length,
+    /// but they are not stored, reducing the memory and allocations per
+    /// request. The header fields that the library uses are always retained,
+    /// see http::retained_headers.
+    /// Note: the rate_limiter key header must be included, if used.
+    /// @param names the names of the header fields, in any case.
+    /// An empty set (the default) retains all header fields.
+    void set_retained_headers(http::HeaderNames names = http::HeaderNames())
+    {
+      retained_headers_ = names.empty() ? nullptr
+                        : http::retained_headers(std::move(names));
+    }
+
     ////////////////////////////////////////////////////////////////////////
     // HTTP server options set functions
 
@@ -635,6 +1333,95 @@ namespace via
     void set_auto_disconnect(bool enable = false) noexcept
     { auto_disconnect_ = enable; }
 
+    /// Set the access log for the responses sent by the server.
+    /// The log is only applied to connections accepted after this call.
+    /// @param access_log the access log, default nullptr: no access log.
+    void set_access_log(std::shared_ptr<http::access_log> access_log =
+                          std::shared_ptr<http::access_log>()) noexcept
+    { access_log_ = access_log; }
+
+    /// Set the watchdog that reports request handlers that run for longer
+    /// than its budget, with the stack of the thread running the handler.
+    /// @param watchdog the handler watchdog, default nullptr: no watchdog.
+    void set_handler_watchdog(std::shared_ptr<http::handler_watchdog> watchdog
+                                = std::shared_ptr<http::handler_watchdog>())
+      noexcept
+    { handler_watchdog_ = watchdog; }
+
+    /// Set the traffic capture for the data received by the server.
+    /// Every buffer received by the server is written to the capture with
+    /// the time and the id of its connection, so that the traffic can be
+    /// replayed later, see examples/client/replay_http_client.cpp.
+    /// @param capture the traffic capture, default nullptr: no capture.
+    void set_capture(std::shared_ptr<comms::capture_writer> capture =
+                       std::shared_ptr<comms::capture_writer>()) noexcept
+    { capture_ = capture; }
+
+    /// Measure the lag of the server's io_context: how late the work posted
+    /// to it runs. A lag shows that the io_context threads are saturated or
+    /// that a handler is blocking them.
+    /// Note: io_context::run won't return while the loop_monitor is running.
+    /// @param period the time between measurements, zero to stop.
+    /// @param threshold the lag above which the lag handler is called.
+    /// @param lag_handler the function to call with a lag above the
+    /// threshold, optional.
+    void set_loop_monitor(std::chrono::milliseconds period,
+                          std::chrono::microseconds threshold =
+                            std::chrono::microseconds::max(),
+                          comms::loop_monitor::LagHandler lag_handler =
+                            comms::loop_monitor::LagHandler())
+    {
+      if (loop_monitor_)
+        loop_monitor_->stop();
+
+      if (period > std::chrono::milliseconds::zero())
+      {
+        loop_monitor_ = comms::loop_monitor::create(io_context_);
+        loop_monitor_->start(period, threshold, lag_handler);
+      }
+      else
+        loop_monitor_.reset();
+    }
+
+    /// Accessor for the loop_monitor, e.g. to read its lag histogram.
+    /// @return a shared pointer to the loop_monitor, nullptr if it's not
+    /// running.
+    comms::loop_monitor::shared_pointer loop_monitor() const noexcept
+    { return loop_monitor_; }
+
+    /// Measure the latencies of requests and responses from kernel socket
+    /// timestamps: from the kernel receiving a request to its handler being
+    /// called, including the time that it waited in the socket buffer for
+    /// an io_context thread, and from a response being written to it being
+    /// sent and acknowledged by the client.
+    /// Note: only supported by tcp_adaptor on Linux. The timestamps are only
+    /// enabled on connections accepted after this call.
+    /// @param enable enable the function, default true.
+    /// @return true if timestamping is supported, false otherwise.
+    bool set_timestamping(bool enable = true)
+    {
+      bool supported(false);
+#ifdef VIA_SO_TIMESTAMPING
+      supported = comms::supports_timestamping<SocketAdaptor>::value;
+#endif
+      if (enable && supported)
+      {
+        if (!latency_stats_)
+          latency_stats_ = std::make_shared<comms::latency_stats>();
+      }
+      else
+        latency_stats_.reset();
+      return supported;
+    }
+
+    /// The latency histograms measured from kernel socket timestamps.
+    /// @return the histograms, empty if timestamping is not enabled.
+    comms::latency_histograms latency_histograms()
+    {
+      return latency_stats_ ? latency_stats_->histograms()
+                            : comms::latency_histograms();
+    }
+
     /// Set the size of the server receive buffer.
     /// @param size the new size of the receive buffer, default
     /// SocketAdaptor::DEFAULT_RX_BUFFER_SIZE
@@ -657,6 +1444,26 @@ namespace via
     ////////////////////////////////////////////////////////////////////////
     // HTTPS set functions
 
+#ifdef HTTP_SSL
+    /// Add an SSL context for a virtual host.
+    /// The context is selected by the server name that the client sends
+    /// in the TLS handshake (SNI). Clients that don't send a server name,
+    /// or send an unknown one, use the default ssl_context.
+    /// @pre http_server derived from via::comms::ssl::ssl_tcp_adaptor.
+    /// @pre the contexts must be added before accepting connections.
+    /// @param host the host name, e.g. "api.example.com" or a wildcard
+    /// for subdomains: "*.example.com".
+    /// @param context the SSL context with the certificates for the host.
+    static void add_ssl_host_context(std::string_view host,
+                                     std::shared_ptr<ASIO::ssl::context> context)
+    {
+      ssl_host_contexts()[host] = context;
+      SSL_CTX_set_tlsext_servername_callback
+        (server_type::connection_type::ssl_context().native_handle(),
+         server_name_callback);
+    }
+#endif
+
     /// Set the password for an SSL connection.
     /// @pre http_server derived from via::comms::ssl::ssl_tcp_adaptor.
     /// @param password the SSL password
@@ -779,9 +1586,65 @@ namespace via
         close();
     }
 
+    /// Drain the http server, e.g. after its listening sockets have been
+    /// passed to a new process: stop accepting connections, disconnect the
+    /// idle connections and close the others after their in-flight requests
+    /// have been responded to. The responses are sent with a
+    /// Connection: close header.
+    /// The server is closed if there are connections left at the deadline.
+    /// @param timeout the time allowed to finish the in-flight requests.
+    /// @param handler the function to call when the server has drained,
+    /// e.g. to stop the io_context so that the process can exit.
+    void drain(std::chrono::milliseconds timeout, DrainedHandler handler)
+    {
+      {
+#ifdef HTTP_THREAD_SAFE
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+#endif
+        draining_ = true;
+        drained_handler_ = handler;
+      }
+      server_->stop_accepting();
+
+#ifdef HTTP_THREAD_SAFE
+      auto connection_data(http_connections_.data());
+#else
+      connection_collection connection_data(http_connections_);
+#endif
+      for (auto& elem : connection_data)
+      {
+        elem.second->set_close_after_response();
+        if (elem.second->is_idle())
+          elem.second->disconnect();
+      }
+
+      if (http_connections_.empty())
+      {
+        ASIO::post(io_context_, [this]{ drained(); });
+        return;
+      }
+
+#ifdef ASIO_STANDALONE
+      drain_timer_.expires_from_now(timeout);
+#else
+      drain_timer_.expires_from_now
+          (boost::posix_time::milliseconds(timeout.count()));
+#endif
+      drain_timer_.async_wait([this](ASIO_ERROR_CODE const& error)
+      {
+        if (!error && draining_)
+        {
+          close();
+          drained();
+        }
+      });
+    }
+
     /// Close the http server and all of the connections associated with it.
     void close()
     {
+      if (loop_monitor_)
+        loop_monitor_->stop();
       http_connections_.clear();
       server_->close();
     }
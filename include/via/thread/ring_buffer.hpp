@@ -0,0 +1,126 @@
+#ifndef VIA_RING_BUFFER_HPP_
+#define VIA_RING_BUFFER_HPP_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Ken Barker
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file ring_buffer.hpp
+/// @brief A lock-free single producer, single consumer ring buffer.
+//////////////////////////////////////////////////////////////////////////////
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+namespace via
+{
+  namespace thread
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class ring_buffer
+    ///
+    /// A fixed size, lock-free ring buffer for one producer thread and one
+    /// consumer thread.
+    /// push never blocks: it fails if the ring buffer is full.
+    ///
+    /// @tparam T the type of the elements, it should be trivially copyable.
+    /// @tparam cache_line_size the size of a cache line on the hardware.
+    /// Default 64 bytes.
+    //////////////////////////////////////////////////////////////////////////
+    template<typename T, unsigned cache_line_size = 64u>
+    class ring_buffer
+    {
+      /// The elements, the size is a power of two.
+      std::vector<T> data_;
+
+      /// The mask to convert a count into an index into data_.
+      size_t mask_;
+
+      /// The count of elements popped, written by the consumer.
+      alignas(cache_line_size) std::atomic<size_t> head_;
+
+      /// The count of elements pushed, written by the producer.
+      alignas(cache_line_size) std::atomic<size_t> tail_;
+
+      /// Round up to a power of two.
+      static size_t power_of_two(size_t size) noexcept
+      {
+        size_t value(1u);
+        while (value < size)
+          value <<= 1;
+        return value;
+      }
+
+    public:
+
+      /// Constructor
+      /// @param size the minimum number of elements, it is rounded up to
+      /// a power of two.
+      explicit ring_buffer(size_t size)
+        : data_(power_of_two(size))
+        , mask_(data_.size() - 1u)
+        , head_(0u)
+        , tail_(0u)
+      {}
+
+      /// Disable copy construction.
+      ring_buffer(ring_buffer const& other) = delete;
+
+      /// Disable assignment.
+      ring_buffer& operator=(ring_buffer const& other) = delete;
+
+      /// The maximum number of elements in the ring buffer.
+      size_t capacity() const noexcept
+      { return data_.size(); }
+
+      /// The number of elements in the ring buffer.
+      size_t size() const noexcept
+      {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+      }
+
+      /// Whether the ring buffer is empty.
+      bool empty() const noexcept
+      { return size() == 0u; }
+
+      /// Push an element onto the ring buffer.
+      /// @pre called by the producer thread.
+      /// @param value the element to push.
+      /// @return true if pushed, false if the ring buffer was full.
+      bool push(T const& value) noexcept
+      {
+        size_t tail(tail_.load(std::memory_order_relaxed));
+        if (tail - head_.load(std::memory_order_acquire) >= data_.size())
+          return false;
+
+        data_[tail & mask_] = value;
+        tail_.store(tail + 1u, std::memory_order_release);
+        return true;
+      }
+
+      /// Pop an element from the ring buffer.
+      /// @pre called by the consumer thread.
+      /// @retval value the popped element.
+      /// @return true if popped, false if the ring buffer was empty.
+      bool pop(T& value) noexcept
+      {
+        size_t head(head_.load(std::memory_order_relaxed));
+        if (head == tail_.load(std::memory_order_acquire))
+          return false;
+
+        value = data_[head & mask_];
+        head_.store(head + 1u, std::memory_order_release);
+        return true;
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,175 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "allocation_counter.hpp"
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+  /// The number of allocation_counters on this thread.
+  thread_local size_t active_counters(0u);
+
+  /// The allocations made on this thread while counting.
+  thread_local size_t allocation_count(0u);
+
+  /// The bytes allocated on this thread while counting.
+  thread_local size_t allocation_bytes(0u);
+
+  /// Allocate memory, counting the allocation if required.
+  void* allocate(std::size_t size)
+  {
+    if (active_counters > 0u)
+    {
+      ++allocation_count;
+      allocation_bytes += size;
+    }
+
+    return std::malloc(size == 0u ? 1u : size);
+  }
+
+  /// Allocate over-aligned memory, counting the allocation if required.
+  void* allocate(std::size_t size, std::align_val_t alignment)
+  {
+    if (active_counters > 0u)
+    {
+      ++allocation_count;
+      allocation_bytes += size;
+    }
+
+    std::size_t align(static_cast<std::size_t>(alignment));
+#ifdef _WIN32
+    // MSVC doesn't provide aligned_alloc
+    return _aligned_malloc(size == 0u ? 1u : size, align);
+#else
+    // aligned_alloc requires the size to be a multiple of the alignment
+    std::size_t aligned_size(((size == 0u ? 1u : size) + align - 1u)
+                             & ~(align - 1u));
+    return std::aligned_alloc(align, aligned_size);
+#endif
+  }
+
+  /// Free memory allocated with an alignment.
+  void deallocate_aligned(void* ptr) noexcept
+  {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+  }
+}
+
+namespace via
+{
+  namespace test
+  {
+    allocation_counter::allocation_counter() noexcept :
+      allocations_(allocation_count),
+      bytes_(allocation_bytes)
+    { ++active_counters; }
+
+    allocation_counter::~allocation_counter()
+    { --active_counters; }
+
+    size_t allocation_counter::allocations() const noexcept
+    { return allocation_count - allocations_; }
+
+    size_t allocation_counter::bytes() const noexcept
+    { return allocation_bytes - bytes_; }
+
+    void allocation_counter::reset() noexcept
+    {
+      allocations_ = allocation_count;
+      bytes_ = allocation_bytes;
+    }
+  }
+}
+
+void* operator new(std::size_t size)
+{
+  if (void* ptr = allocate(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  if (void* ptr = allocate(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{ return allocate(size); }
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{ return allocate(size); }
+
+void operator delete(void* ptr) noexcept
+{ std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept
+{ std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept
+{ std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{ std::free(ptr); }
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{ std::free(ptr); }
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{ std::free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  if (void* ptr = allocate(size, alignment))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  if (void* ptr = allocate(size, alignment))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment,
+                   std::nothrow_t const&) noexcept
+{ return allocate(size, alignment); }
+
+void* operator new[](std::size_t size, std::align_val_t alignment,
+                     std::nothrow_t const&) noexcept
+{ return allocate(size, alignment); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{ deallocate_aligned(ptr); }
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{ deallocate_aligned(ptr); }
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{ deallocate_aligned(ptr); }
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{ deallocate_aligned(ptr); }
+
+void operator delete(void* ptr, std::align_val_t,
+                     std::nothrow_t const&) noexcept
+{ deallocate_aligned(ptr); }
+
+void operator delete[](void* ptr, std::align_val_t,
+                       std::nothrow_t const&) noexcept
+{ deallocate_aligned(ptr); }
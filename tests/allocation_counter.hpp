@@ -0,0 +1,69 @@
+#ifndef ALLOCATION_COUNTER_HPP_VIA_HTTPLIB_
+#define ALLOCATION_COUNTER_HPP_VIA_HTTPLIB_
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+/// @file allocation_counter.hpp
+/// @brief Counts the heap allocations made by the calling thread.
+///
+/// allocation_counter.cpp replaces the global operator new and delete
+/// functions. Only link it into test and benchmark executables.
+//////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+
+namespace via
+{
+  namespace test
+  {
+    //////////////////////////////////////////////////////////////////////////
+    /// @class allocation_counter
+    /// Counts the number of heap allocations, and the number of bytes
+    /// allocated, by the calling thread while an allocation_counter exists.
+    ///
+    /// E.g.:
+    /// @code
+    ///   allocation_counter counter;
+    ///   the_chunk.parse(next, chunk_data.end());
+    ///   BOOST_CHECK_EQUAL(0u, counter.allocations());
+    /// @endcode
+    //////////////////////////////////////////////////////////////////////////
+    class allocation_counter
+    {
+      size_t allocations_; ///< the allocation count when constructed.
+      size_t bytes_;       ///< the bytes allocated when constructed.
+
+    public:
+
+      /// Constructor, starts counting allocations on this thread.
+      allocation_counter() noexcept;
+
+      /// Destructor, stops counting unless another counter exists.
+      ~allocation_counter();
+
+      /// Disable copy construction.
+      allocation_counter(allocation_counter const&) = delete;
+
+      /// Disable assignment.
+      allocation_counter& operator=(allocation_counter const&) = delete;
+
+      /// The number of allocations since construction or reset.
+      size_t allocations() const noexcept;
+
+      /// The number of bytes allocated since construction or reset.
+      size_t bytes() const noexcept;
+
+      /// Restart the counts from zero.
+      void reset() noexcept;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/capture.hpp"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using namespace via::comms;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestCapture)
+
+BOOST_AUTO_TEST_CASE(WriteRead1)
+{
+  const std::string filename("test_capture.bin");
+  const std::string data1("GET / HTTP/1.1\r\nHo");
+  const std::vector<char> data2{'s', 't', ':', ' ', 'a', '\r', '\n', '\r', '\n'};
+  {
+    capture_writer writer(filename);
+    BOOST_CHECK(writer.is_open());
+    writer.write(1u, CONNECTED);
+    writer.write(1u, data1);
+    writer.write(1u, data2);
+    writer.write(2u, CONNECTED);
+    writer.write(1u, DISCONNECTED);
+  }
+
+  capture_reader reader(filename);
+  BOOST_CHECK(reader.is_open());
+
+  capture_record record;
+  BOOST_CHECK(reader.read(record));
+  BOOST_CHECK_EQUAL(1u, record.connection);
+  BOOST_CHECK_EQUAL(CONNECTED, record.event);
+  BOOST_CHECK(record.data.empty());
+  auto last_timestamp(record.timestamp);
+
+  BOOST_CHECK(reader.read(record));
+  BOOST_CHECK_EQUAL(1u, record.connection);
+  BOOST_CHECK_EQUAL(RECEIVED, record.event);
+  BOOST_CHECK_EQUAL(data1, record.data);
+  BOOST_CHECK(last_timestamp <= record.timestamp);
+
+  BOOST_CHECK(reader.read(record));
+  BOOST_CHECK_EQUAL(RECEIVED, record.event);
+  BOOST_CHECK_EQUAL("st: a\r\n\r\n", record.data);
+
+  BOOST_CHECK(reader.read(record));
+  BOOST_CHECK_EQUAL(2u, record.connection);
+  BOOST_CHECK_EQUAL(CONNECTED, record.event);
+
+  BOOST_CHECK(reader.read(record));
+  BOOST_CHECK_EQUAL(1u, record.connection);
+  BOOST_CHECK_EQUAL(DISCONNECTED, record.event);
+
+  BOOST_CHECK(!reader.read(record));
+  std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(InvalidFile1)
+{
+  const std::string filename("test_capture.txt");
+  {
+    std::FILE* file(std::fopen(filename.c_str(), "wb"));
+    std::fputs("not a capture file", file);
+    std::fclose(file);
+  }
+
+  capture_reader reader(filename);
+  BOOST_CHECK(!reader.is_open());
+  std::remove(filename.c_str());
+
+  capture_reader missing_reader("missing_capture.bin");
+  BOOST_CHECK(!missing_reader.is_open());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
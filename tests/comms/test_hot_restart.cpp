@@ -0,0 +1,185 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/hot_restart.hpp"
+#include "via/comms/tcp_adaptor.hpp"
+#include "via/http_server.hpp"
+#include "via/http_client.hpp"
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+using namespace via;
+
+namespace
+{
+  typedef http_server<comms::tcp_adaptor, std::string> http_server_type;
+  typedef http_client<comms::tcp_adaptor, std::string> http_client_type;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestHotRestart)
+
+BOOST_AUTO_TEST_CASE(Drain1)
+{
+  ASIO::io_context io_context;
+  http_server_type http_server(io_context);
+
+  // The request is in flight when the server is drained
+  bool drained(false);
+  http_server.request_received_event([&]
+    (std::weak_ptr<http_server_type::http_connection_type> weak_ptr,
+     http::rx_request const& request, std::string const&)
+  {
+    http_server.drain(std::chrono::milliseconds(2000), [&]{ drained = true; });
+    BOOST_CHECK(http_server.listeners().empty());
+
+    ASIO::post(io_context, [weak_ptr, request]
+    {
+      weak_ptr.lock()->send_deferred(request, false,
+        http::tx_response(http::response_status::code::OK), "Bye");
+    });
+  });
+  BOOST_REQUIRE(!http_server.accept_connections(8091, true));
+  BOOST_CHECK_EQUAL(1u, http_server.listeners().size());
+
+  std::string response_body;
+  bool keep_alive(true);
+  http_client_type::shared_pointer busy_client(http_client_type::create
+    (io_context, [&](http::rx_response const& response, std::string const& body)
+  {
+    response_body = body;
+    keep_alive = response.keep_alive();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){}));
+  busy_client->connected_event([&]
+  { busy_client->send(http::tx_request(http::request_method::id::GET, "/")); });
+
+  // The idle connection is disconnected when the server is drained
+  bool idle_disconnected(false);
+  http_client_type::shared_pointer idle_client(http_client_type::create
+    (io_context, [](http::rx_response const&, std::string const&){},
+     [](http_client_type::chunk_type const&, std::string const&){}));
+  idle_client->connected_event([&]
+  { BOOST_CHECK(busy_client->connect("127.0.0.1", "8091")); });
+  idle_client->disconnected_event([&]{ idle_disconnected = true; });
+  BOOST_CHECK(idle_client->connect("127.0.0.1", "8091"));
+  io_context.run();
+
+  BOOST_CHECK(drained);
+  BOOST_CHECK(idle_disconnected);
+  BOOST_CHECK_EQUAL("Bye", response_body);
+  BOOST_CHECK(!keep_alive);
+}
+
+BOOST_AUTO_TEST_CASE(DrainChunked1)
+{
+  const int CHUNKS(5);
+  ASIO::io_context io_context;
+  http_server_type http_server(io_context);
+
+  // The chunks are queued behind the response header when it's drained
+  bool drained(false);
+  http_server.request_received_event([&]
+    (std::weak_ptr<http_server_type::http_connection_type> weak_ptr,
+     http::rx_request const&, std::string const&)
+  {
+    http_server.drain(std::chrono::milliseconds(2000), [&]{ drained = true; });
+
+    auto connection(weak_ptr.lock());
+    http::tx_response response(http::response_status::code::OK);
+    response.add_header(http::header_field::id::TRANSFER_ENCODING, "Chunked");
+    connection->send(std::move(response));
+    for (int i(0); i < CHUNKS; ++i)
+      connection->send_chunk(std::string("chunk") + static_cast<char>('0' + i));
+    connection->last_chunk();
+  });
+  BOOST_REQUIRE(!http_server.accept_connections(8096, true));
+
+  std::string response_body;
+  bool last_chunk(false);
+  http_client_type::shared_pointer client(http_client_type::create
+    (io_context, [](http::rx_response const&, std::string const&){},
+     [&](http_client_type::chunk_type const& chunk, std::string const& data)
+  {
+    if (chunk.is_last())
+      last_chunk = true;
+    else
+      response_body += data;
+  }));
+  client->connected_event([&]
+  { client->send(http::tx_request(http::request_method::id::GET, "/")); });
+  BOOST_CHECK(client->connect("127.0.0.1", "8096"));
+  io_context.run();
+
+  BOOST_CHECK(drained);
+  BOOST_CHECK(last_chunk);
+  BOOST_CHECK_EQUAL("chunk0chunk1chunk2chunk3chunk4", response_body);
+}
+
+#ifdef VIA_HOT_RESTART
+BOOST_AUTO_TEST_CASE(HandOff1)
+{
+  std::string path("/tmp/via_hot_restart_" + std::to_string(::getpid()));
+
+  // There's no running process to take over from
+  ASIO::io_context new_io_context;
+  comms::hot_restart new_process(new_io_context, path);
+  BOOST_CHECK(!new_process.take_over(std::chrono::milliseconds(100)));
+
+  // The running process offers its listening socket
+  ASIO::io_context old_io_context;
+  http_server_type old_server(old_io_context);
+  BOOST_REQUIRE(!old_server.accept_connections(8092, true));
+  bool drained(false);
+  comms::hot_restart old_process(old_io_context, path);
+  BOOST_REQUIRE(!old_process.offer(old_server.listeners(),
+    []{ return std::string("ticket keys"); },
+    [&]{ old_server.drain(std::chrono::milliseconds(1000),
+                          [&]{ drained = true; }); }));
+  std::thread old_thread([&old_io_context]{ old_io_context.run(); });
+
+  // The new process takes it over and the running process drains
+  BOOST_REQUIRE(new_process.take_over());
+  BOOST_CHECK_EQUAL("ticket keys", new_process.state());
+  BOOST_REQUIRE_EQUAL(1u, new_process.listeners().size());
+
+  http_server_type new_server(new_io_context);
+  new_server.request_router().add_method(http::request_method::id::GET,
+                                         "/hello",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "Hello";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!new_server.accept_listener(new_process.listeners().front()));
+  BOOST_CHECK(new_process.confirm());
+  old_thread.join();
+  BOOST_CHECK(drained);
+
+  // The new process accepts connections on the socket
+  std::string response_body;
+  http_client_type::shared_pointer client(http_client_type::create
+    (new_io_context, [&](http::rx_response const&, std::string const& body)
+  {
+    response_body = body;
+    new_server.close();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){}));
+  client->connected_event([&]
+  { client->send(http::tx_request(http::request_method::id::GET, "/hello")); });
+  BOOST_CHECK(client->connect("127.0.0.1", "8092"));
+  new_io_context.run();
+
+  BOOST_CHECK_EQUAL("Hello", response_body);
+  ::unlink(path.c_str());
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
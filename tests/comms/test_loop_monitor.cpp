@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/loop_monitor.hpp"
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+using namespace via::comms;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestLagHistogram)
+
+BOOST_AUTO_TEST_CASE(Buckets1)
+{
+  BOOST_CHECK_EQUAL(0u, lag_histogram::bucket(microseconds(0)));
+  BOOST_CHECK_EQUAL(1u, lag_histogram::bucket(microseconds(1)));
+  BOOST_CHECK_EQUAL(2u, lag_histogram::bucket(microseconds(3)));
+  BOOST_CHECK_EQUAL(11u, lag_histogram::bucket(microseconds(1024)));
+  BOOST_CHECK_EQUAL(lag_histogram::BUCKETS - 1u,
+                    lag_histogram::bucket(microseconds::max()));
+}
+
+BOOST_AUTO_TEST_CASE(Percentiles1)
+{
+  lag_histogram histogram;
+  BOOST_CHECK_EQUAL(0, histogram.mean().count());
+
+  for (int i(0); i < 98; ++i)
+    histogram.add(microseconds(10));
+  histogram.add(microseconds(1000));
+  histogram.add(microseconds(5000));
+
+  BOOST_CHECK_EQUAL(100u, histogram.samples());
+  BOOST_CHECK_EQUAL(5000, histogram.max().count());
+  BOOST_CHECK_EQUAL(69, histogram.mean().count());
+  BOOST_CHECK_EQUAL(16, histogram.percentile(50.0).count());
+  BOOST_CHECK_EQUAL(1024, histogram.percentile(99.0).count());
+  BOOST_CHECK_EQUAL(5000, histogram.percentile(100.0).count());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestLoopMonitor)
+
+BOOST_AUTO_TEST_CASE(BlockedLoop1)
+{
+  ASIO::io_context io_context;
+  loop_monitor::shared_pointer monitor(loop_monitor::create(io_context));
+
+  microseconds lag(0);
+  monitor->start(milliseconds(1), microseconds(10000),
+                 [&](microseconds the_lag)
+  {
+    lag = the_lag;
+    monitor->stop();
+  });
+
+  // A handler that blocks the io_context
+  ASIO::post(io_context, []
+    { std::this_thread::sleep_for(milliseconds(30)); });
+  io_context.run();
+
+  BOOST_CHECK(!monitor->running());
+  BOOST_CHECK_GE(lag.count(), 10000);
+  BOOST_CHECK_GE(monitor->histogram().samples(), 1u);
+  BOOST_CHECK_EQUAL(lag.count(), monitor->histogram().max().count());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
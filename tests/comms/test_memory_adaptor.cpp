@@ -0,0 +1,668 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/memory_adaptor.hpp"
+#include "via/http_server.hpp"
+#include "via/http_client.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via;
+
+typedef http_server<comms::memory_adaptor, std::string> http_server_type;
+typedef http_client<comms::memory_adaptor, std::string> http_client_type;
+
+namespace
+{
+  /// Send GET requests in one write, i.e. pipelined, and run the io_context
+  /// until their responses have been received.
+  /// @param close_last whether the last request has a Connection: close
+  /// header.
+  /// @return the bodies of the responses.
+  std::vector<std::string> pipeline_requests(ASIO::io_context& io_context,
+                                             std::string_view port,
+                                             std::vector<std::string> uris,
+                                             bool close_last = false)
+  {
+    typedef comms::connection<comms::memory_adaptor, std::string>
+      connection_type;
+    std::string requests;
+    for (auto const& uri : uris)
+    {
+      http::tx_request request(http::request_method::id::GET, uri);
+      request.add_header(http::header_field::id::HOST, "localhost");
+      if (close_last && (&uri == &uris.back()))
+        request.add_header(http::header_field::id::CONNECTION, "close");
+      requests += request.message();
+    }
+
+    std::vector<std::string> response_bodies;
+    http::response_receiver<std::string> receiver;
+    connection_type::shared_pointer connection(connection_type::create
+      (io_context, [&](int event, connection_type::weak_pointer weak_ptr)
+    {
+      auto pointer(weak_ptr.lock());
+      if (event == comms::CONNECTED)
+        pointer->send_data(requests);
+      else if (event == comms::RECEIVED)
+      {
+        std::string rx_data;
+        pointer->read_rx_buffer(rx_data);
+        std::string::const_iterator iter(rx_data.cbegin());
+        while ((iter != rx_data.cend()) &&
+               (receiver.receive(iter, rx_data.cend()) == http::RX_VALID))
+        {
+          BOOST_CHECK_EQUAL(200, receiver.response().status());
+          response_bodies.push_back(receiver.body());
+          receiver.clear();
+        }
+        if (response_bodies.size() == uris.size())
+          pointer->disconnect();
+      }
+    },
+      [](ASIO_ERROR_CODE const&, connection_type::weak_pointer){}));
+
+    BOOST_CHECK(connection->connect("localhost", port));
+    io_context.run();
+    return response_bodies;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestMemoryChannel)
+
+BOOST_AUTO_TEST_CASE(WriteRead1)
+{
+  ASIO::io_context io_context;
+  comms::memory_channel channel;
+  std::string rx_data;
+  char buffer[4];
+
+  const std::string data("abcdef");
+  channel.write(comms::ConstBuffers(1, ASIO::buffer(data)));
+  channel.read(io_context, buffer, sizeof(buffer),
+    [&](ASIO_ERROR_CODE const& error, size_t size)
+  {
+    BOOST_CHECK(!error);
+    rx_data.append(buffer, size);
+  });
+  io_context.run();
+  BOOST_CHECK_EQUAL("abcd", rx_data);
+
+  channel.read(io_context, buffer, sizeof(buffer),
+    [&](ASIO_ERROR_CODE const& error, size_t size)
+  {
+    BOOST_CHECK(!error);
+    rx_data.append(buffer, size);
+  });
+  io_context.restart();
+  io_context.run();
+  BOOST_CHECK_EQUAL("abcdef", rx_data);
+}
+
+BOOST_AUTO_TEST_CASE(PendingReadClose1)
+{
+  ASIO::io_context io_context;
+  comms::memory_channel channel;
+  std::string rx_data;
+  bool eof(false);
+  char buffer[16];
+
+  comms::CommsHandler read_handler;
+  read_handler = [&](ASIO_ERROR_CODE const& error, size_t size)
+  {
+    if (error)
+      eof = (error == ASIO::error::eof);
+    else
+    {
+      rx_data.append(buffer, size);
+      channel.read(io_context, buffer, sizeof(buffer), read_handler);
+    }
+  };
+
+  channel.read(io_context, buffer, sizeof(buffer), read_handler);
+  const std::string data("hello");
+  channel.write(comms::ConstBuffers(1, ASIO::buffer(data)));
+  channel.close();
+  io_context.run();
+
+  BOOST_CHECK_EQUAL("hello", rx_data);
+  BOOST_CHECK(eof);
+}
+
+BOOST_AUTO_TEST_CASE(CompileTimeLimits1)
+{
+  ASIO::io_context io_context;
+
+  // A server that only accepts uris up to 16 characters long
+  typedef http::request_limits<false, 8, 8, 16> limits_type;
+  typedef http_server<comms::memory_adaptor, std::string, limits_type>
+    limits_server_type;
+  limits_server_type http_server(io_context);
+  http_server.set_max_uri_length(1024); // no effect
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/:name",
+    [](http::rx_request const&, http::Parameters const& parameters,
+       std::string const&, std::string& response_body)
+  {
+    response_body = parameters.at("name");
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_connections(8097));
+
+  // Send a valid request and one with a uri that's too long, in one write
+  typedef comms::connection<comms::memory_adaptor, std::string>
+    connection_type;
+  std::string requests(
+    "GET /hello HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n"
+    "GET /a_name_longer_than_the_limit HTTP/1.1\r\n"
+    "Host: localhost\r\nContent-Length: 0\r\n\r\n");
+  std::string responses;
+  connection_type::shared_pointer connection(connection_type::create
+    (io_context, [&](int event, connection_type::weak_pointer weak_ptr)
+  {
+    auto pointer(weak_ptr.lock());
+    if (event == comms::CONNECTED)
+      pointer->send_data(requests);
+    else if (event == comms::RECEIVED)
+    {
+      std::string rx_data;
+      pointer->read_rx_buffer(rx_data);
+      responses += rx_data;
+    }
+  },
+    [](ASIO_ERROR_CODE const&, connection_type::weak_pointer){}));
+
+  // The server closes the connection after rejecting the second request
+  BOOST_CHECK(connection->connect("localhost", "8097"));
+  io_context.run();
+
+  auto ok_pos(responses.find(" 200 "));
+  auto too_long_pos(responses.find(" 414 "));
+  BOOST_CHECK(ok_pos != std::string::npos);
+  BOOST_CHECK(responses.find("hello") != std::string::npos);
+  BOOST_CHECK(too_long_pos != std::string::npos);
+  BOOST_CHECK(ok_pos < too_long_pos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestMemoryAdaptor)
+
+BOOST_AUTO_TEST_CASE(ConnectNoListener1)
+{
+  ASIO::io_context io_context;
+  http_client_type::shared_pointer client(http_client_type::create(io_context,
+    [](http::rx_response const&, std::string const&){},
+    [](http_client_type::chunk_type const&, std::string const&){}));
+  BOOST_CHECK(!client->connect("localhost", "8079"));
+}
+
+BOOST_AUTO_TEST_CASE(HttpRequests1)
+{
+  const size_t REQUESTS(3u);
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/hello",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "Hello, World!";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_connections(8080));
+
+  http_server_type other_server(io_context);
+  BOOST_CHECK(other_server.accept_connections(8080));
+
+  size_t responses(0u);
+  bool disconnected(false);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const& body)
+  {
+    BOOST_CHECK_EQUAL(200, response.status());
+    BOOST_CHECK_EQUAL("Hello, World!", body);
+    if (++responses < REQUESTS)
+      client->send(http::tx_request(http::request_method::id::GET, "/hello"));
+    else
+      client->disconnect();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/hello")); });
+  client->disconnected_event([&]{ disconnected = true; });
+
+  BOOST_CHECK(client->connect("localhost", "8080"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(REQUESTS, responses);
+  BOOST_CHECK(disconnected);
+}
+
+BOOST_AUTO_TEST_CASE(VirtualHosts1)
+{
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_canned_response("/host",
+    http::tx_response(http::response_status::code::OK), "default");
+  http_server.request_router("*.localdomain").add_canned_response("/host",
+    http::tx_response(http::response_status::code::OK), "wildcard");
+  http_server.request_router("LOCALHOST").add_canned_response("/host",
+    http::tx_response(http::response_status::code::OK), "localhost");
+  BOOST_CHECK(!http_server.accept_connections(8083));
+
+  std::string response_body;
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const&, std::string const& body)
+  {
+    response_body = body;
+    client->disconnect();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/host")); });
+
+  BOOST_CHECK(client->connect("localhost", "8083"));
+  io_context.run();
+  BOOST_CHECK_EQUAL("localhost", response_body);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkedResponse1)
+{
+  const int CHUNKS(10);
+  ASIO::io_context io_context;
+
+  // Send all of the chunks at once, combining them while a write is pending
+  http_server_type http_server(io_context);
+  http_server.request_received_event([&]
+    (http_server_type::http_connection_type::weak_pointer weak_ptr,
+     http::rx_request const&, std::string const&)
+  {
+    auto connection(weak_ptr.lock());
+    http::tx_response response(http::response_status::code::OK);
+    response.add_header(http::header_field::id::TRANSFER_ENCODING, "Chunked");
+    connection->set_chunk_coalescing(1024);
+    connection->send(std::move(response));
+    for (int i(0); i < CHUNKS; ++i)
+      connection->send_chunk(std::string("chunk") + static_cast<char>('0' + i));
+    connection->last_chunk();
+  });
+  size_t writes(0u);
+  http_server.message_sent_event([&]
+    (http_server_type::http_connection_type::weak_pointer){ ++writes; });
+  BOOST_CHECK(!http_server.accept_connections(8084));
+
+  std::string response_body;
+  int chunks(0);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [](http::rx_response const&, std::string const&){},
+    [&](http_client_type::chunk_type const& chunk, std::string const& data)
+  {
+    if (chunk.is_last())
+      client->disconnect();
+    else
+    {
+      ++chunks;
+      response_body += data;
+    }
+  });
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/")); });
+
+  BOOST_CHECK(client->connect("localhost", "8084"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(CHUNKS, chunks);
+  BOOST_CHECK_EQUAL("chunk0chunk1chunk2chunk3chunk4"
+                    "chunk5chunk6chunk7chunk8chunk9", response_body);
+  // The response header, the first chunk and the rest combined
+  BOOST_CHECK_EQUAL(3u, writes);
+}
+
+BOOST_AUTO_TEST_CASE(ExpectContinue1)
+{
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::PUT,
+                                          "/upload",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const& body, std::string& response_body)
+  {
+    response_body = body;
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_connections(8085));
+
+  const std::string BODY("hello");
+  std::vector<int> statuses;
+  std::string response_body;
+  http_client_type::shared_pointer client;
+  auto send_request([&](std::string_view uri)
+  {
+    http::tx_request request(http::request_method::id::PUT, uri);
+    request.add_header(http::header_field::id::EXPECT, "100-continue");
+    request.add_header(http::header_field::id::CONTENT_LENGTH,
+                       http::to_dec_string(BODY.size()));
+    client->send(std::move(request));
+  });
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const& body)
+  {
+    statuses.push_back(response.status());
+    if (response.is_continue())
+      client->send_body(BODY);
+    else if (response.status() == 200)
+    {
+      response_body = body;
+      client->disconnect();
+    }
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+    { send_request(statuses.empty() ? "/missing" : "/upload"); });
+  client->disconnected_event([&]
+  {
+    // The server disconnects after rejecting a request
+    if (statuses.size() == 1u)
+      client->connect("localhost", "8085");
+  });
+
+  BOOST_CHECK(client->connect("localhost", "8085"));
+  io_context.run();
+
+  BOOST_REQUIRE_EQUAL(3u, statuses.size());
+  BOOST_CHECK_EQUAL(404, statuses[0]);
+  BOOST_CHECK_EQUAL(100, statuses[1]);
+  BOOST_CHECK_EQUAL(200, statuses[2]);
+  BOOST_CHECK_EQUAL(BODY, response_body);
+}
+
+BOOST_AUTO_TEST_CASE(BatchRequests1)
+{
+  const size_t CLIENTS(4u);
+  ASIO::io_context io_context;
+
+  typedef http_server_type::request_router_type router_type;
+  std::vector<size_t> batch_sizes;
+  http_server_type http_server(io_context);
+  http_server.request_router().add_batch_method(http::request_method::id::GET,
+                                                "/item/:id",
+    [&](std::vector<router_type::BatchRequest> const& requests)
+  {
+    batch_sizes.push_back(requests.size());
+    std::vector<router_type::BatchResponse> responses;
+    for (auto const& request : requests)
+      responses.emplace_back(http::tx_response(http::response_status::code::OK),
+                             request.parameters.at("id"));
+    return responses;
+  }, 3u);
+  BOOST_CHECK(!http_server.accept_connections(8086));
+
+  // The clients send their requests in the same turn of the io_context
+  std::vector<std::string> response_bodies;
+  std::vector<http_client_type::shared_pointer> clients;
+  for (size_t i(0u); i < CLIENTS; ++i)
+  {
+    http_client_type::shared_pointer client(http_client_type::create(io_context,
+      [&, i](http::rx_response const& response, std::string const& body)
+    {
+      BOOST_CHECK_EQUAL(200, response.status());
+      response_bodies.push_back(body);
+      clients[i]->disconnect();
+    },
+      [](http_client_type::chunk_type const&, std::string const&){}));
+    client->connected_event([&, i]
+    {
+      clients[i]->send(http::tx_request(http::request_method::id::GET,
+                                        "/item/" + http::to_dec_string(i)));
+    });
+    clients.push_back(client);
+    BOOST_CHECK(client->connect("localhost", "8086"));
+  }
+  io_context.run();
+
+  // Two batches: a full batch and the rest
+  BOOST_REQUIRE_EQUAL(2u, batch_sizes.size());
+  BOOST_CHECK_EQUAL(3u, batch_sizes[0]);
+  BOOST_CHECK_EQUAL(1u, batch_sizes[1]);
+  std::sort(response_bodies.begin(), response_bodies.end());
+  BOOST_REQUIRE_EQUAL(CLIENTS, response_bodies.size());
+  for (size_t i(0u); i < CLIENTS; ++i)
+    BOOST_CHECK_EQUAL(http::to_dec_string(i), response_bodies[i]);
+}
+
+BOOST_AUTO_TEST_CASE(PriorityClasses1)
+{
+  const size_t CLIENTS(4u);
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  auto handler([](http::rx_request const& request, http::Parameters const&,
+                  std::string const&, std::string& response_body)
+  {
+    response_body = request.uri();
+    return http::tx_response(http::response_status::code::OK);
+  });
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/hello", handler);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/export", handler, nullptr, 1u);
+  http_server.set_priority_classes({ 4, 1 }, "X-Priority");
+  BOOST_CHECK(!http_server.accept_connections(8087));
+
+  // Bulk and interactive clients send their requests at the same time
+  std::vector<std::string> response_bodies;
+  std::vector<http_client_type::shared_pointer> clients;
+  for (size_t i(0u); i < CLIENTS; ++i)
+  {
+    http_client_type::shared_pointer client(http_client_type::create(io_context,
+      [&, i](http::rx_response const& response, std::string const& body)
+    {
+      BOOST_CHECK_EQUAL(200, response.status());
+      response_bodies.push_back(body);
+      clients[i]->disconnect();
+    },
+      [](http_client_type::chunk_type const&, std::string const&){}));
+    client->connected_event([&, i]
+    {
+      http::tx_request request(http::request_method::id::GET,
+                               (i < 2u) ? "/export" : "/hello");
+      if (i == 3u)
+        request.add_header("X-Priority", "1");
+      clients[i]->send(std::move(request));
+    });
+    clients.push_back(client);
+    BOOST_CHECK(client->connect("localhost", "8087"));
+  }
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(CLIENTS, response_bodies.size());
+  auto stats(http_server.priority_stats());
+  BOOST_REQUIRE_EQUAL(2u, stats.size());
+  BOOST_CHECK_EQUAL(1u, stats[0].served);
+  BOOST_CHECK_EQUAL(3u, stats[1].served);
+  BOOST_CHECK_EQUAL(0u, stats[0].depth + stats[1].depth);
+}
+
+BOOST_AUTO_TEST_CASE(SpooledRequest1)
+{
+  ASIO::io_context io_context;
+
+  // The request_router can't pass a spooled body to its handler
+  bool handled(false);
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::PUT,
+                                          "/upload",
+    [&handled](http::rx_request const&, http::Parameters const&,
+               std::string const&, std::string&)
+  {
+    handled = true;
+    return http::tx_response(http::response_status::code::OK);
+  });
+  http_server.set_spool_threshold(16u);
+  BOOST_CHECK(!http_server.accept_connections(8093));
+
+  std::vector<int> statuses;
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const&)
+  {
+    statuses.push_back(response.status());
+    if (statuses.size() < 2u)
+      client->send(http::tx_request(http::request_method::id::PUT, "/upload"),
+                   "small");
+    else
+      client->disconnect();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+  {
+    client->send(http::tx_request(http::request_method::id::PUT, "/upload"),
+                 std::string(64u, 'x'));
+  });
+
+  BOOST_CHECK(client->connect("localhost", "8093"));
+  io_context.run();
+
+  BOOST_REQUIRE_EQUAL(2u, statuses.size());
+  BOOST_CHECK_EQUAL(413, statuses[0]);
+  BOOST_CHECK_EQUAL(200, statuses[1]);
+  BOOST_CHECK(handled);
+}
+
+BOOST_AUTO_TEST_CASE(PipelinedBatchRequest1)
+{
+  ASIO::io_context io_context;
+
+  // The batch response is deferred, the next response must follow it
+  typedef http_server_type::request_router_type router_type;
+  http_server_type http_server(io_context);
+  http_server.request_router().add_batch_method(http::request_method::id::GET,
+                                                "/item/:id",
+    [](std::vector<router_type::BatchRequest> const& requests)
+  {
+    std::vector<router_type::BatchResponse> responses;
+    for (auto const& request : requests)
+      responses.emplace_back(http::tx_response(http::response_status::code::OK),
+                             request.parameters.at("id"));
+    return responses;
+  }, 4u);
+  http_server.request_router().add_canned_response("/hello",
+    http::tx_response(http::response_status::code::OK), "Hello");
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/world",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "World";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_connections(8094));
+
+  std::vector<std::string> response_bodies(pipeline_requests(io_context,
+    "8094", { "/item/1", "/hello", "/item/2", "/world" }));
+
+  BOOST_REQUIRE_EQUAL(4u, response_bodies.size());
+  BOOST_CHECK_EQUAL("1", response_bodies[0]);
+  BOOST_CHECK_EQUAL("Hello", response_bodies[1]);
+  BOOST_CHECK_EQUAL("2", response_bodies[2]);
+  BOOST_CHECK_EQUAL("World", response_bodies[3]);
+}
+
+BOOST_AUTO_TEST_CASE(PipelinedScheduledRequest1)
+{
+  ASIO::io_context io_context;
+
+  // The first request is scheduled, the responses must be sent in order
+  typedef http_server_type::request_router_type router_type;
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/export",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "Export";
+    return http::tx_response(http::response_status::code::OK);
+  }, nullptr, 1u);
+  http_server.request_router().add_canned_response("/hello",
+    http::tx_response(http::response_status::code::OK), "Hello");
+  http_server.request_router().add_batch_method(http::request_method::id::GET,
+                                                "/item/:id",
+    [](std::vector<router_type::BatchRequest> const& requests)
+  {
+    std::vector<router_type::BatchResponse> responses;
+    for (auto const& request : requests)
+      responses.emplace_back(http::tx_response(http::response_status::code::OK),
+                             request.parameters.at("id"));
+    return responses;
+  }, 4u);
+  http_server.set_priority_classes({ 4, 1 });
+  BOOST_CHECK(!http_server.accept_connections(8095));
+
+  std::vector<std::string> response_bodies(pipeline_requests(io_context,
+    "8095", { "/export", "/hello", "/item/1" }));
+
+  BOOST_REQUIRE_EQUAL(3u, response_bodies.size());
+  BOOST_CHECK_EQUAL("Export", response_bodies[0]);
+  BOOST_CHECK_EQUAL("Hello", response_bodies[1]);
+  BOOST_CHECK_EQUAL("1", response_bodies[2]);
+}
+
+BOOST_AUTO_TEST_CASE(PipelinedClose1)
+{
+  ASIO::io_context io_context;
+
+  // The last responses close the connection, after the responses before them
+  typedef http_server_type::request_router_type router_type;
+  http_server_type http_server(io_context);
+  http_server.request_router().add_batch_method(http::request_method::id::GET,
+                                                "/item/:id",
+    [](std::vector<router_type::BatchRequest> const& requests)
+  {
+    std::vector<router_type::BatchResponse> responses;
+    for (auto const& request : requests)
+      responses.emplace_back(http::tx_response(http::response_status::code::OK),
+                             request.parameters.at("id"));
+    return responses;
+  }, 4u);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/world",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "World";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_connections(8096));
+
+  // A response sent behind a deferred response
+  std::vector<std::string> response_bodies(pipeline_requests(io_context,
+    "8096", { "/item/1", "/world" }, true));
+  BOOST_REQUIRE_EQUAL(2u, response_bodies.size());
+  BOOST_CHECK_EQUAL("1", response_bodies[0]);
+  BOOST_CHECK_EQUAL("World", response_bodies[1]);
+
+  // A deferred response sent behind another
+  io_context.restart();
+  response_bodies = pipeline_requests(io_context,
+    "8096", { "/item/2", "/item/3" }, true);
+  BOOST_REQUIRE_EQUAL(2u, response_bodies.size());
+  BOOST_CHECK_EQUAL("2", response_bodies[0]);
+  BOOST_CHECK_EQUAL("3", response_bodies[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/prefork.hpp"
+#include "via/comms/tcp_adaptor.hpp"
+#include "via/http_server.hpp"
+#include "via/http_client.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via;
+
+#ifdef VIA_PREFORK
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestPrefork)
+
+BOOST_AUTO_TEST_CASE(SharedCounters1)
+{
+  comms::shared_counters counters(2u, 3u);
+  BOOST_CHECK_EQUAL(0u, counters.total(1));
+
+  // A child process's counters are visible to its parent
+  pid_t pid(::fork());
+  if (pid == 0)
+  {
+    counters.at(1, 1).fetch_add(5u);
+    std::_Exit(0);
+  }
+  BOOST_REQUIRE(pid > 0);
+  int status(0);
+  ::waitpid(pid, &status, 0);
+
+  counters.at(0, 1).fetch_add(2u);
+  BOOST_CHECK_EQUAL(7u, counters.total(1));
+  BOOST_CHECK_EQUAL(0u, counters.total(0));
+
+  counters.reset(1);
+  BOOST_CHECK_EQUAL(2u, counters.total(1));
+}
+
+BOOST_AUTO_TEST_CASE(Respawn1)
+{
+  comms::prefork_master master(2u, 1u);
+  master.set_respawn_delay(std::chrono::milliseconds(0));
+
+  // Worker 0 fails the first time that it runs
+  master.run([&master](size_t worker, int listener)
+  {
+    BOOST_CHECK_EQUAL(-1, listener);
+    auto runs(master.counters().at(worker, 0).fetch_add(1u) + 1u);
+    return ((worker == 0u) && (runs == 1u)) ? 1 : 0;
+  });
+
+  BOOST_CHECK_EQUAL(3u, master.counters().total(0));
+  BOOST_CHECK_EQUAL(1u, master.restarts(0));
+  BOOST_CHECK_EQUAL(0u, master.restarts(1));
+  BOOST_CHECK_EQUAL(0, master.worker_pid(0));
+}
+
+BOOST_AUTO_TEST_CASE(AcceptListener1)
+{
+  typedef http_server<comms::tcp_adaptor, std::string> http_server_type;
+  typedef http_client<comms::tcp_adaptor, std::string> http_client_type;
+
+  // Each worker has its own SO_REUSEPORT socket
+  comms::prefork_master reuse_master(2u);
+  BOOST_REQUIRE(reuse_master.listen(8090, true, true));
+  BOOST_CHECK(reuse_master.listener(0) >= 0);
+  BOOST_CHECK(reuse_master.listener(0) != reuse_master.listener(1));
+
+  comms::prefork_master master(1u);
+  BOOST_REQUIRE(master.listen(8089, true));
+
+  // A worker's server accepts connections on its listening socket
+  ASIO::io_context io_context;
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/hello",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "Hello";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(!http_server.accept_listener(::dup(master.listener(0))));
+
+  std::string response_body;
+  http_client_type::shared_pointer client(http_client_type::create(io_context,
+    [&](http::rx_response const&, std::string const& body)
+  {
+    response_body = body;
+    http_server.close();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){}));
+  client->connected_event([&]
+  { client->send(http::tx_request(http::request_method::id::GET, "/hello")); });
+  BOOST_CHECK(client->connect("127.0.0.1", "8089"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL("Hello", response_body);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
+#endif
@@ -0,0 +1,141 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/comms/tcp_adaptor.hpp"
+#include "via/comms/memory_adaptor.hpp"
+#include "via/http_server.hpp"
+#include "via/http_client.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via;
+
+typedef http_server<comms::tcp_adaptor, std::string> http_server_type;
+typedef http_client<comms::tcp_adaptor, std::string> http_client_type;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestTimestamping)
+
+BOOST_AUTO_TEST_CASE(Supported1)
+{
+  BOOST_CHECK(comms::supports_timestamping<comms::tcp_adaptor>::value);
+  BOOST_CHECK(!comms::supports_timestamping<comms::memory_adaptor>::value);
+
+  ASIO::io_context io_context;
+  http_server<comms::memory_adaptor, std::string> memory_server(io_context);
+  BOOST_CHECK(!memory_server.set_timestamping());
+  BOOST_CHECK_EQUAL(0u,
+    memory_server.latency_histograms().kernel_to_handler.samples());
+}
+
+#ifdef VIA_SO_TIMESTAMPING
+BOOST_AUTO_TEST_CASE(SocketTimestamps1)
+{
+  ASIO::io_context io_context;
+  ASIO::ip::tcp::acceptor acceptor(io_context,
+    ASIO::ip::tcp::endpoint(ASIO::ip::address_v4::loopback(), 0));
+  ASIO::ip::tcp::socket client(io_context);
+  ASIO::ip::tcp::socket server(io_context);
+  client.connect(acceptor.local_endpoint());
+  acceptor.accept(server);
+
+  auto stats(std::make_shared<comms::latency_stats>());
+  BOOST_REQUIRE(comms::socket_timestamps::enable(server));
+  auto timestamps(std::make_shared<comms::socket_timestamps>(server, stats));
+
+  // The kernel stamps the request when it's received, before it's read
+  auto before(std::chrono::system_clock::now());
+  ASIO::write(client, ASIO::buffer(std::string("request")));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  char buffer[16];
+  size_t received(0u);
+  timestamps->read(buffer, sizeof(buffer),
+    [&](ASIO_ERROR_CODE const& error, size_t size)
+  {
+    BOOST_CHECK(!error);
+    received = size;
+  });
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(7u, received);
+  auto rx_time(timestamps->rx_time());
+  BOOST_CHECK(rx_time >= before);
+  BOOST_CHECK(std::chrono::system_clock::now() - rx_time >=
+              std::chrono::milliseconds(10));
+
+  // The response is stamped when it's sent and acknowledged
+  const std::string response("response");
+  timestamps->written(response.size());
+  ASIO::write(server, ASIO::buffer(response));
+  ASIO::read(client, ASIO::buffer(buffer, response.size()));
+
+  for (int i(0); (i < 100) &&
+       (stats->histograms().queued_to_acked.samples() == 0u); ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    timestamps->update();
+  }
+
+  auto histograms(stats->histograms());
+  BOOST_CHECK_EQUAL(1u, histograms.queued_to_sent.samples());
+  BOOST_CHECK_EQUAL(1u, histograms.queued_to_acked.samples());
+
+  // A released socket isn't read
+  timestamps->release();
+  timestamps->update();
+}
+
+BOOST_AUTO_TEST_CASE(ServerLatency1)
+{
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method(http::request_method::id::GET,
+                                          "/hello",
+    [](http::rx_request const&, http::Parameters const&,
+       std::string const&, std::string& response_body)
+  {
+    response_body = "Hello";
+    return http::tx_response(http::response_status::code::OK);
+  });
+  BOOST_CHECK(http_server.set_timestamping());
+  BOOST_CHECK(!http_server.accept_connections(8088));
+
+  // Send a second request when the first response is received
+  size_t responses(0u);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const& body)
+  {
+    BOOST_CHECK_EQUAL(200, response.status());
+    BOOST_CHECK_EQUAL("Hello", body);
+    if (++responses < 2u)
+      client->send(http::tx_request(http::request_method::id::GET, "/hello"));
+    else
+    {
+      client->disconnect();
+      http_server.close();
+    }
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+  { client->send(http::tx_request(http::request_method::id::GET, "/hello")); });
+  BOOST_CHECK(client->connect("127.0.0.1", "8088"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(2u, responses);
+  auto histograms(http_server.latency_histograms());
+  BOOST_CHECK_EQUAL(2u, histograms.kernel_to_handler.samples());
+  // The first response was acknowledged before the second request was read
+  BOOST_CHECK(histograms.queued_to_sent.samples() >= 1u);
+  BOOST_CHECK(histograms.queued_to_acked.samples() >= 1u);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
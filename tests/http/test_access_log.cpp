@@ -0,0 +1,157 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/access_log.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+using namespace via::http;
+
+namespace
+{
+  rx_request parse_request(std::string const& request_data)
+  {
+    rx_request the_request(false, 8, 8, 1024, 1024, 100, 8190);
+    std::string::const_iterator next(request_data.cbegin());
+    the_request.parse(next, request_data.cend());
+    return the_request;
+  }
+
+  std::string read_file(std::string const& filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  const std::string GET_REQUEST
+    ("GET /hello/world?a=b HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestAccessLog)
+
+BOOST_AUTO_TEST_CASE(AccessRecord1)
+{
+  rx_request the_request(parse_request(GET_REQUEST));
+  access_record record(access_record::create(the_request, "127.0.0.1",
+                              200, 1234, std::chrono::microseconds(56)));
+
+  BOOST_CHECK_EQUAL("127.0.0.1", record.remote_address);
+  BOOST_CHECK_EQUAL("GET", record.method);
+  BOOST_CHECK_EQUAL("/hello/world", record.path);
+  BOOST_CHECK_EQUAL(200, record.status);
+  BOOST_CHECK_EQUAL(1234u, record.bytes);
+  BOOST_CHECK_EQUAL(56u, record.latency);
+  BOOST_CHECK_EQUAL('1', record.major_version);
+  BOOST_CHECK_EQUAL('1', record.minor_version);
+}
+
+BOOST_AUTO_TEST_CASE(AccessRecordTruncate1)
+{
+  std::string uri(access_record::PATH_SIZE * 2, 'a');
+  rx_request the_request(parse_request
+    ("GET /" + uri + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+  access_record record(access_record::create(the_request, "127.0.0.1",
+                              200, 0, std::chrono::microseconds(0)));
+  BOOST_CHECK_EQUAL(access_record::PATH_SIZE - 1,
+                    std::string(record.path).size());
+}
+
+BOOST_AUTO_TEST_CASE(AccessRecordPadding1)
+{
+  // Create a record in storage that isn't zero
+  alignas(access_record) unsigned char storage[sizeof(access_record)];
+  std::memset(storage, 0xff, sizeof(storage));
+  rx_request the_request(parse_request(GET_REQUEST));
+  access_record* record(new (storage) access_record(access_record::create
+    (the_request, "127.0.0.1", 200, 0, std::chrono::microseconds(0))));
+
+  // The padding after the fields is written to the binary format
+  size_t fields_end(offsetof(access_record, path) + access_record::PATH_SIZE);
+  unsigned char const* bytes(reinterpret_cast<unsigned char const*>(record));
+  for (size_t i(fields_end); i < sizeof(access_record); ++i)
+    BOOST_CHECK_EQUAL(0, bytes[i]);
+}
+
+BOOST_AUTO_TEST_CASE(CommonLogFormat1)
+{
+  const std::string filename("test_access_log.log");
+  std::remove(filename.c_str());
+
+  rx_request the_request(parse_request(GET_REQUEST));
+  {
+    access_log the_log(filename);
+    BOOST_CHECK(the_log.is_open());
+    BOOST_CHECK(the_log.log(access_record::create(the_request, "127.0.0.1",
+                              200, 1234, std::chrono::microseconds(56))));
+    BOOST_CHECK(the_log.log(access_record::create(the_request, "::1",
+                              404, 0, std::chrono::microseconds(56))));
+  }
+
+  std::string contents(read_file(filename));
+  BOOST_CHECK(contents.find("127.0.0.1 - - [") == 0);
+  BOOST_CHECK(contents.find("] \"GET /hello/world HTTP/1.1\" 200 1234\n")
+                != std::string::npos);
+  BOOST_CHECK(contents.find("\n::1 - - [") != std::string::npos);
+  BOOST_CHECK(contents.find("] \"GET /hello/world HTTP/1.1\" 404 -\n")
+                != std::string::npos);
+  std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(BinaryFormat1)
+{
+  const std::string filename("test_access_log.bin");
+  std::remove(filename.c_str());
+
+  rx_request the_request(parse_request(GET_REQUEST));
+  {
+    access_log the_log(filename, access_log::format::BINARY);
+    for (int i(0); i < 10; ++i)
+      the_log.log(access_record::create(the_request, "127.0.0.1",
+                              200, i, std::chrono::microseconds(0)));
+  }
+
+  std::string contents(read_file(filename));
+  BOOST_CHECK_EQUAL(10 * sizeof(access_record), contents.size());
+
+  access_record record;
+  std::memcpy(&record, contents.data() + 9 * sizeof(access_record),
+              sizeof(record));
+  BOOST_CHECK_EQUAL(9u, record.bytes);
+  BOOST_CHECK_EQUAL("/hello/world", record.path);
+  std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(DropWhenFull1)
+{
+  const std::string filename("test_access_log_full.log");
+  std::remove(filename.c_str());
+
+  rx_request the_request(parse_request(GET_REQUEST));
+  {
+    // A long flush interval so that the ring buffer is not emptied
+    access_log the_log(filename, access_log::format::COMMON, 4,
+                       std::chrono::milliseconds(60000));
+    access_record record(access_record::create(the_request, "127.0.0.1",
+                              200, 0, std::chrono::microseconds(0)));
+    for (int i(0); i < 10; ++i)
+      the_log.log(record);
+
+    BOOST_CHECK_EQUAL(6u, the_log.dropped());
+  }
+  std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
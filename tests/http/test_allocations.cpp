@@ -0,0 +1,278 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+// Allocation budgets: the maximum number of heap allocations made by the
+// parsers and the request_router after they have warmed up.
+// If a change makes more allocations, it must justify raising a budget.
+//////////////////////////////////////////////////////////////////////////////
+#include "../allocation_counter.hpp"
+#include "via/comms/memory_adaptor.hpp"
+#include "via/http_server.hpp"
+#include "via/http_client.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+using namespace via;
+using namespace via::http;
+using via::test::allocation_counter;
+
+namespace
+{
+  /// The budget for receiving a GET request with two headers.
+  const size_t RECEIVE_REQUEST_BUDGET(3u);
+
+  /// The budget for routing a request to a handler.
+  const size_t ROUTE_REQUEST_BUDGET(0u);
+
+  /// The budget for formatting a response header.
+  const size_t RESPONSE_MESSAGE_BUDGET(3u);
+
+#ifdef HTTP_THREAD_SAFE
+  // The thread safe build dispatches the connection handlers through strands.
+
+  /// The budget for a keep-alive GET through the request_router:
+  /// client and server over a memory_adaptor.
+  const size_t KEEP_ALIVE_GET_BUDGET(55u);
+
+  /// The budget for a keep-alive GET of a canned response: client and
+  /// server over a memory_adaptor.
+  const size_t CANNED_GET_BUDGET(47u);
+#else
+  /// The budget for a keep-alive GET through the request_router:
+  /// client and server over a memory_adaptor.
+  const size_t KEEP_ALIVE_GET_BUDGET(53u);
+
+  /// The budget for a keep-alive GET of a canned response: client and
+  /// server over a memory_adaptor.
+  const size_t CANNED_GET_BUDGET(45u);
+#endif
+
+  const std::string GET_REQUEST("GET /hello HTTP/1.1\r\nHost: localhost\r\n"
+                                "Accept: */*\r\n\r\n");
+
+  tx_response hello_handler(rx_request const&, Parameters const&,
+                            std::string const&, std::string& response_body)
+  {
+    response_body = "Hello, World!";
+    return tx_response(response_status::code::OK);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestAllocations)
+
+BOOST_AUTO_TEST_CASE(AlignedNew1)
+{
+  // Over-aligned types, e.g. cache line aligned shards, are counted too
+  struct alignas(64) aligned_type { char data; };
+
+  allocation_counter counter;
+  std::unique_ptr<aligned_type> aligned(new aligned_type());
+  BOOST_CHECK_EQUAL(1u, counter.allocations());
+  BOOST_CHECK_EQUAL(0u, reinterpret_cast<std::uintptr_t>(aligned.get()) % 64u);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkParse1)
+{
+  const std::string chunk_data("f; ext\r\n123456789abcdef\r\n");
+  rx_chunk<std::string> the_chunk(false, 8, 1024, 1048576, 100, 8190);
+
+  // warm up
+  auto next(chunk_data.cbegin());
+  BOOST_CHECK(the_chunk.parse(next, chunk_data.cend()));
+  the_chunk.clear();
+
+  allocation_counter counter;
+  next = chunk_data.cbegin();
+  BOOST_CHECK(the_chunk.parse(next, chunk_data.cend()));
+  BOOST_CHECK_EQUAL(0u, counter.allocations());
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveAndRoute1)
+{
+  request_receiver<std::string> receiver(false, 8, 8, 8190, 1024, 100, 8190,
+                                         1048576, 1048576);
+  request_router<std::string> router;
+  router.add_method("GET", "/hello", hello_handler);
+
+  for (int i(0); i < 2; ++i)
+  {
+    receiver.clear();
+    allocation_counter counter;
+    auto next(GET_REQUEST.cbegin());
+    BOOST_CHECK_EQUAL(RX_VALID, receiver.receive(next, GET_REQUEST.cend()));
+    BOOST_CHECK_LE(counter.allocations(), RECEIVE_REQUEST_BUDGET + 1u);
+
+    std::string body;
+    counter.reset();
+    tx_response response
+      (router.handle_request(receiver.request(), receiver.body(), body));
+    BOOST_CHECK_EQUAL(200, response.status());
+    BOOST_CHECK_LE(counter.allocations(), ROUTE_REQUEST_BUDGET);
+
+    counter.reset();
+    std::string header(response.message(body.size()));
+    BOOST_CHECK_LE(counter.allocations(), RESPONSE_MESSAGE_BUDGET);
+  }
+
+  // warmed up
+  receiver.clear();
+  allocation_counter counter;
+  auto next(GET_REQUEST.cbegin());
+  BOOST_CHECK_EQUAL(RX_VALID, receiver.receive(next, GET_REQUEST.cend()));
+  BOOST_CHECK_LE(counter.allocations(), RECEIVE_REQUEST_BUDGET);
+}
+
+BOOST_AUTO_TEST_CASE(KeepAliveGet1)
+{
+  typedef http_server<comms::memory_adaptor, std::string> http_server_type;
+  typedef http_client<comms::memory_adaptor, std::string> http_client_type;
+
+  const size_t WARM_UP(2u);
+  const size_t REQUESTS(10u);
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_method("GET", "/hello", hello_handler);
+  BOOST_CHECK(!http_server.accept_connections(8081));
+
+  std::optional<allocation_counter> counter;
+  size_t allocations(0u);
+  size_t responses(0u);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const&)
+  {
+    BOOST_CHECK_EQUAL(200, response.status());
+    ++responses;
+    if (responses == WARM_UP)
+      counter.emplace();
+    else if (responses == WARM_UP + REQUESTS)
+    {
+      allocations = counter->allocations();
+      counter.reset();
+    }
+
+    if (responses < WARM_UP + REQUESTS)
+      client->send(http::tx_request(http::request_method::id::GET, "/hello"));
+    else
+      client->disconnect();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/hello")); });
+
+  BOOST_CHECK(client->connect("localhost", "8081"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(WARM_UP + REQUESTS, responses);
+  BOOST_CHECK_LE(allocations / REQUESTS, KEEP_ALIVE_GET_BUDGET);
+}
+
+BOOST_AUTO_TEST_CASE(CannedGet1)
+{
+  typedef http_server<comms::memory_adaptor, std::string> http_server_type;
+  typedef http_client<comms::memory_adaptor, std::string> http_client_type;
+
+  const size_t WARM_UP(2u);
+  const size_t REQUESTS(10u);
+  ASIO::io_context io_context;
+
+  http_server_type http_server(io_context);
+  http_server.request_router().add_canned_response("/health",
+    tx_response(response_status::code::OK), "{\"status\":\"up\"}");
+  BOOST_CHECK(!http_server.accept_connections(8082));
+
+  std::optional<allocation_counter> counter;
+  size_t allocations(0u);
+  size_t responses(0u);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [&](http::rx_response const& response, std::string const& body)
+  {
+    BOOST_CHECK_EQUAL(200, response.status());
+    BOOST_CHECK_EQUAL("{\"status\":\"up\"}", body);
+    ++responses;
+    if (responses == WARM_UP)
+      counter.emplace();
+    else if (responses == WARM_UP + REQUESTS)
+    {
+      allocations = counter->allocations();
+      counter.reset();
+    }
+
+    if (responses < WARM_UP + REQUESTS)
+      client->send(http::tx_request(http::request_method::id::GET, "/health"));
+    else
+      client->disconnect();
+  },
+    [](http_client_type::chunk_type const&, std::string const&){});
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/health")); });
+
+  BOOST_CHECK(client->connect("localhost", "8082"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(WARM_UP + REQUESTS, responses);
+  BOOST_CHECK_LE(allocations / REQUESTS, CANNED_GET_BUDGET);
+}
+
+BOOST_AUTO_TEST_CASE(SendChunk1)
+{
+  typedef http_server<comms::memory_adaptor, std::string> http_server_type;
+  typedef http_client<comms::memory_adaptor, std::string> http_client_type;
+
+  const size_t CHUNK_SIZE(65536u);
+  ASIO::io_context io_context;
+
+  // A chunk is moved into the transmit queue, not copied
+  size_t chunk_bytes(0u);
+  http_server_type http_server(io_context);
+  http_server.request_received_event([&]
+    (http_server_type::http_connection_type::weak_pointer weak_ptr,
+     rx_request const&, std::string const&)
+  {
+    auto connection(weak_ptr.lock());
+    tx_response response(response_status::code::OK);
+    response.add_header(header_field::id::TRANSFER_ENCODING, "Chunked");
+    connection->send(std::move(response));
+
+    std::string chunk(CHUNK_SIZE, 'x');
+    chunk.reserve(CHUNK_SIZE + 2u); // room for the CRLF
+    allocation_counter counter;
+    connection->send_chunk(std::move(chunk));
+    chunk_bytes = counter.bytes();
+    connection->last_chunk();
+  });
+  BOOST_CHECK(!http_server.accept_connections(8098));
+
+  size_t body_size(0u);
+  http_client_type::shared_pointer client;
+  client = http_client_type::create(io_context,
+    [](http::rx_response const&, std::string const&){},
+    [&](http_client_type::chunk_type const& chunk, std::string const& data)
+  {
+    if (chunk.is_last())
+      client->disconnect();
+    else
+      body_size += data.size();
+  });
+  client->connected_event([&]
+    { client->send(http::tx_request(http::request_method::id::GET, "/")); });
+
+  BOOST_CHECK(client->connect("localhost", "8098"));
+  io_context.run();
+
+  BOOST_CHECK_EQUAL(CHUNK_SIZE, body_size);
+  BOOST_CHECK_LT(chunk_bytes, CHUNK_SIZE);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -155,6 +155,66 @@ BOOST_AUTO_TEST_CASE(ValidUnreserved1)
   BOOST_CHECK(!is_unreserved('$'));
 }
 
+BOOST_AUTO_TEST_CASE(ValidTokens1)
+{
+  BOOST_CHECK(is_token('!'));
+  BOOST_CHECK(is_token('~'));
+  BOOST_CHECK(is_token('a'));
+  BOOST_CHECK(is_token('Z'));
+  BOOST_CHECK(is_token('0'));
+
+  BOOST_CHECK(!is_token(':'));
+  BOOST_CHECK(!is_token(' '));
+  BOOST_CHECK(!is_token('\x7f'));
+  BOOST_CHECK(!is_token('\x80'));
+  BOOST_CHECK(!is_token('\xff'));
+}
+
+BOOST_AUTO_TEST_CASE(CharacterClasses1)
+{
+  // Characters with the top bit set are not letters or digits in any locale
+  for (int i(128); i < 256; ++i)
+  {
+    char c(static_cast<char>(i));
+    BOOST_CHECK(!is_alpha(c));
+    BOOST_CHECK(!is_digit(c));
+    BOOST_CHECK(!is_hex_digit(c));
+    BOOST_CHECK(!is_ctl(c));
+    BOOST_CHECK(is_char_class(c, CC_FIELD_CHAR));
+    BOOST_CHECK_EQUAL(c, to_lower(c));
+  }
+
+  BOOST_CHECK(is_hex_digit('f'));
+  BOOST_CHECK(is_hex_digit('F'));
+  BOOST_CHECK(!is_hex_digit('g'));
+  BOOST_CHECK(is_upper('A'));
+  BOOST_CHECK(!is_upper('a'));
+  BOOST_CHECK_EQUAL('z', to_lower('Z'));
+  BOOST_CHECK_EQUAL('-', to_lower('-'));
+  BOOST_CHECK(is_ctl('\0'));
+  BOOST_CHECK(!is_char_class('\0', CC_FIELD_CHAR));
+  BOOST_CHECK(is_char_class('\t', CC_FIELD_CHAR));
+}
+
+BOOST_AUTO_TEST_CASE(AllCharacterClass1)
+{
+  BOOST_CHECK(is_all_char_class("/path/to-file_1.txt~",
+                                CC_UNRESERVED | CC_GEN_DELIM));
+  BOOST_CHECK(!is_all_char_class("/path/to file", CC_UNRESERVED | CC_GEN_DELIM));
+  BOOST_CHECK(is_all_char_class("", CC_TOKEN));
+  BOOST_CHECK(is_all_char_class("text/html; q=0.9", CC_FIELD_CHAR));
+  BOOST_CHECK(!is_all_char_class("text/html\r\n", CC_FIELD_CHAR));
+  BOOST_CHECK(is_all_char_class("/a%20b?c=d&e=f#g", CC_URI_CHAR));
+  BOOST_CHECK(!is_all_char_class("/a b", CC_URI_CHAR));
+  BOOST_CHECK(!is_all_char_class("/a\x7f", CC_URI_CHAR));
+
+  std::string_view line("Host: localhost\r\n");
+  auto iter(find_char_class(line.begin(), line.end(), CC_END_OF_LINE));
+  BOOST_CHECK_EQUAL(15, std::distance(line.begin(), iter));
+  iter = find_char_class(line.begin(), line.begin() + 4, CC_SEPARATOR);
+  BOOST_CHECK(line.begin() + 4 == iter);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
 
@@ -209,6 +269,27 @@ BOOST_AUTO_TEST_CASE(InvalidHex4)
   BOOST_CHECK_EQUAL(std::numeric_limits<size_t>::max(), value);
 }
 
+BOOST_AUTO_TEST_CASE(InvalidHex5)
+{
+  // Too large for a std::ptrdiff_t, signs are not allowed
+  BOOST_CHECK_EQUAL(-1, from_hex_string("8000000000000000"));
+  BOOST_CHECK_EQUAL(-1, from_hex_string("-1"));
+  BOOST_CHECK_EQUAL(-1, from_hex_string("+1"));
+  BOOST_CHECK_EQUAL(-1, from_hex_string(" 1"));
+
+  // A string_view need not be NUL terminated
+  std::string_view hex_view("1a2b", 2);
+  BOOST_CHECK_EQUAL(0x1a, from_hex_string(hex_view));
+}
+
+BOOST_AUTO_TEST_CASE(ToHex1)
+{
+  BOOST_CHECK_EQUAL("0", to_hex_string(0U));
+  BOOST_CHECK_EQUAL("abcdef", to_hex_string(0xABCDEFU));
+  BOOST_CHECK_EQUAL(std::string(2 * sizeof(size_t), 'f'),
+                    to_hex_string(std::numeric_limits<size_t>::max()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
 
@@ -255,5 +336,20 @@ BOOST_AUTO_TEST_CASE(InvalidDec3)
   BOOST_CHECK_EQUAL(-1, value);
 }
 
+BOOST_AUTO_TEST_CASE(InvalidDec4)
+{
+  BOOST_CHECK_EQUAL(-1, from_dec_string("9223372036854775808"));
+  BOOST_CHECK_EQUAL(-1, from_dec_string("-0"));
+  BOOST_CHECK_EQUAL(-1, from_dec_string("1 "));
+  BOOST_CHECK_EQUAL(9223372036854775807, from_dec_string("9223372036854775807"));
+}
+
+BOOST_AUTO_TEST_CASE(ToDec1)
+{
+  BOOST_CHECK_EQUAL("0", to_dec_string(0U));
+  BOOST_CHECK_EQUAL("18446744073709551615",
+                    to_dec_string(std::numeric_limits<uint64_t>::max()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
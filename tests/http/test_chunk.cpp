@@ -9,6 +9,7 @@
 #include "via/http/chunk.hpp"
 #include <boost/test/unit_test.hpp>
 #include <vector>
+#include <limits>
 #include <iostream>
 
 using namespace via::http;
@@ -481,3 +482,44 @@ BOOST_AUTO_TEST_CASE(InValidChunkTrailer1)
 
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestChunkEncoder)
+
+BOOST_AUTO_TEST_CASE(ChunkSizeLine1)
+{
+  chunk_size_line line1(0x1a2b);
+  BOOST_CHECK_EQUAL("1a2b\r\n", std::string(line1.data(), line1.size()));
+
+  chunk_size_line line2(std::numeric_limits<size_t>::max());
+  BOOST_CHECK_EQUAL(std::string(2 * sizeof(size_t), 'f') + CRLF,
+                    std::string(line2.data(), line2.size()));
+}
+
+BOOST_AUTO_TEST_CASE(EncodeChunk1)
+{
+  std::string frame;
+  encode_chunk(frame, "abcdefghijklmnopq", 17);
+  encode_chunk(frame, "xyz", 3, "ext");
+  BOOST_CHECK_EQUAL("11\r\nabcdefghijklmnopq\r\n3; ext\r\nxyz\r\n", frame);
+
+  // The frame contains two chunks
+  std::string::iterator next(frame.begin());
+  rx_chunk<std::string> the_chunk(false, 8, 1024, 1048576, 100, 8190);
+  BOOST_CHECK(the_chunk.parse(next, frame.end()));
+  BOOST_CHECK_EQUAL("abcdefghijklmnopq", the_chunk.data());
+  the_chunk.clear();
+  BOOST_CHECK(the_chunk.parse(next, frame.end()));
+  BOOST_CHECK_EQUAL("xyz", the_chunk.data());
+  BOOST_CHECK(next == frame.end());
+}
+
+BOOST_AUTO_TEST_CASE(EncodeChunk2)
+{
+  std::vector<char> frame;
+  encode_chunk(frame, "", 0);
+  BOOST_CHECK_EQUAL("0\r\n\r\n", std::string(frame.begin(), frame.end()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
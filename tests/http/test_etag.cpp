@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/etag.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via::http;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestEtag)
+
+BOOST_AUTO_TEST_CASE(Xxh64_1)
+{
+  BOOST_CHECK_EQUAL(0xef46db3751d8e999ULL, xxh64("", 0));
+  BOOST_CHECK_EQUAL(0x44bc2cf5ad770999ULL, xxh64("abc", 3));
+
+  // more than 32 bytes
+  const std::string data("Nobody inspects the spammish repetition");
+  BOOST_CHECK_EQUAL(0xfbcea83c8a378bf1ULL, xxh64(data.data(), data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(StrongEtag1)
+{
+  BOOST_CHECK_EQUAL("\"44bc2cf5ad770999\"", strong_etag("abc", 3));
+  BOOST_CHECK_EQUAL("\"v1\"", version_etag("v1"));
+}
+
+BOOST_AUTO_TEST_CASE(IfNoneMatch1)
+{
+  BOOST_CHECK(if_none_match("\"v1\"", "\"v1\""));
+  BOOST_CHECK(if_none_match("*", "\"v1\""));
+  BOOST_CHECK(if_none_match("\"v0\" ,\t\"v1\" ", "\"v1\""));
+  BOOST_CHECK(if_none_match("W/\"v1\"", "\"v1\""));
+  BOOST_CHECK(if_none_match("\"v1\"", "W/\"v1\""));
+
+  BOOST_CHECK(!if_none_match("\"v0\", \"v2\"", "\"v1\""));
+  BOOST_CHECK(!if_none_match("v1", "\"v1\""));
+  BOOST_CHECK(!if_none_match("", "\"v1\""));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/form_data.hpp"
+#include <boost/test/unit_test.hpp>
+#include <map>
+
+using namespace via::http;
+
+namespace
+{
+  const std::string MULTIPART_BODY
+    ("preamble\r\n"
+     "--AaB03x\r\n"
+     "Content-Disposition: form-data; name=\"submit-name\"\r\n"
+     "\r\n"
+     "Larry\r\n"
+     "--AaB03x  \r\n"
+     "content-disposition: form-data; name=\"files\"; filename=\"file1.txt\"\r\n"
+     "Content-Type: text/plain\r\n"
+     "\r\n"
+     "line 1\r\n--AaB03 is not a boundary\r\n\r\n"
+     "--AaB03x--\r\n"
+     "epilogue");
+
+  /// The parts received by a multipart_parser.
+  struct multipart_receiver
+  {
+    std::vector<std::string> names;
+    std::vector<std::string> filenames;
+    std::vector<std::string> content_types;
+    std::vector<std::string> data;
+    size_t ended = 0u;
+
+    multipart_parser parser(std::string_view boundary)
+    {
+      return multipart_parser(boundary,
+        [this](form_part const& part)
+        {
+          names.push_back(part.name());
+          filenames.push_back(part.filename());
+          content_types.emplace_back(part.content_type());
+          data.emplace_back();
+        },
+        [this](form_part const&, std::string_view part_data)
+          { data.back().append(part_data); },
+        [this](form_part const&){ ++ended; });
+    }
+
+    void check()
+    {
+      BOOST_REQUIRE_EQUAL(2U, names.size());
+      BOOST_CHECK_EQUAL("submit-name", names[0]);
+      BOOST_CHECK_EQUAL("", filenames[0]);
+      BOOST_CHECK_EQUAL("", content_types[0]);
+      BOOST_CHECK_EQUAL("Larry", data[0]);
+      BOOST_CHECK_EQUAL("files", names[1]);
+      BOOST_CHECK_EQUAL("file1.txt", filenames[1]);
+      BOOST_CHECK_EQUAL("text/plain", content_types[1]);
+      BOOST_CHECK_EQUAL("line 1\r\n--AaB03 is not a boundary\r\n", data[1]);
+      BOOST_CHECK_EQUAL(2U, ended);
+    }
+  };
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestUrlencodedParser)
+
+BOOST_AUTO_TEST_CASE(FormDecode1)
+{
+  std::string decoded;
+  BOOST_CHECK(form_decode("a+b%20c%2Bd", decoded));
+  BOOST_CHECK_EQUAL("a b c+d", decoded);
+  BOOST_CHECK(!form_decode("a%2", decoded));
+  BOOST_CHECK(!form_decode("a%zz", decoded));
+}
+
+BOOST_AUTO_TEST_CASE(ValidBody1)
+{
+  std::map<std::string, std::string> fields;
+  urlencoded_parser parser([&](std::string_view name, std::string_view value)
+    { fields[std::string(name)] = value; });
+
+  BOOST_CHECK(parser.parse("name=Larry+Page&em"));
+  BOOST_CHECK_EQUAL(1U, fields.size());
+  BOOST_CHECK(parser.parse("ail=larry%40exam"));
+  BOOST_CHECK(parser.parse("ple.com&empty=&flag"));
+  BOOST_CHECK_EQUAL(3U, fields.size());
+  BOOST_CHECK(parser.finish());
+
+  BOOST_CHECK_EQUAL(4U, fields.size());
+  BOOST_CHECK_EQUAL("Larry Page", fields["name"]);
+  BOOST_CHECK_EQUAL("larry@example.com", fields["email"]);
+  BOOST_CHECK_EQUAL("", fields["empty"]);
+  BOOST_CHECK_EQUAL("", fields["flag"]);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidBody1)
+{
+  urlencoded_parser parser([](std::string_view, std::string_view){});
+  BOOST_CHECK(!parser.parse("name=%G1&a=b"));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidBody2)
+{
+  urlencoded_parser parser([](std::string_view, std::string_view){}, 8);
+  BOOST_CHECK(parser.parse("a=1234&"));
+  BOOST_CHECK(!parser.parse("a=123456789"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestMultipartParser)
+
+BOOST_AUTO_TEST_CASE(Boundary1)
+{
+  BOOST_CHECK_EQUAL("AaB03x",
+    multipart_parser::boundary("multipart/form-data; boundary=AaB03x"));
+  BOOST_CHECK_EQUAL("a b",
+    multipart_parser::boundary("multipart/form-data; boundary=\"a b\"; x=y"));
+  BOOST_CHECK_EQUAL("", multipart_parser::boundary("multipart/form-data"));
+}
+
+BOOST_AUTO_TEST_CASE(ValidBody1)
+{
+  multipart_receiver receiver;
+  multipart_parser parser(receiver.parser("AaB03x"));
+  BOOST_CHECK(parser.parse(MULTIPART_BODY));
+  BOOST_CHECK(parser.is_complete());
+  receiver.check();
+}
+
+BOOST_AUTO_TEST_CASE(ValidBody2)
+{
+  // The body received one character at a time.
+  multipart_receiver receiver;
+  multipart_parser parser(receiver.parser("AaB03x"));
+  for (char c : MULTIPART_BODY)
+    BOOST_CHECK(parser.parse(&c, 1u));
+  BOOST_CHECK(parser.is_complete());
+  receiver.check();
+}
+
+BOOST_AUTO_TEST_CASE(ValidBody3)
+{
+  // No preamble and the body received in pieces.
+  multipart_receiver receiver;
+  multipart_parser parser(receiver.parser("AaB03x"));
+  std::string body(MULTIPART_BODY.substr(10));
+  for (size_t i(0u); i < body.size(); i += 7u)
+    BOOST_CHECK(parser.parse(body.substr(i, 7u)));
+  BOOST_CHECK(parser.is_complete());
+  receiver.check();
+}
+
+BOOST_AUTO_TEST_CASE(InvalidBody1)
+{
+  multipart_receiver receiver;
+  multipart_parser parser(receiver.parser("AaB03x"));
+  BOOST_CHECK(!parser.parse("--AaB03x\r\nno colon\r\n\r\n"));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidBody2)
+{
+  multipart_receiver receiver;
+  multipart_parser parser(receiver.parser("AaB03x"));
+  BOOST_CHECK(!parser.parse("--AaB03xyz\r\n"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/handler_watchdog.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via::http;
+using std::chrono::milliseconds;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestHandlerWatchdog)
+
+BOOST_AUTO_TEST_CASE(FastHandler1)
+{
+  std::atomic<int> reports(0);
+  {
+    handler_watchdog watchdog(milliseconds(200),
+      [&](slow_handler const&){ ++reports; });
+    for (int i(0); i < 10; ++i)
+    {
+      handler_watchdog::scope scope(&watchdog, "/fast", "127.0.0.1");
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    BOOST_CHECK_EQUAL(0u, watchdog.reports());
+  }
+  BOOST_CHECK_EQUAL(0, reports);
+}
+
+BOOST_AUTO_TEST_CASE(SlowHandler1)
+{
+  std::mutex mutex;
+  std::vector<slow_handler> reports;
+  {
+    handler_watchdog watchdog(milliseconds(20),
+      [&](slow_handler const& report)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      reports.push_back(report);
+    });
+
+    handler_watchdog::scope scope(&watchdog, "/slow?id=1", "192.168.0.1");
+    {
+      // A nested call doesn't end the outer call
+      handler_watchdog::scope nested(&watchdog, "/nested", "192.168.0.1");
+    }
+    std::this_thread::sleep_for(milliseconds(200));
+  }
+
+  // The call is reported once
+  BOOST_REQUIRE_EQUAL(1u, reports.size());
+  BOOST_CHECK_EQUAL("/slow", reports[0].route);
+  BOOST_CHECK_EQUAL("192.168.0.1", reports[0].remote_address);
+  BOOST_CHECK_GE(reports[0].elapsed.count(), 20);
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+  BOOST_CHECK(!reports[0].stack.empty());
+#endif
+}
+
+#ifdef VIA_HANDLER_WATCHDOG_BACKTRACE
+BOOST_AUTO_TEST_CASE(SignalHandler1)
+{
+  // The application's handler of the signal is restored
+  struct sigaction action;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  action.sa_handler = SIG_IGN;
+  struct sigaction old_action;
+  BOOST_REQUIRE_EQUAL(0, sigaction(SIGUSR2, &action, &old_action));
+  {
+    handler_watchdog watchdog(milliseconds(20),
+                              [](slow_handler const&){}, SIGUSR2);
+    struct sigaction current;
+    sigaction(SIGUSR2, nullptr, &current);
+    BOOST_CHECK(current.sa_handler != SIG_IGN);
+  }
+
+  struct sigaction current;
+  sigaction(SIGUSR2, nullptr, &current);
+  BOOST_CHECK(current.sa_handler == SIG_IGN);
+  sigaction(SIGUSR2, &old_action, nullptr);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(NoWatchdog1)
+{
+  handler_watchdog::scope scope(nullptr, "/", "127.0.0.1");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -62,6 +62,14 @@ BOOST_AUTO_TEST_CASE(ToHeaderDate)
   BOOST_CHECK(!memcmp(end.c_str(), result.c_str() + 31, end.size()));
 }
 
+BOOST_AUTO_TEST_CASE(CachedDateHeader)
+{
+  std::string result(header_field::cached_date_header());
+  BOOST_CHECK_EQUAL(37U, result.size());
+  BOOST_CHECK_EQUAL(0U, result.find("Date: "));
+  BOOST_CHECK_EQUAL(31U, result.find(" GMT\r\n"));
+}
+
 BOOST_AUTO_TEST_CASE(ServerHeader)
 {
   std::string line("Server: Via-httplib\r\n");
@@ -157,6 +157,18 @@ BOOST_AUTO_TEST_CASE(InValidSingleLine6)
   BOOST_CHECK(!field.parse(next, header_data.end()));
 }
 
+BOOST_AUTO_TEST_CASE(InValidSingleLine7)
+{
+  // A control character in the value
+  std::string header_data("Content: abc");
+  header_data += '\0';
+  header_data += "defgh\r\n";
+  std::string::iterator next(header_data.begin());
+
+  field_line field(false, 8, 1024);
+  BOOST_CHECK(!field.parse(next, header_data.end()));
+}
+
 // A multiple http header line in a string
 BOOST_AUTO_TEST_CASE(ValidMultiString1)
 {
@@ -429,6 +441,53 @@ BOOST_AUTO_TEST_CASE(ValidExpectContinue1)
   BOOST_CHECK(the_headers.expect_continue());
 }
 
+BOOST_AUTO_TEST_CASE(RetainedHeaders1)
+{
+  std::string HEADER_LINE("Host: localhost\r\n");
+  HEADER_LINE += "User-Agent: Mozilla/5.0\r\n";
+  HEADER_LINE += "Accept-Language: en-GB,\r\n en;q=0.9\r\n";
+  HEADER_LINE += "X-Request-Id: 1234\r\n";
+  HEADER_LINE += "Content-Length: 4\r\n\r\n";
+  std::vector<char> header_data(HEADER_LINE.begin(), HEADER_LINE.end());
+  std::vector<char>::iterator header_next(header_data.begin());
+
+  message_headers the_headers(false, 8, 1024, 100, 8190);
+  the_headers.set_retained_headers(retained_headers({"X-Request-ID"}));
+  BOOST_CHECK(the_headers.parse(header_next, header_data.end()));
+  BOOST_CHECK(header_data.end() == header_next);
+
+  BOOST_CHECK_EQUAL(3u, the_headers.fields().size());
+  BOOST_CHECK_EQUAL("localhost", the_headers.find(header_field::id::HOST));
+  BOOST_CHECK_EQUAL("1234", the_headers.find("x-request-id"));
+  BOOST_CHECK_EQUAL(4, the_headers.content_length());
+  BOOST_CHECK(the_headers.find(header_field::id::USER_AGENT).empty());
+  BOOST_CHECK(the_headers.find("accept-language").empty());
+}
+
+BOOST_AUTO_TEST_CASE(RetainedHeaders2)
+{
+  // The header fields that are not retained still count towards the limit.
+  std::string header_data("Host: localhost\r\n");
+  header_data += ("User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\n\r\n");
+  std::string::iterator header_next(header_data.begin());
+
+  message_headers the_headers(false, 8, 1024, 100, 32);
+  the_headers.set_retained_headers(retained_headers({}));
+  BOOST_CHECK(!the_headers.parse(header_next, header_data.end()));
+}
+
+BOOST_AUTO_TEST_CASE(RetainedHeaders3)
+{
+  // The header fields that are not retained are still validated.
+  std::string header_data("Host: localhost\r\n");
+  header_data += ("User-Agent: Mozilla/5.0\x01(X11; Linux x86_64)\r\n\r\n");
+  std::string::iterator header_next(header_data.begin());
+
+  message_headers the_headers(false, 8, 1024, 100, 8190);
+  the_headers.set_retained_headers(retained_headers({}));
+  BOOST_CHECK(!the_headers.parse(header_next, header_data.end()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,111 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/rate_limiter.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via::http;
+
+namespace
+{
+  const std::string ADDRESS_1("192.168.0.1");
+  const std::string ADDRESS_2("192.168.0.2");
+
+  rx_request parse_request(std::string const& request_data)
+  {
+    rx_request the_request(false, 8, 8, 1024, 1024, 100, 8190);
+    std::string::const_iterator next(request_data.cbegin());
+    the_request.parse(next, request_data.cend());
+    return the_request;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestRateLimiter)
+
+BOOST_AUTO_TEST_CASE(Disabled1)
+{
+  rate_limiter the_limiter;
+  BOOST_CHECK(!the_limiter.enabled());
+
+  for (int i(0); i < 100; ++i)
+    BOOST_CHECK(the_limiter.allow(ADDRESS_1));
+  BOOST_CHECK_EQUAL(0u, the_limiter.size());
+}
+
+BOOST_AUTO_TEST_CASE(Burst1)
+{
+  rate_limiter the_limiter;
+  the_limiter.set_limit(1.0, 3.0);
+  BOOST_CHECK(the_limiter.enabled());
+
+  auto now(rate_limiter::clock_type::now());
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(!the_limiter.allow(ADDRESS_1, now));
+
+  // Other clients have their own buckets
+  BOOST_CHECK(the_limiter.allow(ADDRESS_2, now));
+  BOOST_CHECK_EQUAL(2u, the_limiter.size());
+}
+
+BOOST_AUTO_TEST_CASE(Refill1)
+{
+  rate_limiter the_limiter;
+  the_limiter.set_limit(2.0, 1.0);
+
+  auto now(rate_limiter::clock_type::now());
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(!the_limiter.allow(ADDRESS_1, now));
+
+  now += std::chrono::milliseconds(250);
+  BOOST_CHECK(!the_limiter.allow(ADDRESS_1, now));
+
+  now += std::chrono::milliseconds(250);
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(!the_limiter.allow(ADDRESS_1, now));
+
+  // The bucket does not fill above the burst size
+  now += std::chrono::seconds(10);
+  BOOST_CHECK(the_limiter.allow(ADDRESS_1, now));
+  BOOST_CHECK(!the_limiter.allow(ADDRESS_1, now));
+}
+
+BOOST_AUTO_TEST_CASE(BoundedMemory1)
+{
+  rate_limiter the_limiter;
+  the_limiter.set_limit(1.0, 1.0);
+  the_limiter.set_max_keys(rate_limiter::NUMBER_OF_SHARDS * 4);
+
+  auto now(rate_limiter::clock_type::now());
+  for (int i(0); i < 1000; ++i)
+    BOOST_CHECK(the_limiter.allow(std::to_string(i), now));
+  BOOST_CHECK(the_limiter.size() <= rate_limiter::NUMBER_OF_SHARDS * 4);
+}
+
+BOOST_AUTO_TEST_CASE(ClientKey1)
+{
+  rx_request the_request(parse_request
+    ("GET /hello/world?a=b HTTP/1.1\r\nHost: localhost\r\nX-Api-Key: abc\r\n\r\n"));
+
+  rate_limiter the_limiter;
+  BOOST_CHECK_EQUAL(ADDRESS_1, the_limiter.client_key(the_request, ADDRESS_1));
+
+  the_limiter.set_key(rate_limiter::key::ROUTE);
+  BOOST_CHECK_EQUAL("/hello/world", the_limiter.client_key(the_request, ADDRESS_1));
+
+  the_limiter.set_key(rate_limiter::key::HEADER, "X-Api-Key");
+  BOOST_CHECK_EQUAL("abc", the_limiter.client_key(the_request, ADDRESS_1));
+
+  the_limiter.set_key(rate_limiter::key::HEADER, "X-Missing");
+  BOOST_CHECK_EQUAL(ADDRESS_1, the_limiter.client_key(the_request, ADDRESS_1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
@@ -211,6 +211,18 @@ BOOST_AUTO_TEST_CASE(InValidUri5)
   BOOST_CHECK_EQUAL("GET", the_request.method().c_str());
 }
 
+// An http request line with an invalid uri (control character)
+BOOST_AUTO_TEST_CASE(InValidUri6)
+{
+  std::string request_data("GET /abc\x7f HTTP/1.0\r\n");
+  std::string::iterator next(request_data.begin());
+
+  request_line the_request(false, 8, 8, 1024);
+  BOOST_CHECK(!the_request.parse(next, request_data.end()));
+  BOOST_CHECK(via::http::request_line::REQ_ERROR_URI_CHAR ==
+              the_request.state());
+}
+
 // An incomplete http request line in a string.
 BOOST_AUTO_TEST_CASE(ValidGet4)
 {
@@ -1199,6 +1211,164 @@ BOOST_AUTO_TEST_CASE(InValidTrace1)
               via::http::response_status::code::BAD_REQUEST);
 }
 
+BOOST_AUTO_TEST_CASE(RequestCheck1)
+{
+  std::string request_data("POST /hello HTTP/1.1\r\n");
+  request_data += "Host: localhost\r\n";
+  request_data += "Content-Length: 5\r\n\r\n";
+  request_data += "abcde";
+  std::string::iterator next(request_data.begin());
+
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_request_check([](rx_request const& request)
+    { return request.uri() == "/hello"
+          ? via::http::response_status::code::TOO_MANY_REQUESTS
+          : via::http::response_status::code::OK; });
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INVALID);
+  BOOST_CHECK(the_request_receiver.response_code() ==
+              via::http::response_status::code::TOO_MANY_REQUESTS);
+  // The body was not received
+  BOOST_CHECK_EQUAL("abcde", std::string(next, request_data.end()));
+  BOOST_CHECK(the_request_receiver.body().empty());
+}
+
+BOOST_AUTO_TEST_CASE(BodyHandler1)
+{
+  std::string request_data("POST /upload HTTP/1.1\r\n");
+  request_data += "Host: localhost\r\n";
+  request_data += "Content-Length: 10\r\n\r\n";
+  request_data += "abcde";
+  std::string::iterator next(request_data.begin());
+
+  // The body handler takes the body, received in two buffers
+  std::string streamed_body;
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_body_handler([&streamed_body]
+    (rx_request const& request, char const* data, size_t size)
+  {
+    BOOST_CHECK_EQUAL("/upload", request.uri());
+    streamed_body.append(data, size);
+    return true;
+  });
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INCOMPLETE);
+  BOOST_CHECK_EQUAL(5u, the_request_receiver.streamed_size());
+
+  std::string body_part2("fghij");
+  next = body_part2.begin();
+  rx_state = the_request_receiver.receive(next, body_part2.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+  BOOST_CHECK_EQUAL("abcdefghij", streamed_body);
+  BOOST_CHECK(the_request_receiver.body().empty());
+  BOOST_CHECK_EQUAL(10u, the_request_receiver.streamed_size());
+
+  the_request_receiver.clear();
+  BOOST_CHECK_EQUAL(0u, the_request_receiver.streamed_size());
+}
+
+BOOST_AUTO_TEST_CASE(BodyHandler2)
+{
+  std::string request_data("POST /hello HTTP/1.1\r\n");
+  request_data += "Host: localhost\r\n";
+  request_data += "Content-Length: 5\r\n\r\n";
+  request_data += "abcde";
+  std::string::iterator next(request_data.begin());
+
+  // The body handler declines the body, so it's received as usual
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_body_handler([]
+    (rx_request const& request, char const*, size_t)
+  { return request.uri() == "/upload"; });
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_VALID);
+  BOOST_CHECK_EQUAL("abcde", the_request_receiver.body());
+  BOOST_CHECK_EQUAL(0u, the_request_receiver.streamed_size());
+}
+
+BOOST_AUTO_TEST_CASE(BodyHandler3)
+{
+  std::string request_data("POST /upload HTTP/1.1\r\n");
+  request_data += "Host: localhost\r\n";
+  request_data += "Content-Length: 10\r\n\r\n";
+  request_data += "abcde";
+  std::string::iterator next(request_data.begin());
+
+  // The body handler rejects the rest of the body
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_body_handler([]
+    (rx_request const&, char const* data, size_t)
+  { return *data == 'a'; });
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INCOMPLETE);
+
+  std::string body_part2("fghij");
+  next = body_part2.begin();
+  rx_state = the_request_receiver.receive(next, body_part2.end());
+  BOOST_CHECK(rx_state == RX_INVALID);
+  BOOST_CHECK(the_request_receiver.response_code() ==
+              via::http::response_status::code::BAD_REQUEST);
+}
+
+BOOST_AUTO_TEST_CASE(StaticLimits1)
+{
+  std::string request_data("POST /hello HTTP/1.1\r\n");
+  request_data += "Host: localhost\r\n";
+  request_data += "Transfer-Encoding: Chunked\r\n\r\n";
+  request_data += "5\r\nabcde\r\n0\r\n\r\n";
+  std::string::iterator next(request_data.begin());
+
+  request_receiver<std::string, request_limits<true>> the_request_receiver;
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  // the chunks are concatenated into the body
+  while ((rx_state == RX_INCOMPLETE) && (next != request_data.end()))
+    rx_state = the_request_receiver.receive(next, request_data.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+  BOOST_CHECK_EQUAL("/hello", the_request_receiver.request().uri());
+  BOOST_CHECK_EQUAL("abcde", the_request_receiver.body());
+}
+
+BOOST_AUTO_TEST_CASE(StaticLimits2)
+{
+  std::string request_data("POST /dhcp/blocked_addresses HTTP/1.1\r\n");
+  request_data += "Host: 172.16.0.126:3456\r\n";
+  request_data += "Content-Length: 0\r\n\r\n";
+  std::string::iterator next(request_data.begin());
+
+  request_receiver<std::string, request_limits<true, 8, 8, 16>>
+      the_request_receiver;
+  Rx rx_state(the_request_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INVALID);
+  BOOST_CHECK(the_request_receiver.response_code() ==
+              via::http::response_status::code::REQUEST_URI_TOO_LONG);
+}
+
+BOOST_AUTO_TEST_CASE(StaticLimits3)
+{
+  std::string request_data("POST /hello HTTP/1.1\n");
+  request_data += "Host: localhost\n";
+  request_data += "Content-Length: 5\n\n";
+  request_data += "abcde";
+  std::string::iterator next(request_data.begin());
+
+  // Strict CRLF, a small body limit
+  request_receiver<std::string, request_limits<true>> strict_receiver;
+  Rx rx_state(strict_receiver.receive(next, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INVALID);
+
+  next = request_data.begin();
+  request_receiver<std::string,
+      request_limits<false, 8, 8, 1024, 1024, 100, 8190, 4>> small_receiver;
+  rx_state = small_receiver.receive(next, request_data.end());
+  BOOST_CHECK(rx_state == RX_INVALID);
+  BOOST_CHECK(small_receiver.response_code() ==
+              via::http::response_status::code::PAYLOAD_TOO_LARGE);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1421,5 +1591,141 @@ BOOST_AUTO_TEST_CASE(LoopbackPost2)
   BOOST_CHECK(rx_state == RX_VALID);
 }
 
+BOOST_AUTO_TEST_CASE(LoopbackSpoolPut1)
+{
+  // A PUT request with a body larger than the spool threshold,
+  // received in three buffers
+  std::string request_body("abcdefghijklmnopqrstuvwxyz0123456789");
+
+  tx_request client_request(request_method::PUT, "/upload");
+  client_request.add_header(header_field::HEADER_HOST, "localhost");
+  std::string request_data(client_request.message(request_body.size()));
+  std::string::iterator iter(request_data.begin());
+
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_spool_threshold(16);
+  Rx rx_state(the_request_receiver.receive(iter, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INCOMPLETE);
+
+  std::string body_part1(request_body.substr(0, 10));
+  iter = body_part1.begin();
+  rx_state = the_request_receiver.receive(iter, body_part1.end());
+  BOOST_CHECK(rx_state == RX_INCOMPLETE);
+  BOOST_CHECK(!the_request_receiver.spool_file().is_open());
+  BOOST_CHECK_EQUAL(10u, the_request_receiver.body_size());
+
+  std::string body_part2(request_body.substr(10));
+  iter = body_part2.begin();
+  rx_state = the_request_receiver.receive(iter, body_part2.end());
+  BOOST_CHECK(iter == body_part2.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+
+  body_spool const& spool(the_request_receiver.spool_file());
+  BOOST_CHECK(spool.is_open());
+  BOOST_CHECK(spool.fd() >= 0);
+  BOOST_CHECK(the_request_receiver.body().empty());
+  BOOST_CHECK_EQUAL(request_body.size(), the_request_receiver.body_size());
+
+  std::string spooled_body(request_body.size() + 1u, '\0');
+  spooled_body.resize(std::fread(&spooled_body[0], 1u, spooled_body.size(),
+                                 spool.file()));
+  BOOST_CHECK_EQUAL(request_body, spooled_body);
+
+  // clearing the receiver deletes the spool file
+  the_request_receiver.clear();
+  BOOST_CHECK(!the_request_receiver.spool_file().is_open());
+  BOOST_CHECK_EQUAL(0u, the_request_receiver.body_size());
+}
+
+BOOST_AUTO_TEST_CASE(LoopbackSpoolPost1)
+{
+  // A chunked POST request concatenated into a spooled body
+  tx_request client_request(request_method::POST, "/upload");
+  client_request.add_header(header_field::HEADER_HOST, "localhost");
+  client_request.add_header(header_field::HEADER_TRANSFER_ENCODING, "Chunked");
+  std::string request_buffer(client_request.message());
+
+  std::string chunk_body1("abcdefghijklmnopqrstuvwxyz");
+  std::string chunk_body2("0123456789");
+  request_buffer += chunk_header(chunk_body1.size()).to_string();
+  request_buffer += chunk_body1 + CRLF;
+  request_buffer += chunk_header(chunk_body2.size()).to_string();
+  request_buffer += chunk_body2 + CRLF;
+  request_buffer += last_chunk("", "").to_string();
+  request_buffer += CRLF;
+
+  std::string::iterator iter(request_buffer.begin());
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  the_request_receiver.set_spool_threshold(30);
+  Rx rx_state(RX_INCOMPLETE);
+  while ((iter != request_buffer.end()) && (rx_state == RX_INCOMPLETE))
+    rx_state = the_request_receiver.receive(iter, request_buffer.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+
+  body_spool const& spool(the_request_receiver.spool_file());
+  BOOST_CHECK(spool.is_open());
+  BOOST_CHECK_EQUAL(36u, the_request_receiver.body_size());
+
+  std::string spooled_body(64u, '\0');
+  spooled_body.resize(std::fread(&spooled_body[0], 1u, spooled_body.size(),
+                                 spool.file()));
+  BOOST_CHECK_EQUAL(chunk_body1 + chunk_body2, spooled_body);
+}
+
+BOOST_AUTO_TEST_CASE(LoopbackExpectContinue1)
+{
+  // A PUT request that expects a 100 Continue response before its body
+  std::string request_body("abcdefghijklmnopqrstuvwxyz0123456789");
+
+  tx_request client_request(request_method::PUT, "/upload");
+  client_request.add_header(header_field::HEADER_HOST, "localhost");
+  client_request.add_header(header_field::HEADER_EXPECT, "100-continue");
+  std::string request_data(client_request.message(request_body.size()));
+  std::string::iterator iter(request_data.begin());
+
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1048576, 1048576);
+  Rx rx_state(the_request_receiver.receive(iter, request_data.end()));
+  BOOST_CHECK(iter == request_data.end());
+  BOOST_CHECK(rx_state == RX_EXPECT_CONTINUE);
+  BOOST_CHECK(the_request_receiver.response_code() ==
+              response_status::code::CONTINUE);
+  the_request_receiver.set_continue_sent();
+
+  iter = request_body.begin();
+  rx_state = the_request_receiver.receive(iter, request_body.end());
+  BOOST_CHECK(iter == request_body.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+  BOOST_CHECK_EQUAL(request_body, the_request_receiver.body());
+
+  // The client didn't wait for a 100 Continue response
+  the_request_receiver.clear();
+  std::string request_buffer(request_data + request_body);
+  iter = request_buffer.begin();
+  rx_state = the_request_receiver.receive(iter, request_buffer.end());
+  BOOST_CHECK(iter == request_buffer.end());
+  BOOST_CHECK(rx_state == RX_VALID);
+}
+
+BOOST_AUTO_TEST_CASE(LoopbackExpectContinue2)
+{
+  // A PUT request that expects a 100 Continue response with a body that is
+  // too large
+  tx_request client_request(request_method::PUT, "/upload");
+  client_request.add_header(header_field::HEADER_HOST, "localhost");
+  client_request.add_header(header_field::HEADER_EXPECT, "100-continue");
+  std::string request_data(client_request.message(2000));
+  std::string::iterator iter(request_data.begin());
+
+  request_receiver<std::string> the_request_receiver
+      (true, 8, 8, 1024, 1024, 100, 8190, 1024, 1048576);
+  Rx rx_state(the_request_receiver.receive(iter, request_data.end()));
+  BOOST_CHECK(rx_state == RX_INVALID);
+  BOOST_CHECK(the_request_receiver.response_code() ==
+              response_status::code::PAYLOAD_TOO_LARGE);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
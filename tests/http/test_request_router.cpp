@@ -6,9 +6,11 @@
 // (See accompanying file LICENSE_1_0.txt or copy at
 // http://www.boost.org/LICENSE_1_0.txt)
 //////////////////////////////////////////////////////////////////////////////
+#include "../allocation_counter.hpp"
 #include "via/http/request_router.hpp"
 #include <boost/test/unit_test.hpp>
 #include <iostream>
+#include <thread>
 
 using namespace via::http;
 
@@ -258,5 +260,345 @@ BOOST_AUTO_TEST_CASE(ComplexRouteTest2)
 //  std::cout << "ComplexRouteTest2: "<< response_body << std::endl;
 }
 
+BOOST_AUTO_TEST_CASE(CannedResponseTest1)
+{
+  string_router router;
+  tx_response health(response_status::code::OK);
+  health.add_header(header_field::id::CONTENT_TYPE, "application/json");
+  BOOST_CHECK(router.add_canned_response("/health", health, "{}"));
+  BOOST_CHECK(!router.add_canned_response("/health", health, "{\"up\":1}"));
+
+  std::string request_data("GET /health HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+
+  canned_response const* canned(router.find_canned_response(request));
+  BOOST_REQUIRE(canned != nullptr);
+  BOOST_CHECK_EQUAL(200, canned->status());
+  BOOST_CHECK_EQUAL("{\"up\":1}", canned->body());
+  BOOST_CHECK_EQUAL(0U, canned->header().find("HTTP/1.1 200 OK\r\n"));
+  BOOST_CHECK(canned->header().find("Content-Length: 8\r\n")
+                != std::string::npos);
+  BOOST_CHECK(canned->header().find("Server: ") != std::string::npos);
+  BOOST_CHECK_EQUAL(canned->header().size() - 2,
+                    canned->header().rfind(CRLF));
+
+  std::string data;
+  std::string response_body;
+  tx_response response(router.handle_request(request, data, response_body));
+  BOOST_CHECK_EQUAL(200, response.status());
+  BOOST_CHECK_EQUAL("{\"up\":1}", response_body);
+}
+
+BOOST_AUTO_TEST_CASE(CannedResponseTest2)
+{
+  string_router router;
+  router.add_canned_response("/health", tx_response(response_status::code::OK));
+
+  // Only GET and HEAD requests to the exact uri
+  std::string request_data("POST /health HTTP/1.1\r\nHost: h\r\n\r\n"
+                           "HEAD /health HTTP/1.1\r\nHost: h\r\n\r\n"
+                           "GET /health?a=b HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK(router.find_canned_response(request) == nullptr);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK(router.find_canned_response(request) != nullptr);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK(router.find_canned_response(request) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(EtagTest1)
+{
+  string_router router;
+  router.add_method(request_method::id::GET, "/data",
+    [](rx_request const&, Parameters const&, std::string const&,
+       std::string& response_body)
+  {
+    response_body = "abc";
+    return tx_response(response_status::code::OK);
+  });
+  BOOST_CHECK(router.enable_etag("/data"));
+  BOOST_CHECK(!router.enable_etag("/none"));
+
+  std::string request_data("GET /data HTTP/1.1\r\nHost: h\r\n\r\n"
+    "GET /data HTTP/1.1\r\nHost: h\r\n"
+    "If-None-Match: \"1234\", W/\"44bc2cf5ad770999\"\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+
+  std::string data;
+  std::string response_body;
+  tx_response response(router.handle_request(request, data, response_body));
+  BOOST_CHECK_EQUAL(200, response.status());
+  BOOST_CHECK_EQUAL("abc", response_body);
+  BOOST_CHECK(response.message().find("ETag: \"44bc2cf5ad770999\"\r\n")
+                != std::string::npos);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  response_body.clear();
+  response = router.handle_request(request, data, response_body);
+  BOOST_CHECK_EQUAL(304, response.status());
+  BOOST_CHECK(response_body.empty());
+  BOOST_CHECK(response.message().find("ETag: \"44bc2cf5ad770999\"\r\n")
+                != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(EtagTest2)
+{
+  string_router router;
+  int handler_calls(0);
+  router.add_method(request_method::id::GET, "/customer/:id",
+    [&](rx_request const&, Parameters const& parameters, std::string const&,
+       std::string& response_body)
+  {
+    ++handler_calls;
+    response_body = get_parameter(parameters, "id");
+    return tx_response(response_status::code::OK);
+  });
+  BOOST_CHECK(router.enable_etag("/customer/:id",
+    [](rx_request const&, Parameters const& parameters)
+      { return "v1-" + get_parameter(parameters, "id"); }));
+
+  std::string request_data("GET /customer/42 HTTP/1.1\r\nHost: h\r\n"
+    "If-None-Match: \"v1-42\"\r\n\r\n"
+    "GET /customer/43 HTTP/1.1\r\nHost: h\r\n"
+    "If-None-Match: \"v1-42\"\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+
+  // The client has the current version: the handler is not called
+  std::string data;
+  std::string response_body;
+  tx_response response(router.handle_request(request, data, response_body));
+  BOOST_CHECK_EQUAL(304, response.status());
+  BOOST_CHECK_EQUAL(0, handler_calls);
+  BOOST_CHECK(response.message().find("ETag: \"v1-42\"\r\n")
+                != std::string::npos);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  response = router.handle_request(request, data, response_body);
+  BOOST_CHECK_EQUAL(200, response.status());
+  BOOST_CHECK_EQUAL(1, handler_calls);
+  BOOST_CHECK_EQUAL("43", response_body);
+  BOOST_CHECK(response.message().find("ETag: \"v1-43\"\r\n")
+                != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(CheckRequestTest1)
+{
+  string_router router;
+  router.add_method(request_method::id::PUT, "/upload/:name", test_route1);
+
+  std::string request_data(
+    "PUT /upload/file HTTP/1.1\r\nHost: h\r\nContent-Length: 4\r\n\r\n"
+    "POST /upload/file HTTP/1.1\r\nHost: h\r\nContent-Length: 4\r\n\r\n"
+    "PUT /download HTTP/1.1\r\nHost: h\r\nContent-Length: 4\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK(router.check_request(request).is_continue());
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  tx_response response(router.check_request(request));
+  BOOST_CHECK_EQUAL(405, response.status());
+  BOOST_CHECK(response.message().find("Allow: PUT\r\n") != std::string::npos);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK_EQUAL(404, router.check_request(request).status());
+}
+
+BOOST_AUTO_TEST_CASE(BatchRouteTest1)
+{
+  size_t batch_size(0u);
+  string_router router;
+  router.add_batch_method(request_method::id::GET, "/item/:id",
+    [&](std::vector<string_router::BatchRequest> const& requests)
+  {
+    batch_size = requests.size();
+    std::vector<string_router::BatchResponse> responses;
+    for (auto const& batch_request : requests)
+      responses.emplace_back(tx_response(response_status::code::OK),
+                             batch_request.parameters.at("id"));
+    return responses;
+  });
+  router.add_method(request_method::id::GET, "/hello", test_route1);
+
+  std::string request_data(
+    "GET /item/42 HTTP/1.1\r\nHost: h\r\n\r\n"
+    "GET /hello HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+
+  Parameters parameters;
+  BOOST_CHECK(router.find_batch_handler(request, parameters));
+  BOOST_CHECK_EQUAL("42", parameters.at("id"));
+
+  // handle_request calls the batch handler with a single request
+  std::string data;
+  std::string response_body;
+  tx_response response(router.handle_request(request, data, response_body));
+  BOOST_CHECK_EQUAL(200, response.status());
+  BOOST_CHECK_EQUAL(1u, batch_size);
+  BOOST_CHECK_EQUAL("42", response_body);
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  parameters.clear();
+  BOOST_CHECK(!router.find_batch_handler(request, parameters));
+}
+
+BOOST_AUTO_TEST_CASE(PriorityTest1)
+{
+  string_router router;
+  router.add_method(request_method::id::GET, "/hello", test_route1);
+  router.add_method(request_method::id::GET, "/export", test_route1,
+                    nullptr, 2u);
+
+  std::string request_data(
+    "GET /export HTTP/1.1\r\nHost: h\r\n\r\n"
+    "GET /hello HTTP/1.1\r\nHost: h\r\n\r\n"
+    "GET /missing HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK_EQUAL(2u, router.priority(request));
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK_EQUAL(0u, router.priority(request));
+
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  BOOST_CHECK_EQUAL(0u, router.priority(request));
+}
+
+namespace
+{
+  /// An authentication that counts its calls.
+  class counting_authentication : public authentication::authentication
+  {
+    bool is_valid(message_headers const&) const override
+    { ++calls; return true; }
+
+    std::string authenticate_value() const override
+    { return "Basic realm=\"test\""; }
+
+  public:
+    mutable int calls;
+
+    counting_authentication()
+      : authentication::authentication("test")
+      , calls(0)
+    {}
+  };
+}
+
+BOOST_AUTO_TEST_CASE(RouteTest1)
+{
+  counting_authentication auth;
+  string_router router;
+  router.add_method(request_method::id::GET, "/customer/:id",
+                    test_route1, &auth, 3u);
+
+  std::string request_data("GET /customer/42 HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request.parse(next, request_data.end()));
+
+  // The request is routed and authenticated once
+  string_router::routed_request routed(router.route(request));
+  BOOST_REQUIRE(routed.handler);
+  BOOST_CHECK_EQUAL(3u, routed.handler->priority);
+  BOOST_CHECK_EQUAL("42", routed.parameters.at("id"));
+
+  std::string data;
+  std::string response_body;
+  tx_response response(router.handle_request(routed, request, data,
+                                             response_body));
+  BOOST_CHECK_EQUAL(200, response.status());
+  BOOST_CHECK_EQUAL(1, auth.calls);
+
+  request_data = "GET /missing HTTP/1.1\r\nHost: h\r\n\r\n";
+  next = request_data.begin();
+  request.clear();
+  BOOST_CHECK(request.parse(next, request_data.end()));
+  routed = router.route(request);
+  BOOST_CHECK(!routed.handler);
+  BOOST_CHECK_EQUAL(404, router.handle_request(routed, request, data,
+                                               response_body).status());
+}
+
+BOOST_AUTO_TEST_CASE(CostAccountingTest1)
+{
+  string_router router;
+  router.add_method(request_method::id::GET, "/hello/:name",
+    [](rx_request const&, Parameters const& parameters,
+       std::string const&, std::string& response_body)
+  {
+    // Use some CPU time and make one large allocation
+    volatile std::uint64_t sum(0u);
+    for (std::uint64_t i(0u); i < 1000000u; ++i)
+      sum = sum + i;
+    response_body.assign(1024, parameters.at("name").front());
+    return tx_response(response_status::code::OK);
+  });
+  router.add_method(request_method::id::GET, "/export", test_route1);
+  BOOST_CHECK(router.handler_costs().empty());
+
+  via::test::allocation_counter counter;
+  router.set_cost_accounting(true, [&counter]
+                             { return std::uint64_t(counter.allocations()); });
+
+  std::string request_data(
+    "GET /hello/Ken HTTP/1.1\r\nHost: h\r\n\r\n"
+    "GET /hello/Jo HTTP/1.1\r\nHost: h\r\n\r\n");
+  std::string::iterator next(request_data.begin());
+  rx_request request1(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request1.parse(next, request_data.end()));
+  rx_request request2(false, 8, 8, 1024, 1024, 100, 8190);
+  BOOST_CHECK(request2.parse(next, request_data.end()));
+
+  std::string data;
+  std::string response_body;
+  router.handle_request(request1, data, response_body);
+  BOOST_CHECK_EQUAL('K', response_body.front());
+
+  // The costs of the handler calls on other threads are merged
+  std::thread thread([&]
+  {
+    std::string thread_body;
+    router.handle_request(request2, data, thread_body);
+  });
+  thread.join();
+
+  auto costs(router.handler_costs());
+  BOOST_REQUIRE_EQUAL(1u, costs.size());
+  route_cost const& cost(costs.at("GET /hello/:name"));
+  BOOST_CHECK_EQUAL(2u, cost.calls);
+  BOOST_CHECK_EQUAL(2u, cost.cpu_histogram.samples());
+  BOOST_CHECK(cost.cpu_time > std::chrono::nanoseconds::zero());
+  // Only the allocation on this thread is counted
+  BOOST_CHECK(cost.allocations >= 1u);
+
+  router.set_cost_accounting(false);
+  BOOST_CHECK(router.handler_costs().empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/request_scheduler.hpp"
+#include <boost/test/unit_test.hpp>
+#include <string>
+
+using namespace via::http;
+
+typedef request_scheduler<std::string> string_scheduler;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestRequestScheduler)
+
+BOOST_AUTO_TEST_CASE(Disabled1)
+{
+  string_scheduler scheduler;
+  BOOST_CHECK(!scheduler.enabled());
+  BOOST_CHECK(!scheduler.pop());
+
+  scheduler.set_weights({ 4, 1 });
+  BOOST_CHECK(scheduler.enabled());
+  BOOST_CHECK_EQUAL(2u, scheduler.classes());
+
+  scheduler.set_weights({});
+  BOOST_CHECK(!scheduler.enabled());
+}
+
+BOOST_AUTO_TEST_CASE(WeightedFairQueue1)
+{
+  string_scheduler scheduler;
+  scheduler.set_weights({ 3, 1 });
+
+  // A backlog of bulk requests doesn't delay the interactive requests
+  for (int i(0); i < 8; ++i)
+    scheduler.push(1, "bulk");
+  BOOST_CHECK_EQUAL(8u, scheduler.push(0, "interactive"));
+  scheduler.push(0, "interactive");
+  scheduler.push(0, "interactive");
+
+  std::string served;
+  while (auto request = scheduler.pop())
+    served += (*request)[0];
+
+  BOOST_CHECK_EQUAL(0u, scheduler.size());
+  BOOST_CHECK_EQUAL("iiibbbbbbbb", served);
+}
+
+BOOST_AUTO_TEST_CASE(WeightedFairQueue2)
+{
+  string_scheduler scheduler;
+  scheduler.set_weights({ 2, 1 });
+
+  // While both classes are busy they're served in proportion to the weights
+  for (int i(0); i < 6; ++i)
+  {
+    scheduler.push(0, "a");
+    scheduler.push(1, "b");
+  }
+
+  std::string served;
+  for (int i(0); i < 6; ++i)
+    served += *scheduler.pop();
+  BOOST_CHECK_EQUAL("aabaab", served);
+}
+
+BOOST_AUTO_TEST_CASE(Statistics1)
+{
+  string_scheduler scheduler;
+  scheduler.set_weights({ 1, 1 });
+
+  auto now(string_scheduler::clock_type::now());
+  scheduler.push(0, "a", now);
+  scheduler.push(0, "b", now);
+  scheduler.push(5, "c", now); // out of range: the last class
+
+  auto stats(scheduler.stats());
+  BOOST_REQUIRE_EQUAL(2u, stats.size());
+  BOOST_CHECK_EQUAL(2u, stats[0].depth);
+  BOOST_CHECK_EQUAL(1u, stats[1].depth);
+
+  while (scheduler.pop(now + std::chrono::milliseconds(5)));
+
+  stats = scheduler.stats();
+  BOOST_CHECK_EQUAL(0u, stats[0].depth);
+  BOOST_CHECK_EQUAL(2u, stats[0].max_depth);
+  BOOST_CHECK_EQUAL(2u, stats[0].served);
+  BOOST_CHECK_EQUAL(10000, stats[0].total_wait.count());
+  BOOST_CHECK_EQUAL(5000, stats[0].max_wait.count());
+  BOOST_CHECK_EQUAL(1u, stats[1].served);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
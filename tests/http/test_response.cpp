@@ -668,6 +668,21 @@ BOOST_AUTO_TEST_CASE(ResponseEncode5)
   BOOST_CHECK_EQUAL(correct_response.data(), resp_text.data());
 }
 
+BOOST_AUTO_TEST_CASE(ResponseEncodeChunked1)
+{
+  tx_response the_response(response_status::code::OK);
+  BOOST_CHECK(!the_response.is_chunked());
+  the_response.add_server_header();
+  the_response.add_header(header_field::HEADER_TRANSFER_ENCODING, "Chunked");
+  BOOST_CHECK(the_response.is_chunked());
+
+  tx_response identity_response(response_status::code::OK);
+  identity_response.add_header(header_field::HEADER_TRANSFER_ENCODING,
+                               "Identity");
+  identity_response.add_server_header();
+  BOOST_CHECK(!identity_response.is_chunked());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
 
@@ -874,6 +889,26 @@ BOOST_AUTO_TEST_CASE(InValidOKChunked4)
   BOOST_CHECK(rx_state == RX_INVALID);
 }
 
+BOOST_AUTO_TEST_CASE(StaticLimits1)
+{
+  std::string response_data("HTTP/1.0 200 OK\r\n");
+  response_data += "Content-Length: 4\r\n\r\nabcd";
+  std::string::iterator next(response_data.begin());
+
+  response_receiver<std::string, response_limits<true, 8, 599>>
+      the_response_receiver;
+  Rx rx_state(the_response_receiver.receive(next, response_data.end()));
+  BOOST_CHECK(rx_state == RX_VALID);
+  BOOST_CHECK_EQUAL(200, the_response_receiver.response().status());
+  BOOST_CHECK_EQUAL("abcd", the_response_receiver.body());
+
+  std::string invalid_data("HTTP/1.0 600 OK\r\n\r\n");
+  next = invalid_data.begin();
+  the_response_receiver.clear();
+  rx_state = the_response_receiver.receive(next, invalid_data.end());
+  BOOST_CHECK(rx_state == RX_INVALID);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 //////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/http/virtual_hosts.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace via::http;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestVirtualHosts)
+
+BOOST_AUTO_TEST_CASE(HostName1)
+{
+  BOOST_CHECK_EQUAL("example.com", host_name("example.com"));
+  BOOST_CHECK_EQUAL("example.com", host_name("example.com:8080"));
+  BOOST_CHECK_EQUAL("[::1]", host_name("[::1]"));
+  BOOST_CHECK_EQUAL("[::1]", host_name("[::1]:8080"));
+  BOOST_CHECK_EQUAL("", host_name(""));
+}
+
+BOOST_AUTO_TEST_CASE(ExactHosts1)
+{
+  virtual_hosts<int> hosts;
+  BOOST_CHECK(hosts.empty());
+  hosts["example.com"] = 1;
+  hosts["api.example.com"] = 2;
+  BOOST_CHECK_EQUAL(2U, hosts.size());
+
+  // The same host, case insensitive
+  hosts["EXAMPLE.com"] = 3;
+  BOOST_CHECK_EQUAL(2U, hosts.size());
+
+  BOOST_REQUIRE(hosts.find("example.com") != nullptr);
+  BOOST_CHECK_EQUAL(3, *hosts.find("example.com"));
+  BOOST_REQUIRE(hosts.find("API.Example.Com") != nullptr);
+  BOOST_CHECK_EQUAL(2, *hosts.find("API.Example.Com"));
+  BOOST_CHECK(hosts.find("www.example.com") == nullptr);
+  BOOST_CHECK(hosts.find("example.org") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(WildcardHosts1)
+{
+  virtual_hosts<int> hosts;
+  hosts["*.example.com"] = 1;
+  hosts["*.eu.example.com"] = 2;
+  hosts["www.eu.example.com"] = 3;
+
+  BOOST_CHECK(hosts.find("example.com") == nullptr);
+  BOOST_REQUIRE(hosts.find("api.example.com") != nullptr);
+  BOOST_CHECK_EQUAL(1, *hosts.find("api.example.com"));
+  BOOST_CHECK_EQUAL(1, *hosts.find("a.b.example.com"));
+  BOOST_CHECK_EQUAL(1, *hosts.find("eu.example.com"));
+  BOOST_CHECK_EQUAL(2, *hosts.find("api.eu.example.com"));
+  BOOST_CHECK_EQUAL(3, *hosts.find("www.eu.example.com"));
+  BOOST_CHECK(hosts.find("api.example.org") == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////
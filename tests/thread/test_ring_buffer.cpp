@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021 Via Technology Ltd. All Rights Reserved.
+// (ken dot barker at via-technology dot co dot uk)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//////////////////////////////////////////////////////////////////////////////
+#include "via/thread/ring_buffer.hpp"
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+using namespace via::thread;
+
+//////////////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(Test_Ring_Buffer)
+
+BOOST_AUTO_TEST_CASE(Single_Threaded_1)
+{
+  ring_buffer<int> test_buffer(3);
+  BOOST_CHECK_EQUAL(4u, test_buffer.capacity());
+  BOOST_CHECK(test_buffer.empty());
+
+  int value(0);
+  BOOST_CHECK(!test_buffer.pop(value));
+
+  for (int i(0); i < 4; ++i)
+    BOOST_CHECK(test_buffer.push(i));
+  BOOST_CHECK_EQUAL(4u, test_buffer.size());
+
+  // Full
+  BOOST_CHECK(!test_buffer.push(4));
+
+  BOOST_CHECK(test_buffer.pop(value));
+  BOOST_CHECK_EQUAL(0, value);
+  BOOST_CHECK(test_buffer.push(4));
+
+  for (int i(1); i < 5; ++i)
+  {
+    BOOST_CHECK(test_buffer.pop(value));
+    BOOST_CHECK_EQUAL(i, value);
+  }
+  BOOST_CHECK(test_buffer.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Multi_Threaded_1)
+{
+  const int COUNT(100000);
+  ring_buffer<int> test_buffer(64);
+
+  std::thread producer([&test_buffer]
+  {
+    for (int i(0); i < COUNT; ++i)
+      while (!test_buffer.push(i))
+        std::this_thread::yield();
+  });
+
+  bool in_order(true);
+  int value(0);
+  for (int i(0); i < COUNT; ++i)
+  {
+    while (!test_buffer.pop(value))
+      std::this_thread::yield();
+    in_order &= (value == i);
+  }
+  producer.join();
+
+  BOOST_CHECK(in_order);
+  BOOST_CHECK(test_buffer.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//////////////////////////////////////////////////////////////////////////////